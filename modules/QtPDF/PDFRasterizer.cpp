@@ -0,0 +1,266 @@
+// Headless command-line tool that rasterizes (selected pages of) a PDF in
+// parallel and reports per-page timings and the peak memory usage, e.g., for
+// batch-rendering previews, reproducing slow pages or regression checks.
+// Each worker renders with its own document instance (they share the file
+// data, see Backend::FileSource). The per-page results are printed sorted by
+// page (tab-separated) to stdout, followed by a summary; all lines not
+// containing results start with '#'.
+
+#include "PDFBackend.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QTextStream>
+
+#if defined(Q_OS_WIN)
+  #include <windows.h>
+  #include <psapi.h>
+#else
+  #include <sys/resource.h>
+#endif
+
+#ifdef USE_MUPDF
+  typedef QtPDF::MuPDFBackend Backend;
+#elif USE_POPPLERQT
+  typedef QtPDF::PopplerQtBackend Backend;
+#else
+  #error Must specify one backend
+#endif
+
+#if defined(STATIC_QT5) && defined(Q_OS_WIN32)
+  #include <QtPlugin>
+  Q_IMPORT_PLUGIN (QWindowsIntegrationPlugin);
+#endif
+
+typedef QSharedPointer<QtPDF::Backend::Document> pDoc;
+typedef QSharedPointer<QtPDF::Backend::Page> pPage;
+
+struct PageResult
+{
+  PageResult() : page(-1), worker(-1), usec(0), ok(false) { }
+
+  int page;
+  int worker;
+  qint64 usec;
+  QSize size;
+  bool ok;
+};
+
+// Shared by all workers
+struct Job
+{
+  QList<int> pages;
+  // Index (into `pages`) of the next page to render
+  QAtomicInt next;
+  double dpi;
+  // See the --output option
+  QString outputPattern;
+};
+
+// Returns the peak resident set size of the process in kB, or -1 if unknown
+static qint64 peakMemory()
+{
+#if defined(Q_OS_WIN)
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return -1;
+  return static_cast<qint64>(pmc.PeakWorkingSetSize / 1024);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#if defined(Q_OS_DARWIN)
+  // macOS reports bytes instead of kB
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Parses page ranges like "1-3,7,10-" (1-based, inclusive) into a list of
+// 0-based page indices; returns false if `spec` is invalid
+static bool parsePages(const QString & spec, const int numPages, QList<int> & pages)
+{
+  pages.clear();
+  if (spec.isEmpty()) {
+    for (int i = 0; i < numPages; ++i)
+      pages << i;
+    return true;
+  }
+  foreach (QString range, spec.split(QChar::fromLatin1(','), QString::SkipEmptyParts)) {
+    QStringList parts = range.split(QChar::fromLatin1('-'));
+    bool ok1 = true, ok2 = true;
+    int first, last;
+    if (parts.size() == 1)
+      first = last = parts[0].toInt(&ok1);
+    else if (parts.size() == 2) {
+      first = (parts[0].isEmpty() ? 1 : parts[0].toInt(&ok1));
+      last = (parts[1].isEmpty() ? numPages : parts[1].toInt(&ok2));
+    }
+    else
+      return false;
+    if (!ok1 || !ok2 || first < 1 || last > numPages || first > last)
+      return false;
+    for (int i = first; i <= last; ++i)
+      pages << i - 1;
+  }
+  return !pages.isEmpty();
+}
+
+static QString outputFileName(const QString & pattern, const int page, const int numPages)
+{
+  // Zero-pad so the files sort correctly
+  const int width = QString::number(numPages).length();
+  QString retVal(pattern);
+  return retVal.replace(QString::fromLatin1("%p"), QString::fromLatin1("%1").arg(page + 1, width, 10, QChar::fromLatin1('0')));
+}
+
+static QList<PageResult> rasterize(Job * job, pDoc doc, const int worker)
+{
+  QList<PageResult> retVal;
+  while (true) {
+    const int idx = job->next.fetchAndAddOrdered(1);
+    if (idx >= job->pages.size())
+      break;
+
+    PageResult result;
+    result.page = job->pages[idx];
+    result.worker = worker;
+
+    pPage page(doc->page(result.page).toStrongRef());
+    if (page) {
+      QElapsedTimer timer;
+      timer.start();
+      QImage img = page->renderToImage(job->dpi, job->dpi);
+      result.usec = timer.nsecsElapsed() / 1000;
+      result.size = img.size();
+      result.ok = !img.isNull();
+      if (result.ok && !job->outputPattern.isEmpty())
+        result.ok = img.save(outputFileName(job->outputPattern, result.page, doc->numPages()));
+    }
+    retVal << result;
+  }
+  return retVal;
+}
+
+static bool pageLessThan(const PageResult & a, const PageResult & b)
+{
+  return a.page < b.page;
+}
+
+int main(int argc, char **argv) {
+  // Don't require a display
+  if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QGuiApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QString::fromLatin1("Rasterizes pages of a PDF file in parallel and reports per-page timings"));
+  parser.addHelpOption();
+  parser.addPositionalArgument(QString::fromLatin1("file"), QString::fromLatin1("The PDF file to rasterize"));
+  QCommandLineOption pagesOption(QStringList() << QString::fromLatin1("p") << QString::fromLatin1("pages"),
+    QString::fromLatin1("Pages to rasterize (1-based), e.g. 1-3,7,10- (default: all)"), QString::fromLatin1("ranges"));
+  QCommandLineOption dpiOption(QStringList() << QString::fromLatin1("r") << QString::fromLatin1("resolution"),
+    QString::fromLatin1("Resolution in dpi (default: 150)"), QString::fromLatin1("dpi"), QString::fromLatin1("150"));
+  QCommandLineOption jobsOption(QStringList() << QString::fromLatin1("j") << QString::fromLatin1("jobs"),
+    QString::fromLatin1("Number of parallel workers (default: number of CPU cores)"), QString::fromLatin1("n"),
+    QString::number(QThread::idealThreadCount()));
+  QCommandLineOption outputOption(QStringList() << QString::fromLatin1("o") << QString::fromLatin1("output"),
+    QString::fromLatin1("Write the images to files named after <pattern>, in which %p is replaced by the page number; the format is determined by the suffix (default: don't write images)"),
+    QString::fromLatin1("pattern"));
+  QCommandLineOption passwordOption(QString::fromLatin1("password"),
+    QString::fromLatin1("Password to unlock the document with"), QString::fromLatin1("password"));
+  parser.addOption(pagesOption);
+  parser.addOption(dpiOption);
+  parser.addOption(jobsOption);
+  parser.addOption(outputOption);
+  parser.addOption(passwordOption);
+  parser.process(app);
+
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  if (parser.positionalArguments().size() != 1) {
+    err << parser.helpText();
+    return 2;
+  }
+  const QString fileName = parser.positionalArguments().first();
+
+  bool ok1, ok2;
+  Job job;
+  job.dpi = parser.value(dpiOption).toDouble(&ok1);
+  const int numWorkers = parser.value(jobsOption).toInt(&ok2);
+  if (!ok1 || job.dpi <= 0 || !ok2 || numWorkers < 1) {
+    err << "Invalid resolution or number of jobs\n";
+    return 2;
+  }
+  job.outputPattern = parser.value(outputOption);
+  if (!job.outputPattern.isEmpty() && !job.outputPattern.contains(QString::fromLatin1("%p"))) {
+    err << "The output pattern must contain %p\n";
+    return 2;
+  }
+
+  // Load one document instance per worker. NB: This happens sequentially
+  // (and in the main thread) as the backends' global initialization may not
+  // be thread-safe.
+  QElapsedTimer timer;
+  timer.start();
+  Backend backend;
+  QList<pDoc> docs;
+  for (int i = 0; i < numWorkers; ++i) {
+    pDoc doc = backend.newDocument(fileName);
+    if (doc && doc->isLocked() && parser.isSet(passwordOption))
+      doc->unlock(parser.value(passwordOption));
+    if (!doc || !doc->isValid() || doc->isLocked()) {
+      err << "Could not open " << fileName << "\n";
+      return 2;
+    }
+    docs << doc;
+  }
+  const qint64 loadTime = timer.elapsed();
+
+  if (!parsePages(parser.value(pagesOption), docs.first()->numPages(), job.pages)) {
+    err << "Invalid page range (the document has " << docs.first()->numPages() << " pages)\n";
+    return 2;
+  }
+
+  if (QThreadPool::globalInstance()->maxThreadCount() < numWorkers)
+    QThreadPool::globalInstance()->setMaxThreadCount(numWorkers);
+
+  timer.restart();
+  QList< QFuture< QList<PageResult> > > futures;
+  for (int i = 0; i < numWorkers; ++i)
+    futures << QtConcurrent::run(rasterize, &job, docs[i], i);
+  QList<PageResult> results;
+  for (int i = 0; i < futures.size(); ++i)
+    results << futures[i].result();
+  const qint64 wallTime = timer.elapsed();
+  qSort(results.begin(), results.end(), pageLessThan);
+
+  int failed = 0;
+  qint64 renderTime = 0, slowest = 0;
+  out << "# page\tworker\tms\twidth\theight\tstatus\n";
+  foreach (PageResult result, results) {
+    out << (result.page + 1) << "\t" << result.worker << "\t" << QString::number(result.usec / 1000., 'f', 3) << "\t";
+    out << result.size.width() << "\t" << result.size.height() << "\t" << (result.ok ? "ok" : "failed") << "\n";
+    renderTime += result.usec;
+    slowest = qMax(slowest, result.usec);
+    if (!result.ok)
+      ++failed;
+  }
+
+  out << "# backend: " << docs.first()->backendName() << ", workers: " << numWorkers << ", resolution: " << job.dpi << " dpi\n";
+  out << "# pages: " << results.size() << ", failed: " << failed << "\n";
+  out << "# load time (all workers): " << loadTime << " ms\n";
+  out << "# wall time: " << wallTime << " ms, render time (sum): " << renderTime / 1000 << " ms, slowest page: " << QString::number(slowest / 1000., 'f', 3) << " ms\n";
+  out << "# pages/s: " << QString::number(wallTime > 0 ? results.size() * 1000. / wallTime : 0, 'f', 2) << "\n";
+  out << "# peak memory: " << peakMemory() << " kB\n";
+
+  return (failed > 0 ? 1 : 0);
+}
+
+// vim: set sw=2 ts=2 et
@@ -0,0 +1,269 @@
+/**
+ * Copyright (C) 2013-2018  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#include "MemoryPressure.h"
+
+#include <QFile>
+#include <QMap>
+#include <QStringList>
+
+namespace QtPDF {
+
+// Default time (in ms) between checks of the available memory
+static const int MEMORY_CHECK_INTERVAL = 2000;
+// Default watermarks (see MemoryPressureMonitor)
+static const qreal MEMORY_HIGH_WATERMARK = 0.9;
+static const qreal MEMORY_LOW_WATERMARK = 0.8;
+// Fraction of the (registered) caches' total size that is released per check
+// at most; if the memory is used by somebody else, dropping all caches at once
+// would not help anyway
+static const qreal MEMORY_MAX_SHRINK_FRACTION = 0.5;
+// Maximum number of checks that are skipped if shrinking the caches did not
+// lower the memory usage (see MemoryPressureMonitor::checkMemory())
+static const int MEMORY_MAX_BACKOFF = 16;
+
+ShrinkableCache::~ShrinkableCache()
+{
+  CacheRegistry::unregisterCache(this);
+}
+
+
+// CacheRegistry
+// ============
+// NB: Recursive, so caches can be (un)registered from within shrinkCache()
+QMutex CacheRegistry::_mutex(QMutex::Recursive);
+QList<ShrinkableCache*> CacheRegistry::_caches;
+
+void CacheRegistry::registerCache(ShrinkableCache * cache)
+{
+  QMutexLocker l(&_mutex);
+  if (cache && !_caches.contains(cache))
+    _caches << cache;
+}
+
+void CacheRegistry::unregisterCache(ShrinkableCache * cache)
+{
+  QMutexLocker l(&_mutex);
+  _caches.removeAll(cache);
+}
+
+qint64 CacheRegistry::totalSize()
+{
+  QMutexLocker l(&_mutex);
+  qint64 retVal = 0;
+  foreach (ShrinkableCache * cache, _caches)
+    retVal += cache->cacheSize();
+  return retVal;
+}
+
+QList<CacheRegistry::Entry> CacheRegistry::shrink(const qint64 bytes)
+{
+  QList<Entry> retVal;
+  if (bytes <= 0)
+    return retVal;
+
+  // NB: Holding the mutex ensures that no cache is destroyed while we use it
+  QMutexLocker l(&_mutex);
+  QMultiMap<qint64, ShrinkableCache*> bySize;
+  foreach (ShrinkableCache * cache, _caches)
+    bySize.insert(cache->cacheSize(), cache);
+
+  qint64 remaining = bytes;
+  QMapIterator<qint64, ShrinkableCache*> it(bySize);
+  it.toBack();
+  while (remaining > 0 && it.hasPrevious()) {
+    it.previous();
+    // The cache may have been unregistered by a previous one in the meantime
+    if (!_caches.contains(it.value()))
+      continue;
+    Entry entry;
+    entry.name = it.value()->cacheName();
+    entry.size = it.key();
+    entry.released = qMax(qint64(0), it.value()->shrinkCache(remaining));
+    remaining -= entry.released;
+    retVal << entry;
+  }
+  return retVal;
+}
+
+
+// MemoryPressureMonitor
+// ============
+#ifdef Q_OS_LINUX
+// Returns the lines of a (small) file, e.g., in /proc or /sys
+static QList<QByteArray> readLines(const QString & fileName)
+{
+  QFile f(fileName);
+  if (!f.open(QIODevice::ReadOnly))
+    return QList<QByteArray>();
+  // NB: Files in /proc report a size of 0, so read until EOF
+  return f.readAll().split('\n');
+}
+
+// Parses "key value [unit]" lines (as in /proc/meminfo or memory.stat) into
+// a map of values in bytes
+static QMap<QByteArray, qint64> readKeyValues(const QString & fileName)
+{
+  QMap<QByteArray, qint64> retVal;
+  foreach (QByteArray line, readLines(fileName)) {
+    QList<QByteArray> fields = line.simplified().split(' ');
+    if (fields.size() < 2)
+      continue;
+    QByteArray key = fields[0];
+    if (key.endsWith(':'))
+      key.chop(1);
+    bool ok;
+    qint64 value = fields[1].toLongLong(&ok);
+    if (!ok)
+      continue;
+    if (fields.size() > 2 && fields[2] == "kB")
+      value *= 1024;
+    retVal.insert(key, value);
+  }
+  return retVal;
+}
+
+// Returns the value of a file containing a single number, or -1 if there is
+// none (e.g., for a limit of "max")
+static qint64 readValue(const QString & fileName)
+{
+  QList<QByteArray> lines = readLines(fileName);
+  bool ok;
+  qint64 value = (lines.isEmpty() ? -1 : lines.first().trimmed().toLongLong(&ok));
+  return (!lines.isEmpty() && ok ? value : -1);
+}
+
+// Determines the limit and the usage (without the easily reclaimable page
+// cache) of the memory cgroup the process is in; returns false if there is
+// no such cgroup (or it has no limit)
+static bool cgroupMemory(qint64 & limit, qint64 & usage)
+{
+  QString v1Path, v2Path;
+  // Lines are "hierarchy-ID:controller-list:cgroup-path"
+  foreach (QByteArray line, readLines(QString::fromLatin1("/proc/self/cgroup"))) {
+    QList<QByteArray> fields = line.split(':');
+    if (fields.size() < 3)
+      continue;
+    if (fields[0] == "0" && fields[1].isEmpty())
+      v2Path = QString::fromLocal8Bit(fields[2]);
+    else if (fields[1].split(',').contains("memory"))
+      v1Path = QString::fromLocal8Bit(fields[2]);
+  }
+
+  // NB: Inside containers, the cgroup of the process is usually mounted at the
+  // root, so fall back to that if the path from /proc/self/cgroup doesn't exist
+  QStringList candidates;
+  if (!v2Path.isNull()) {
+    candidates << QString::fromLatin1("/sys/fs/cgroup") + v2Path << QString::fromLatin1("/sys/fs/cgroup");
+    foreach (QString dir, candidates) {
+      limit = readValue(dir + QString::fromLatin1("/memory.max"));
+      usage = readValue(dir + QString::fromLatin1("/memory.current"));
+      if (limit > 0 && usage >= 0) {
+        usage -= readKeyValues(dir + QString::fromLatin1("/memory.stat")).value("inactive_file", 0);
+        return true;
+      }
+    }
+  }
+  if (!v1Path.isNull()) {
+    candidates.clear();
+    candidates << QString::fromLatin1("/sys/fs/cgroup/memory") + v1Path << QString::fromLatin1("/sys/fs/cgroup/memory");
+    foreach (QString dir, candidates) {
+      limit = readValue(dir + QString::fromLatin1("/memory.limit_in_bytes"));
+      usage = readValue(dir + QString::fromLatin1("/memory.usage_in_bytes"));
+      if (limit > 0 && usage >= 0) {
+        usage -= readKeyValues(dir + QString::fromLatin1("/memory.stat")).value("total_inactive_file", 0);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+#endif // defined(Q_OS_LINUX)
+
+MemoryPressureMonitor::MemoryPressureMonitor(QObject * parent /* = nullptr */) :
+  QObject(parent),
+  _highWatermark(MEMORY_HIGH_WATERMARK),
+  _lowWatermark(MEMORY_LOW_WATERMARK),
+  _usedAtShrink(-1),
+  _backoff(0),
+  _skipChecks(0)
+{
+  _timer.setInterval(MEMORY_CHECK_INTERVAL);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(checkMemory()));
+  // Don't poll in vain on systems where the memory status is not known
+  if (memoryStatus().isValid())
+    _timer.start();
+}
+
+//static
+MemoryPressureMonitor::MemoryStatus MemoryPressureMonitor::memoryStatus()
+{
+  MemoryStatus retVal;
+#ifdef Q_OS_LINUX
+  QMap<QByteArray, qint64> memInfo = readKeyValues(QString::fromLatin1("/proc/meminfo"));
+  if (!memInfo.contains("MemTotal"))
+    return retVal;
+  retVal.total = memInfo["MemTotal"];
+  // MemAvailable is only reported by kernels >= 3.14; estimate it otherwise
+  if (memInfo.contains("MemAvailable"))
+    retVal.available = memInfo["MemAvailable"];
+  else
+    retVal.available = memInfo.value("MemFree", 0) + memInfo.value("Buffers", 0) + memInfo.value("Cached", 0);
+
+  // NB: Unlimited cgroups (v1) report huge limits
+  qint64 limit, usage;
+  if (cgroupMemory(limit, usage) && limit < retVal.total) {
+    retVal.total = limit;
+    retVal.available = qBound(qint64(0), limit - usage, retVal.available);
+  }
+#endif
+  return retVal;
+}
+
+void MemoryPressureMonitor::checkMemory()
+{
+  const MemoryStatus status = memoryStatus();
+  if (!status.isValid())
+    return;
+  const qint64 used = status.total - status.available;
+  if (static_cast<qreal>(used) <= _highWatermark * static_cast<qreal>(status.total)) {
+    _usedAtShrink = -1;
+    _backoff = _skipChecks = 0;
+    return;
+  }
+
+  // If the last shrink did not lower the usage, the memory is (mostly) used
+  // elsewhere; back off (exponentially) rather than draining the caches for
+  // nothing
+  if (_skipChecks > 0) {
+    --_skipChecks;
+    return;
+  }
+  if (_usedAtShrink >= 0 && used >= _usedAtShrink) {
+    _backoff = qBound(1, 2 * _backoff, MEMORY_MAX_BACKOFF);
+    _skipChecks = _backoff;
+    _usedAtShrink = used;
+    return;
+  }
+  _backoff = 0;
+
+  const qint64 excess = used - static_cast<qint64>(qMin(_lowWatermark, _highWatermark) * static_cast<qreal>(status.total));
+  const qint64 maxShrink = static_cast<qint64>(MEMORY_MAX_SHRINK_FRACTION * static_cast<qreal>(CacheRegistry::totalSize()));
+  _lastReport = CacheRegistry::shrink(qMin(excess, maxShrink));
+  _usedAtShrink = used;
+  emit cachesShrunk(_lastReport);
+}
+
+} // namespace QtPDF
+
+// vim: set sw=2 ts=2 et
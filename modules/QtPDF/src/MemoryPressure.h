@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2013-2018  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef MemoryPressure_H
+#define MemoryPressure_H
+
+#include <QObject>
+#include <QTimer>
+#include <QMutex>
+#include <QList>
+
+namespace QtPDF {
+
+// Interface for caches (and similar structures) that can give memory back,
+// e.g., when the system runs low on memory (see MemoryPressureMonitor).
+// Implementations register themselves with CacheRegistry; they are
+// unregistered automatically when they are destroyed, but classes whose
+// shrinkCache() must not run during their destruction should call
+// CacheRegistry::unregisterCache() at the beginning of their destructor.
+class ShrinkableCache
+{
+public:
+  ShrinkableCache() { }
+  virtual ~ShrinkableCache();
+
+  // Name used in reports (see CacheRegistry::shrink())
+  virtual QString cacheName() const = 0;
+  // Approximate amount of memory (in bytes) held by the cache
+  virtual qint64 cacheSize() const = 0;
+  // Releases about `bytes` bytes (or as much as possible), e.g., by dropping
+  // the least recently used entries. Returns the number of bytes actually
+  // released (as far as that can be told).
+  virtual qint64 shrinkCache(const qint64 bytes) = 0;
+};
+
+// Central list of all ShrinkableCache objects.
+// This class is thread-safe. However, shrink() calls shrinkCache() in the
+// calling thread, so caches that may only be touched from the GUI thread
+// require shrink() to be called from there (as MemoryPressureMonitor does).
+class CacheRegistry
+{
+public:
+  struct Entry {
+    QString name;
+    // Size (in bytes) before shrinking
+    qint64 size;
+    qint64 released;
+  };
+
+  static void registerCache(ShrinkableCache * cache);
+  static void unregisterCache(ShrinkableCache * cache);
+  // Total size (in bytes) of all registered caches
+  static qint64 totalSize();
+  // Asks the caches (largest first) to release a total of `bytes` bytes.
+  // Returns how much each cache that was asked held and released.
+  static QList<Entry> shrink(const qint64 bytes);
+
+private:
+  static QMutex _mutex;
+  // Guarded by _mutex
+  static QList<ShrinkableCache*> _caches;
+};
+
+// Periodically checks how much memory is available and asks the registered
+// caches (see CacheRegistry) to shrink if it runs low. Memory counts as low if
+// more than highWatermark() of the total memory is in use; the caches are then
+// asked to release enough memory to get down to lowWatermark(), but at most
+// half of what they hold per check. If that doesn't lower the usage (e.g.,
+// because the memory is used by another process), further checks are skipped
+// for a while.
+// On Linux, the total and available memory are read from /proc/meminfo and
+// the limits of the memory cgroup the process is in (if any), whichever is
+// lower. On other systems the monitor does nothing.
+class MemoryPressureMonitor : public QObject
+{
+  Q_OBJECT
+
+public:
+  struct MemoryStatus {
+    // Memory (in bytes) the process could use at most (physical memory or the
+    // cgroup limit) and how much of it is currently available
+    qint64 total;
+    qint64 available;
+    MemoryStatus() : total(-1), available(-1) { }
+    bool isValid() const { return total > 0 && available >= 0; }
+  };
+
+  MemoryPressureMonitor(QObject * parent = nullptr);
+  virtual ~MemoryPressureMonitor() { }
+
+  // Returns an invalid status if it can't be determined (e.g., on systems
+  // other than Linux)
+  static MemoryStatus memoryStatus();
+
+  // Fractions (between 0 and 1) of the total memory
+  qreal highWatermark() const { return _highWatermark; }
+  void setHighWatermark(const qreal watermark) { _highWatermark = qBound(qreal(0), watermark, qreal(1)); }
+  qreal lowWatermark() const { return _lowWatermark; }
+  void setLowWatermark(const qreal watermark) { _lowWatermark = qBound(qreal(0), watermark, qreal(1)); }
+  // Time (in ms) between checks
+  int interval() const { return _timer.interval(); }
+  void setInterval(const int msecs) { _timer.setInterval(msecs); }
+
+  // Result of the last time the caches had to be shrunk
+  QList<CacheRegistry::Entry> lastReport() const { return _lastReport; }
+
+public slots:
+  void checkMemory();
+
+signals:
+  void cachesShrunk(const QList<QtPDF::CacheRegistry::Entry> & report);
+
+private:
+  QTimer _timer;
+  qreal _highWatermark;
+  qreal _lowWatermark;
+  QList<CacheRegistry::Entry> _lastReport;
+  // Memory usage when the caches were last asked to shrink (or -1)
+  qint64 _usedAtShrink;
+  // Number of checks skipped the last time shrinking didn't help, and the
+  // number of checks that remain to be skipped
+  int _backoff;
+  int _skipChecks;
+};
+
+} // namespace QtPDF
+
+#endif // MemoryPressure_H
+
+// vim: set sw=2 ts=2 et
@@ -15,6 +15,8 @@
 #include <PDFBackend.h>
 #include <QPainter>
 #include <QApplication>
+#include <QFile>
+#include <QCryptographicHash>
 
 namespace QtPDF {
 
@@ -23,6 +25,14 @@ namespace Backend {
 // TODO: Find a better place to put this
 static QBrush * pageDummyBrush = nullptr;
 
+// Maximum number of characters shown before and after a match in
+// SearchResult::context
+static const int SEARCH_CONTEXT_LENGTH = 40;
+
+// Maximum number of links (plus one per page) kept in the link cache (see
+// Document::cachedLinks())
+static const int LINK_CACHE_SIZE = 100000;
+
 QDateTime fromPDFDate(QString pdfDate)
 {
   QDate date;
@@ -149,14 +159,221 @@ QString PDFFontDescriptor::pureName() const
 }
 
 
+// Render Statistics
+// =================
+RenderStatistics::Histogram::Histogram() :
+  _count(0),
+  _total(0),
+  _max(0)
+{
+  for (int i = 0; i < BucketCount; ++i)
+    _buckets[i] = 0;
+}
+
+void RenderStatistics::Histogram::add(const qint64 usec)
+{
+  int i = 0;
+  for (qint64 ms = usec / 1000; ms > 0 && i < BucketCount - 1; ms >>= 1)
+    ++i;
+  ++_buckets[i];
+  ++_count;
+  _total += usec;
+  if (usec > _max)
+    _max = usec;
+}
+
+double RenderStatistics::Histogram::percentile(const double p) const
+{
+  if (_count == 0)
+    return 0;
+  // The last bucket has no upper bound; use the maximum instead
+  quint64 n = 0;
+  for (int i = 0; i < BucketCount - 1; ++i) {
+    n += _buckets[i];
+    if (static_cast<double>(n) >= p * static_cast<double>(_count))
+      return qMin<double>(1 << i, max());
+  }
+  return max();
+}
+
+QVariantMap RenderStatistics::Histogram::toVariantMap() const
+{
+  QVariantMap retVal;
+  QVariantList buckets;
+  for (int i = 0; i < BucketCount; ++i)
+    buckets << _buckets[i];
+  retVal[QString::fromLatin1("count")] = _count;
+  retVal[QString::fromLatin1("mean")] = mean();
+  retVal[QString::fromLatin1("median")] = percentile(0.5);
+  retVal[QString::fromLatin1("p95")] = percentile(0.95);
+  retVal[QString::fromLatin1("max")] = max();
+  retVal[QString::fromLatin1("buckets")] = buckets;
+  return retVal;
+}
+
+RenderStatistics::Snapshot::Snapshot() :
+  enabled(false),
+  elapsed(0),
+  bytesCached(0),
+  residentPages(0)
+{
+  for (int i = 0; i < CounterCount; ++i)
+    counters[i] = 0;
+}
+
+double RenderStatistics::Snapshot::cacheHitRate() const
+{
+  quint64 lookups = counters[CacheHits] + counters[PlaceholderHits] + counters[CacheMisses];
+  return (lookups > 0 ? static_cast<double>(counters[CacheHits]) / static_cast<double>(lookups) : 0);
+}
+
+double RenderStatistics::Snapshot::tilesPerSecond() const
+{
+  return (elapsed > 0 ? static_cast<double>(counters[TilesRendered]) * 1000. / static_cast<double>(elapsed) : 0);
+}
+
+QVariantMap RenderStatistics::Snapshot::toVariantMap() const
+{
+  QVariantMap retVal;
+  retVal[QString::fromLatin1("enabled")] = enabled;
+  retVal[QString::fromLatin1("backend")] = backend;
+  retVal[QString::fromLatin1("elapsed")] = elapsed;
+  retVal[QString::fromLatin1("queueWait")] = queueWait.toVariantMap();
+  retVal[QString::fromLatin1("renderTime")] = renderTime.toVariantMap();
+  retVal[QString::fromLatin1("tilesRendered")] = counters[TilesRendered];
+  retVal[QString::fromLatin1("rendersAborted")] = counters[RendersAborted];
+  retVal[QString::fromLatin1("cacheHits")] = counters[CacheHits];
+  retVal[QString::fromLatin1("placeholderHits")] = counters[PlaceholderHits];
+  retVal[QString::fromLatin1("cacheMisses")] = counters[CacheMisses];
+  retVal[QString::fromLatin1("placeholdersCreated")] = counters[PlaceholdersCreated];
+  retVal[QString::fromLatin1("tilesPrefetched")] = counters[TilesPrefetched];
+  retVal[QString::fromLatin1("linkCacheHits")] = counters[LinkCacheHits];
+  retVal[QString::fromLatin1("linksRequested")] = counters[LinksRequested];
+  retVal[QString::fromLatin1("cacheHitRate")] = cacheHitRate();
+  retVal[QString::fromLatin1("tilesPerSecond")] = tilesPerSecond();
+  retVal[QString::fromLatin1("bytesCached")] = bytesCached;
+  retVal[QString::fromLatin1("residentPages")] = residentPages;
+  return retVal;
+}
+
+RenderStatistics::RenderStatistics() :
+  _enabled(0)
+{
+  reset();
+}
+
+void RenderStatistics::setEnabled(const bool enabled)
+{
+  if (enabled == isEnabled())
+    return;
+  if (enabled)
+    reset();
+  _enabled.storeRelease(enabled ? 1 : 0);
+}
+
+void RenderStatistics::reset()
+{
+  QMutexLocker l(&_mutex);
+  _timer.start();
+  _queueWait = Histogram();
+  _renderTime = Histogram();
+  for (int i = 0; i < CounterCount; ++i)
+    _counters[i] = 0;
+}
+
+void RenderStatistics::addQueueWait(const qint64 usec)
+{
+  if (!isEnabled())
+    return;
+  QMutexLocker l(&_mutex);
+  _queueWait.add(usec);
+}
+
+void RenderStatistics::addRenderTime(const qint64 usec)
+{
+  if (!isEnabled())
+    return;
+  QMutexLocker l(&_mutex);
+  _renderTime.add(usec);
+}
+
+void RenderStatistics::increment(const Counter counter)
+{
+  if (!isEnabled())
+    return;
+  QMutexLocker l(&_mutex);
+  ++_counters[counter];
+}
+
+RenderStatistics::Snapshot RenderStatistics::snapshot() const
+{
+  Snapshot retVal;
+  retVal.enabled = isEnabled();
+  QMutexLocker l(&_mutex);
+  retVal.elapsed = _timer.elapsed();
+  retVal.queueWait = _queueWait;
+  retVal.renderTime = _renderTime;
+  for (int i = 0; i < CounterCount; ++i)
+    retVal.counters[i] = _counters[i];
+  return retVal;
+}
+
+
+// FileSource
+// ==========
+QMutex FileSource::_registryMutex;
+QHash< QString, QWeakPointer<const FileSource> > FileSource::_registry;
+
+//static
+QSharedPointer<const FileSource> FileSource::open(const QString & fileName)
+{
+  QFileInfo fi(fileName);
+  if (!fi.exists())
+    return QSharedPointer<const FileSource>();
+  const QString key = fi.canonicalFilePath();
+
+  QMutexLocker l(&_registryMutex);
+  QSharedPointer<const FileSource> retVal(_registry.value(key).toStrongRef());
+  if (retVal && retVal->size() == fi.size() && retVal->lastModified() == fi.lastModified())
+    return retVal;
+
+  // NB: The file is read rather than memory-mapped. TeX rewrites the PDF in
+  // place, which would invalidate (or, on Windows, be blocked by) a mapping
+  // while a document still uses it.
+  QFile file(key);
+  if (!file.open(QIODevice::ReadOnly))
+    return QSharedPointer<const FileSource>();
+  retVal = QSharedPointer<const FileSource>(new FileSource(file.readAll(), fi.lastModified()));
+
+  // Drop registry entries of files no longer in use
+  QMutableHashIterator< QString, QWeakPointer<const FileSource> > it(_registry);
+  while (it.hasNext()) {
+    if (it.next().value().isNull())
+      it.remove();
+  }
+  _registry[key] = retVal;
+  return retVal;
+}
+
+//static
+bool FileSource::isRegistered(const QString & fileName)
+{
+  const QString key = QFileInfo(fileName).canonicalFilePath();
+  QMutexLocker l(&_registryMutex);
+  return _registry.contains(key);
+}
+
+
 // Backend Rendering
 // =================
 // The `PDFPageProcessingThread` is a thread that processes background jobs.
 // Each job is represented by a subclass of `PageProcessingRequest` and
 // contains an `execute` method that performs the actual work.
 PDFPageProcessingThread::PDFPageProcessingThread() :
+  _currentWorkItem(nullptr),
   _idle(true),
-  _quit(false)
+  _quit(false),
+  _statistics(new RenderStatistics())
 {
 }
 
@@ -164,12 +381,14 @@ PDFPageProcessingThread::~PDFPageProcessingThread()
 {
   _mutex.lock();
   _quit = true;
+  if (_currentWorkItem)
+    _currentWorkItem->abort();
   _waitCondition.wakeAll();
   _mutex.unlock();
   wait();
 }
 
-void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * request)
+void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * request, const Priority priority /* = NormalPriority */)
 {
 
   if (!request)
@@ -201,7 +420,12 @@ void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * r
   }
 */
 
-  _workStack.push(request);
+  if (_statistics->isEnabled())
+    request->queueTimer.start();
+  if (priority == LowPriority)
+    _lowPriorityWorkStack.push(request);
+  else
+    _workStack.push(request);
 #ifdef DEBUG
   qDebug() << "new request:" << *request;
 #endif
@@ -221,15 +445,32 @@ void PDFPageProcessingThread::run()
   _idle = false;
   while (!_quit) {
     // mutex must be locked at start of loop
-    if (!_workStack.empty()) {
-      workItem = _workStack.pop();
+    if (!_workStack.empty() || !_lowPriorityWorkStack.empty()) {
+      // Low priority items are only considered if nothing else is pending
+      workItem = (!_workStack.empty() ? _workStack.pop() : _lowPriorityWorkStack.pop());
+      _currentWorkItem = workItem;
       _mutex.unlock();
 
 #ifdef DEBUG
-      qDebug() << "processing work item" << *workItem << "; remaining items:" << _workStack.size();
+      qDebug() << "processing work item" << *workItem << "; remaining items:" << _workStack.size() << "+" << _lowPriorityWorkStack.size() << "low priority";
       _renderTimer.start();
 #endif
-      workItem->execute();
+      // NB: Only query the clock if statistics are actually collected
+      QElapsedTimer executionTimer;
+      if (_statistics->isEnabled()) {
+        if (workItem->queueTimer.isValid())
+          _statistics->addQueueWait(workItem->queueTimer.nsecsElapsed() / 1000);
+        executionTimer.start();
+      }
+      bool finished = workItem->execute();
+      if (executionTimer.isValid() && workItem->type() == PageProcessingRequest::PageRendering) {
+        if (finished) {
+          _statistics->addRenderTime(executionTimer.nsecsElapsed() / 1000);
+          _statistics->increment(RenderStatistics::TilesRendered);
+        }
+        else
+          _statistics->increment(RenderStatistics::RendersAborted);
+      }
 #ifdef DEBUG
       QString jobDesc;
       switch (workItem->type()) {
@@ -239,8 +480,13 @@ void PDFPageProcessingThread::run()
         case PageProcessingRequest::PageRendering:
           jobDesc = QString::fromUtf8("rendering page");
           break;
+        case PageProcessingRequest::ContentBoundingBox:
+          jobDesc = QString::fromUtf8("computing content bounding box");
+          break;
       }
-      qDebug() << "finished " << jobDesc << "for page" << workItem->page->pageNum() << ". Time elapsed: " << _renderTimer.elapsed() << " ms.";
+      qDebug() << (finished ? "finished " : "aborted ") << jobDesc << "for page" << workItem->page->pageNum() << ". Time elapsed: " << _renderTimer.elapsed() << " ms.";
+#else
+      Q_UNUSED(finished)
 #endif
 
       // Delete the work item as it has fulfilled its purpose
@@ -252,6 +498,8 @@ void PDFPageProcessingThread::run()
       workItem->deleteLater();
 
       _mutex.lock();
+      _currentWorkItem = nullptr;
+      _workItemDoneCondition.wakeAll();
     }
     else {
 #ifdef DEBUG
@@ -273,22 +521,98 @@ void PDFPageProcessingThread::clearWorkStack()
 {
   _mutex.lock();
 
-  foreach(PageProcessingRequest * workItem, _workStack) {
+  foreach(PageProcessingRequest * workItem, _workStack + _lowPriorityWorkStack) {
     if (!workItem)
       continue;
     Q_ASSERT(workItem->thread() == QApplication::instance()->thread());
     workItem->deleteLater();
   }
   _workStack.clear();
+  _lowPriorityWorkStack.clear();
 
   if (!_idle) {
-    // Wait until the current operation finishes
+    // Abort the current operation and wait until it returns. As the backends
+    // check the abort token regularly (e.g., in Poppler's abort callback), this
+    // usually takes no more than a few milliseconds even for heavy pages.
+    if (_currentWorkItem)
+      _currentWorkItem->abort();
     _idleCondition.wait(&_mutex);
   }
   _mutex.unlock();
 }
 
 
+void PDFPageProcessingThread::cancelRequests(const QObject * listener)
+{
+  cancelMatchingRequests(QSet<const QObject*>() << listener, nullptr, false);
+}
+
+void PDFPageProcessingThread::cancelRequests(const QObject * listener, const PageProcessingRequest::Type type)
+{
+  cancelMatchingRequests(QSet<const QObject*>() << listener, &type, false);
+}
+
+void PDFPageProcessingThread::cancelRequests(const QSet<const QObject*> & listeners, const PageProcessingRequest::Type type)
+{
+  cancelMatchingRequests(listeners, &type, false);
+}
+
+void PDFPageProcessingThread::cancelRenderRequests(const QObject * listener, const QSet<PDFPageTile> & keep)
+{
+  QMutexLocker locker(&_mutex);
+
+  QStack<PageProcessingRequest*> * stacks[] = { &_workStack, &_lowPriorityWorkStack };
+  for (size_t j = 0; j < sizeof(stacks) / sizeof(stacks[0]); ++j) {
+    QStack<PageProcessingRequest*> * stack = stacks[j];
+    for (int i = stack->size() - 1; i >= 0; --i) {
+      PageProcessingRequest * workItem = (*stack)[i];
+      if (!workItem || workItem->listener != listener || workItem->type() != PageProcessingRequest::PageRendering)
+        continue;
+      PageProcessingRenderPageRequest * renderItem = static_cast<PageProcessingRenderPageRequest*>(workItem);
+      if (keep.contains(PDFPageTile(renderItem->xres, renderItem->yres, renderItem->render_box, renderItem->page->pageNum(), renderItem->color_filter)))
+        continue;
+      Q_ASSERT(workItem->thread() == QApplication::instance()->thread());
+      workItem->discard();
+      workItem->deleteLater();
+      stack->remove(i);
+    }
+  }
+}
+
+void PDFPageProcessingThread::cancelRequestsAndWait(const QObject * listener)
+{
+  cancelMatchingRequests(QSet<const QObject*>() << listener, nullptr, true);
+}
+
+void PDFPageProcessingThread::cancelMatchingRequests(const QSet<const QObject*> & listeners, const PageProcessingRequest::Type * type, const bool wait)
+{
+  QMutexLocker locker(&_mutex);
+
+  QStack<PageProcessingRequest*> * stacks[] = { &_workStack, &_lowPriorityWorkStack };
+  for (size_t j = 0; j < sizeof(stacks) / sizeof(stacks[0]); ++j) {
+    QStack<PageProcessingRequest*> * stack = stacks[j];
+    for (int i = stack->size() - 1; i >= 0; --i) {
+      PageProcessingRequest * workItem = (*stack)[i];
+      if (!workItem || !listeners.contains(workItem->listener) || (type && workItem->type() != *type))
+        continue;
+      Q_ASSERT(workItem->thread() == QApplication::instance()->thread());
+      workItem->discard();
+      workItem->deleteLater();
+      stack->remove(i);
+    }
+  }
+
+  // If the current operation is for one of the `listeners`, abort it. If
+  // requested, wait until it returns (it could post an event otherwise).
+  if (_currentWorkItem && listeners.contains(_currentWorkItem->listener) && (!type || _currentWorkItem->type() == *type))
+    _currentWorkItem->abort();
+  while (wait && _currentWorkItem && listeners.contains(_currentWorkItem->listener) && (!type || _currentWorkItem->type() == *type)) {
+    _currentWorkItem->abort();
+    _workItemDoneCondition.wait(&_mutex);
+  }
+}
+
+
 // Asynchronous Page Operations
 // ----------------------------
 //
@@ -299,6 +623,14 @@ void PDFPageProcessingThread::clearWorkStack()
 // `listener` will need a custom `event` function that is capable of picking up
 // on these events.
 
+PageProcessingRequest::PageProcessingRequest(Page * page, QObject * listener) :
+  page(page),
+  listener(listener),
+  abortToken(AbortToken::create()),
+  _pageRef(page ? page->sharedFromThis() : QSharedPointer<Page>())
+{
+}
+
 bool PageProcessingRequest::operator==(const PageProcessingRequest & r) const
 {
   // TODO: Should we care about the listener here as well?
@@ -311,7 +643,7 @@ bool PageProcessingRenderPageRequest::operator==(const PageProcessingRequest & r
     return false;
   const PageProcessingRenderPageRequest * rr = dynamic_cast<const PageProcessingRenderPageRequest*>(&r);
   // TODO: Should we care about the listener here as well?
-  return (qFuzzyCompare(xres, rr->xres) && qFuzzyCompare(yres, rr->yres) && render_box == rr->render_box && cache == rr->cache);
+  return (qFuzzyCompare(xres, rr->xres) && qFuzzyCompare(yres, rr->yres) && render_box == rr->render_box && cache == rr->cache && color_filter == rr->color_filter);
 }
 
 #ifdef DEBUG
@@ -325,25 +657,51 @@ PageProcessingRenderPageRequest::operator QString() const
 // These are the events posted by `execute` functions.
 const QEvent::Type PDFPageRenderedEvent::PageRenderedEvent = static_cast<QEvent::Type>( QEvent::registerEventType() );
 const QEvent::Type PDFLinksLoadedEvent::LinksLoadedEvent = static_cast<QEvent::Type>( QEvent::registerEventType() );
+const QEvent::Type PDFContentBoundingBoxEvent::ContentBoundingBoxEvent = static_cast<QEvent::Type>( QEvent::registerEventType() );
 
 bool PageProcessingRenderPageRequest::execute()
 {
-  // TODO: Aborting renders doesn't really work right now---the backend knows
-  // nothing about the PDF scenes.
-  //
-  // Idea: Perhaps allow page render requests to provide a pointer to a function
-  // that returns a `bool` value indicating if the request is still valid? Then
-  // the `PDFPageGraphicsItem` could have a function that indicates if the item
-  // is anywhere near a viewport.
-  QImage rendered_page = page->renderToImage(xres, yres, render_box, cache);
-  QCoreApplication::postEvent(listener, new PDFPageRenderedEvent(xres, yres, render_box, rendered_page));
+  if (isAborted()) {
+    discard();
+    return false;
+  }
+
+  QImage rendered_page = page->renderToFilteredImage(xres, yres, render_box, cache, color_filter, abortToken);
+
+  if (isAborted()) {
+    discard();
+    return false;
+  }
+
+  QCoreApplication::postEvent(listener, new PDFPageRenderedEvent(xres, yres, render_box, rendered_page, page->pageNum(), color_filter));
 
   return true;
 }
 
+void PageProcessingRenderPageRequest::discard()
+{
+  // The placeholder tile that was put into the cache when this request was
+  // issued must not stay there indefinitely; mark it outdated so it gets
+  // requested again the next time it is painted.
+  if (!cache)
+    return;
+  Document * doc = page->document();
+  if (doc)
+    doc->pageCache().markOutdated(PDFPageTile(xres, yres, render_box, page->pageNum(), color_filter));
+}
+
 bool PageProcessingLoadLinksRequest::execute()
 {
-  QCoreApplication::postEvent(listener, new PDFLinksLoadedEvent(page->loadLinks()));
+  if (isAborted())
+    return false;
+
+  QList< QSharedPointer<Annotation::Link> > links = page->loadLinks(abortToken);
+  if (isAborted())
+    return false;
+
+  Document::cacheLinks(page->linkCacheKey(), links);
+
+  QCoreApplication::postEvent(listener, new PDFLinksLoadedEvent(links));
   return true;
 }
 
@@ -354,6 +712,42 @@ PageProcessingLoadLinksRequest::operator QString() const
 }
 #endif
 
+PageProcessingContentBoundingBoxRequest::~PageProcessingContentBoundingBoxRequest()
+{
+  // See Page::asyncContentBoundingBox()
+  if (!listener && page)
+    page->_contentBoundingBoxQueued[highPrecision ? 1 : 0].storeRelease(0);
+}
+
+bool PageProcessingContentBoundingBoxRequest::operator==(const PageProcessingRequest & r) const
+{
+  if (!PageProcessingRequest::operator==(r))
+    return false;
+  const PageProcessingContentBoundingBoxRequest * rr = dynamic_cast<const PageProcessingContentBoundingBoxRequest*>(&r);
+  return (highPrecision == rr->highPrecision);
+}
+
+bool PageProcessingContentBoundingBoxRequest::execute()
+{
+  if (isAborted())
+    return false;
+
+  // NB: The result is cached in the page, so this is cheap if it has been
+  // computed before (e.g., if several requests were queued for the same page)
+  QRectF bbox = page->getContentBoundingBox(highPrecision);
+
+  if (listener)
+    QCoreApplication::postEvent(listener, new PDFContentBoundingBoxEvent(page->pageNum(), bbox));
+  return true;
+}
+
+#ifdef DEBUG
+PageProcessingContentBoundingBoxRequest::operator QString() const
+{
+  return QString::fromUtf8("BB:%1%2").arg(page->pageNum()).arg(highPrecision ? QString::fromUtf8("+") : QString());
+}
+#endif
+
 #ifdef DEBUG
 PDFPageTile::operator QString() const
 {
@@ -398,11 +792,103 @@ inline uint qHash(const double &d)
   return hash(reinterpret_cast<const uchar*>(&d), sizeof(d));
 }
 
+// ### Colour Filters
+uint qHash(const PDFPageColorFilter & filter)
+{
+  return qHash(QPair<int, uint>(filter.type(), filter.paperColor()));
+}
+
+// NOTE: The kernels below work on whole scan lines of 32bit pixels using only
+// integer arithmetic without branches in the inner loops, so compilers can
+// auto-vectorize them (SSE2/NEON).
+static void grayScaleScanLine(quint32 * px, const int n)
+{
+  for (int i = 0; i < n; ++i) {
+    const quint32 p = px[i];
+    // Same weights as qGray(): (11 * r + 16 * g + 5 * b) / 32
+    const quint32 gray = (((p >> 16) & 0xff) * 11 + ((p >> 8) & 0xff) * 16 + (p & 0xff) * 5) >> 5;
+    px[i] = (p & 0xff000000) | (gray << 16) | (gray << 8) | gray;
+  }
+}
+
+static void invertScanLine(quint32 * px, const int n, const bool premultiplied)
+{
+  if (!premultiplied) {
+    for (int i = 0; i < n; ++i)
+      px[i] ^= 0x00ffffff;
+    return;
+  }
+  // For premultiplied colors, the inverse of c is alpha - c
+  for (int i = 0; i < n; ++i) {
+    const quint32 p = px[i];
+    const quint32 a = p >> 24;
+    px[i] = (p & 0xff000000) | ((a - ((p >> 16) & 0xff)) << 16) | ((a - ((p >> 8) & 0xff)) << 8) | (a - (p & 0xff));
+  }
+}
+
+// Multiplies each color component by the respective component of `paper`, so
+// white becomes `paper` and black stays black. This also works for
+// premultiplied colors.
+static void paperColorScanLine(quint32 * px, const int n, const QRgb paper)
+{
+  const quint32 pr = qRed(paper), pg = qGreen(paper), pb = qBlue(paper);
+  for (int i = 0; i < n; ++i) {
+    const quint32 p = px[i];
+    // Exact (rounded) division by 255: t = x + 128; (t + (t >> 8)) >> 8
+    quint32 r = ((p >> 16) & 0xff) * pr + 128;
+    quint32 g = ((p >> 8) & 0xff) * pg + 128;
+    quint32 b = (p & 0xff) * pb + 128;
+    r = (r + (r >> 8)) >> 8;
+    g = (g + (g >> 8)) >> 8;
+    b = (b + (b >> 8)) >> 8;
+    px[i] = (p & 0xff000000) | (r << 16) | (g << 8) | b;
+  }
+}
+
+void PDFPageColorFilter::apply(QImage & img) const
+{
+  if (isNull() || img.isNull())
+    return;
+
+  switch (img.format()) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+      break;
+    default:
+      img = img.convertToFormat(QImage::Format_ARGB32);
+      break;
+  }
+  const bool premultiplied = (img.format() == QImage::Format_ARGB32_Premultiplied);
+  const int w = img.width();
+
+  for (int y = 0; y < img.height(); ++y) {
+    // NB: scanLine() detaches the image (if necessary), so we never alter
+    // images shared with others (e.g., the cache)
+    quint32 * px = reinterpret_cast<quint32*>(img.scanLine(y));
+    switch (_type) {
+      case Filter_GrayScale:
+        grayScaleScanLine(px, w);
+        break;
+      case Filter_Invert:
+        invertScanLine(px, w, premultiplied);
+        break;
+      case Filter_PaperColor:
+        paperColorScanLine(px, w, _paperColor);
+        break;
+      case Filter_None:
+        break;
+    }
+  }
+}
+
 // ### Cache for Rendered Images
-inline uint qHash(const PDFPageTile &tile)
+uint qHash(const PDFPageTile &tile)
 {
   uint h1 = qHash(QPair<uint, uint>(qHash(tile.xres), qHash(tile.yres)));
   uint h2 = qHash(QPair<uint,int>(qHash(tile.render_box), tile.page_num));
+  if (!tile.color_filter.isNull())
+    h2 = qHash(QPair<uint, uint>(h2, qHash(tile.color_filter)));
   return qHash(QPair<uint, uint>(h1, h2));
 }
 
@@ -426,6 +912,19 @@ PDFPageCache::TileStatus PDFPageCache::getStatus(const PDFPageTile & tile) const
   return retVal;
 }
 
+qint64 PDFPageCache::shrink(const qint64 bytes)
+{
+  QWriteLocker l(&_lock);
+  const int before = totalCost();
+  const int oldMaxCost = maxCost();
+  // QCache drops the least recently used images when its capacity is lowered
+  // NB: As with images dropped to make room for new ones, the status of the
+  // tiles is kept (see _tileStatus)
+  setMaxCost(static_cast<int>(qMax(qint64(0), before - bytes)));
+  setMaxCost(oldMaxCost);
+  return before - totalCost();
+}
+
 QSharedPointer<QImage> PDFPageCache::setImage(const PDFPageTile & tile, QImage * image, const TileStatus status, const bool overwrite /* = true */)
 {
   _lock.lockForWrite();
@@ -470,6 +969,14 @@ void PDFPageCache::markOutdated()
     it.value() = OUTDATED;
 }
 
+void PDFPageCache::markOutdated(const PDFPageTile & tile)
+{
+  QWriteLocker l(&_lock);
+  QMap<PDFPageTile, TileStatus>::iterator it = _tileStatus.find(tile);
+  if (it != _tileStatus.end())
+    it.value() = OUTDATED;
+}
+
 
 // PDF ABCs
 // ========
@@ -477,16 +984,36 @@ void PDFPageCache::markOutdated()
 // Document Class
 // --------------
 //
-// This class is thread-safe. Data access is governed by the QReadWriteLock
-// _docLock.
+// This class is thread-safe. Modifications (reloading, unlocking, etc.) are
+// governed by the QReadWriteLock _docLock. Readers of document-level data
+// (meta data, number of pages, page objects) don't lock at all, though.
+// Instead, the backends fill the protected staging members (_numPages,
+// _meta_title, ...) while holding the doc-write-lock and then call
+// publishMetaData(), which atomically replaces the immutable MetaData snapshot
+// that all getters read from. Similarly, page objects live in an immutable-size
+// PageTable that is replaced atomically when the pages are cleared (e.g., on
+// reload).
+// To keep the memory usage flat for huge documents, only a limited number of
+// page objects are held at any time (see setMaxResidentPages()). Each access
+// through page() stamps the page with the value of a global access clock; when
+// a new page object exceeds the limit, the one with the oldest stamp is removed
+// from the table. Items in the view only hold weak references and simply ask
+// for the page again if it was evicted (keeping its size themselves).
 Document::Document(QString fileName):
+  _pageCache(new PDFPageCache()),
   _numPages(-1),
   _fileName(fileName),
   _meta_fileSize(0),
   _meta_trapped(Trapped_Unknown),
-  _docLock(new QReadWriteLock(QReadWriteLock::Recursive))
+  _docLock(new QReadWriteLock(QReadWriteLock::Recursive)),
+  _metaData(new MetaData()),
+  _pageTable(new PageTable(0)),
+  _maxResidentPages(256)
 {
   Q_ASSERT(_docLock != nullptr);
+  // Make the file name available right away (the backend publishes all other
+  // data once it has parsed the document)
+  publishMetaData();
 
 #ifdef DEBUG
 //  qDebug() << "Document::Document(" << fileName << ")";
@@ -497,7 +1024,11 @@ Document::Document(QString fileName):
   //
   // NOTE: The application seems to exceed 1 GB---usage plateaus at around 2GB. No idea why. Perhaps freed
   // blocks are not garbage collected?? Perhaps my math is off??
-  _pageCache.setMaxSize(1024 * 1024 * 1024);
+  _pageCache->setMaxSize(1024 * 1024 * 1024);
+
+  // NB: shrinkCache() only uses members of this class, so it is safe to
+  // register here (and while derived classes are destroyed)
+  CacheRegistry::registerCache(this);
 }
 
 Document::~Document()
@@ -505,44 +1036,247 @@ Document::~Document()
 #ifdef DEBUG
 //  qDebug() << "Document::~Document()";
 #endif
+  CacheRegistry::unregisterCache(this);
   clearPages();
 }
 
-int Document::numPages() { QReadLocker docLocker(_docLock.data()); return _numPages; }
-PDFPageProcessingThread &Document::processingThread() { QReadLocker docLocker(_docLock.data()); return _processingThread; }
-PDFPageCache &Document::pageCache() { QReadLocker docLocker(_docLock.data()); return _pageCache; }
+RenderStatistics::Snapshot Document::renderStatistics()
+{
+  RenderStatistics::Snapshot retVal = _processingThread.statistics().snapshot();
+  retVal.backend = backendName();
+  retVal.bytesCached = _pageCache->totalSize();
+  retVal.residentPages = residentPages();
+  return retVal;
+}
 
-QList<SearchResult> Document::search(const QString & searchText, const SearchFlags & flags, const int startPage)
+PDFToC Document::cachedToC()
 {
+  QSharedPointer<const FileSource> source(currentInfoCacheSource());
+  if (source) {
+    QMutexLocker l(&_infoCacheMutex);
+    if (_cachedToCSource.toStrongRef() == source)
+      return _cachedToC;
+  }
+  PDFToC retVal = toc();
+  if (source) {
+    QMutexLocker l(&_infoCacheMutex);
+    _cachedToCSource = source;
+    _cachedToC = retVal;
+  }
+  return retVal;
+}
+
+QList<PDFFontInfo> Document::cachedFonts()
+{
+  QSharedPointer<const FileSource> source(currentInfoCacheSource());
+  if (source) {
+    QMutexLocker l(&_infoCacheMutex);
+    if (_cachedFontsSource.toStrongRef() == source)
+      return _cachedFonts;
+  }
+  QList<PDFFontInfo> retVal = fonts();
+  if (source) {
+    QMutexLocker l(&_infoCacheMutex);
+    _cachedFontsSource = source;
+    _cachedFonts = retVal;
+  }
+  return retVal;
+}
+
+QMutex Document::_linkCacheMutex;
+QCache< QByteArray, QList< QSharedPointer<Annotation::Link> > > Document::_linkCache(LINK_CACHE_SIZE);
+
+//static
+bool Document::cachedLinks(const QByteArray & key, QList< QSharedPointer<Annotation::Link> > & links)
+{
+  if (key.isEmpty())
+    return false;
+  QMutexLocker l(&_linkCacheMutex);
+  QList< QSharedPointer<Annotation::Link> > * cached = _linkCache.object(key);
+  if (!cached)
+    return false;
+  // The cached links may be shared by several pages (of different documents),
+  // so each page gets its own copies
+  links.clear();
+  foreach (QSharedPointer<Annotation::Link> link, *cached)
+    links << QSharedPointer<Annotation::Link>(new Annotation::Link(*link));
+  return true;
+}
+
+//static
+void Document::cacheLinks(const QByteArray & key, const QList< QSharedPointer<Annotation::Link> > & links)
+{
+  if (key.isEmpty())
+    return;
+  QList< QSharedPointer<Annotation::Link> > * copies = new QList< QSharedPointer<Annotation::Link> >();
+  foreach (QSharedPointer<Annotation::Link> link, links)
+    *copies << QSharedPointer<Annotation::Link>(new Annotation::Link(*link));
+  QMutexLocker l(&_linkCacheMutex);
+  _linkCache.insert(key, copies, links.size() + 1);
+}
+
+QSharedPointer<const FileSource> Document::currentInfoCacheSource()
+{
+  QSharedPointer<const FileSource> source;
+  {
+    QReadLocker docLocker(_docLock.data());
+    source = _fileSource;
+  }
+  // NB: If the document is reloaded while the results are being extracted,
+  // they may end up being associated with the wrong generation. This is
+  // harmless, though, as they don't match the current generation on the next
+  // call and are extracted again.
+  // Don't cache results for locked documents; they change on unlocking
+  if (!source || isLocked())
+    return QSharedPointer<const FileSource>();
+  return source;
+}
+
+QWeakPointer<Page> Document::page(int at)
+{
+  // Fast path: the page object already exists
+  std::shared_ptr<PageTable> table(pageTable());
+  if (at < 0 || at >= table->size())
+    return QWeakPointer<Page>();
+  QSharedPointer<Page> retVal(table->at(at));
+  if (retVal) {
+    retVal->_lastAccess.storeRelease(_accessClock.fetchAndAddOrdered(1));
+    return retVal.toWeakRef();
+  }
+
+  // Slow path: create the page object. The doc-read-lock ensures the document
+  // is not reloaded while we are creating the page, and the mutex ensures we
+  // don't create the same page twice. Readers are not affected by either.
   QReadLocker docLocker(_docLock.data());
+  QMutexLocker creationLocker(&_pageCreationMutex);
+
+  // Recheck everything that could have changed before we got the locks (e.g.,
+  // the document could have been reloaded in the meantime)
+  table = pageTable();
+  if (at >= table->size())
+    return QWeakPointer<Page>();
+  retVal = table->at(at);
+  if (!retVal) {
+    Page * newPageObj = newPage(at);
+    if (!newPageObj)
+      return QWeakPointer<Page>();
+    retVal = table->insert(at, newPageObj);
+    evictPages(*table, at, maxResidentPages());
+  }
+  retVal->_lastAccess.storeRelease(_accessClock.fetchAndAddOrdered(1));
+  return retVal.toWeakRef();
+}
+
+void Document::evictPages(PageTable & table, const int keep, const int maxPages)
+{
+  if (maxPages <= 0 || table.numResident() <= maxPages)
+    return;
+
+  // Forget about evicted pages that have been destroyed in the meantime
+  for (int i = _evictedPages.size() - 1; i >= 0; --i) {
+    if (_evictedPages[i].isNull())
+      _evictedPages.removeAt(i);
+  }
+
+  // NB: The list of resident pages is at most a few entries longer than
+  // maxPages, so a linear search for the oldest ones is cheap enough.
+  // NB: The clock wraps around after 2^32 accesses, which at worst leads to a
+  // single suboptimal choice.
+  while (table.numResident() > maxPages) {
+    int lruSlot = -1, lruAccess = 0;
+    foreach (int i, table.residentSlots()) {
+      if (i == keep)
+        continue;
+      QSharedPointer<Page> page(table.at(i));
+      const int access = (page ? page->_lastAccess.loadAcquire() : 0);
+      if (lruSlot < 0 || access < lruAccess) {
+        lruSlot = i;
+        lruAccess = access;
+      }
+    }
+    if (lruSlot < 0)
+      break;
+    QSharedPointer<Page> evicted(table.remove(lruSlot));
+    // Don't detach the page: it may still be in use (e.g., by a pending render
+    // request) and is still valid until the document changes
+    if (evicted)
+      _evictedPages << evicted.toWeakRef();
+  }
+}
+
+QString Document::cacheName() const
+{
+  return QString::fromLatin1("PDF: ") + fileName();
+}
+
+qint64 Document::shrinkCache(const qint64 bytes)
+{
+  const qint64 released = _pageCache->shrink(bytes);
+  if (released < bytes) {
+    QReadLocker docLocker(_docLock.data());
+    QMutexLocker creationLocker(&_pageCreationMutex);
+    std::shared_ptr<PageTable> table(pageTable());
+    evictPages(*table, -1, table->numResident() / 2);
+  }
+  return released;
+}
+
+QSizeF Document::pageSizeF(int at)
+{
+  QSharedPointer<Page> p(page(at).toStrongRef());
+  return (p ? p->pageSizeF() : QSizeF());
+}
+
+QWeakPointer<Page> Document::page(int at) const
+{
+  std::shared_ptr<PageTable> table(pageTable());
+  if (at < 0 || at >= table->size())
+    return QWeakPointer<Page>();
+  return table->at(at).toWeakRef();
+}
+
+QList<SearchResult> Document::search(const QString & searchText, const SearchFlags & flags, const int startPage, const AbortToken & abort /* = AbortToken() */)
+{
+  QReadLocker docLocker(_docLock.data());
+  std::shared_ptr<PageTable> table(pageTable());
   QList<SearchResult> results;
   int i, start, end, step;
 
   start = startPage;
-  end = (flags.testFlag(Search_Backwards) ? -1 : _numPages);
+  end = (flags.testFlag(Search_Backwards) ? -1 : table->size());
   step = (flags.testFlag(Search_Backwards) ? -1 : +1);
 
-  for (i = start; i != end; i += step) {
-    QSharedPointer<Page> page(_pages[i]);
+  for (i = start; i != end && !abort.isAborted(); i += step) {
+    // NB: Use page() as the page object may have been evicted
+    QSharedPointer<Page> page(this->page(i).toStrongRef());
     if (!page)
       continue;
-    results << page->search(searchText, flags);
+    results << page->search(searchText, flags, abort);
   }
 
   if (flags.testFlag(Search_WrapAround)) {
-    start = ((flags & Search_Backwards) ? _numPages - 1 : 0);
+    start = ((flags & Search_Backwards) ? table->size() - 1 : 0);
     end = startPage;
-    for (i = start; i != end; i += step) {
-      QSharedPointer<Page> page(_pages[i]);
+    for (i = start; i != end && !abort.isAborted(); i += step) {
+      QSharedPointer<Page> page(this->page(i).toStrongRef());
       if (!page)
         continue;
-      results << page->search(searchText, flags);
+      results << page->search(searchText, flags, abort);
     }
   }
 
   return results;
 }
 
+bool Document::isUpToDate() const
+{
+  QReadLocker docLocker(_docLock.data());
+  if (!_fileSource)
+    return false;
+  QFileInfo fi(_fileName);
+  return (fi.exists() && fi.size() == _fileSource->size() && fi.lastModified() == _fileSource->lastModified());
+}
+
 void Document::clearPages()
 {
   // Clear the processing thread to ensure no task still needs the pages we are
@@ -554,14 +1288,32 @@ void Document::clearPages()
   _processingThread.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
-  foreach(QSharedPointer<Page> page, _pages) {
+  resetPageTable();
+}
+
+void Document::resetPageTable()
+{
+  QWriteLocker docLocker(_docLock.data());
+  std::shared_ptr<PageTable> table(pageTable());
+  for (int i = 0; i < table->size(); ++i) {
+    QSharedPointer<Page> page(table->at(i));
     if (page.isNull())
       continue;
     page->detachFromParent();
   }
-  // Note: clear() releases all QSharedPointer to pages, thereby destroying them
-  // (if they are not used elsewhere)
-  _pages.clear();
+  {
+    QMutexLocker creationLocker(&_pageCreationMutex);
+    foreach (QWeakPointer<Page> weakPage, _evictedPages) {
+      QSharedPointer<Page> page(weakPage.toStrongRef());
+      if (page)
+        page->detachFromParent();
+    }
+    _evictedPages.clear();
+  }
+  // Note: Replacing the table releases all QSharedPointer to pages (once the
+  // last reader is done with the old table), thereby destroying them (if they
+  // are not used elsewhere)
+  std::atomic_store(&_pageTable, std::shared_ptr<PageTable>(new PageTable(_numPages < 0 ? 0 : _numPages)));
 }
 
 void Document::clearMetaData()
@@ -581,6 +1333,87 @@ void Document::clearMetaData()
   _meta_other.clear();
 }
 
+void Document::publishMetaData()
+{
+  QWriteLocker docLocker(_docLock.data());
+
+  MetaData * md = new MetaData();
+  md->numPages = _numPages;
+  md->fileName = _fileName;
+  md->permissions = _permissions;
+  md->title = _meta_title;
+  md->author = _meta_author;
+  md->subject = _meta_subject;
+  md->keywords = _meta_keywords;
+  md->pageSize = _meta_pageSize;
+  md->creator = _meta_creator;
+  md->producer = _meta_producer;
+  md->creationDate = _meta_creationDate;
+  md->modDate = _meta_modDate;
+  md->fileSize = _meta_fileSize;
+  md->trapped = _meta_trapped;
+  md->other = _meta_other;
+
+  // Publish the new page table first so nobody sees the new number of pages
+  // together with the old (too small) page table
+  // NB: Don't use clearPages() here as that must not be called while holding
+  // the doc-write-lock (see PDFPageProcessingThread::clearWorkStack()).
+  if (pageTable()->size() != (_numPages < 0 ? 0 : _numPages))
+    resetPageTable();
+  std::atomic_store(&_metaData, std::shared_ptr<const MetaData>(md));
+}
+
+// Page Table
+// ----------
+// NB: Each slot holds a (std::) shared pointer to the QSharedPointer of the
+// page, so a reader that loaded a slot can still copy the QSharedPointer after
+// the slot was emptied concurrently.
+Document::PageTable::PageTable(const int size) :
+  _size(size),
+  _slots(new std::shared_ptr< QSharedPointer<Page> >[size > 0 ? size : 0]),
+  _numResident(0)
+{
+}
+
+Document::PageTable::~PageTable()
+{
+  delete[] _slots;
+}
+
+QSharedPointer<Page> Document::PageTable::at(const int i) const
+{
+  if (i < 0 || i >= _size)
+    return QSharedPointer<Page>();
+  std::shared_ptr< QSharedPointer<Page> > slot(std::atomic_load(&_slots[i]));
+  return (slot ? *slot : QSharedPointer<Page>());
+}
+
+QSharedPointer<Page> Document::PageTable::insert(const int i, Page * page)
+{
+  Q_ASSERT(i >= 0 && i < _size);
+  std::shared_ptr< QSharedPointer<Page> > slot(std::atomic_load(&_slots[i]));
+  if (slot) {
+    delete page;
+    return *slot;
+  }
+  slot = std::make_shared< QSharedPointer<Page> >(page);
+  std::atomic_store(&_slots[i], slot);
+  _residentSlots << i;
+  _numResident.fetchAndAddOrdered(1);
+  return *slot;
+}
+
+QSharedPointer<Page> Document::PageTable::remove(const int i)
+{
+  Q_ASSERT(i >= 0 && i < _size);
+  std::shared_ptr< QSharedPointer<Page> > slot(std::atomic_exchange(&_slots[i], std::shared_ptr< QSharedPointer<Page> >()));
+  if (!slot)
+    return QSharedPointer<Page>();
+  _residentSlots.removeOne(i);
+  _numResident.fetchAndAddOrdered(-1);
+  return *slot;
+}
+
 // Page Class
 // ----------
 //
@@ -592,12 +1425,19 @@ void Document::clearMetaData()
 // Note that the Page may exist in a detached state, i.e., _parent == nullptr. This
 // is typically the case when the document discarded the page object but some
 // other object (typically in another thread) still holds a QSharedPointer to it.
+// Tile lookups (which happen for every tile on every repaint) take neither
+// lock. They go to the page cache (which has a lock of its own) through a
+// shared pointer, so they don't depend on the lifetime of the parent.
 Page::Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock):
   _parent(parent),
   _n(at),
+  _lastAccess(0),
   _transition(nullptr),
   _pageLock(new QReadWriteLock(QReadWriteLock::Recursive)),
-  _docLock(docLock)
+  _docLock(docLock),
+  _pageCache(parent ? parent->_pageCache : QSharedPointer<PDFPageCache>()),
+  _statistics(parent ? parent->_processingThread.sharedStatistics() : QSharedPointer<RenderStatistics>()),
+  _attached(parent ? 1 : 0)
 {
   Q_ASSERT(_pageLock);
 
@@ -632,22 +1472,67 @@ Page::~Page()
 #ifdef DEBUG
 //  qDebug() << "Page::~Page(" << _n << ")";
 #endif
+  delete _pageLock;
 }
 
-int Page::pageNum() { QReadLocker pageLocker(_pageLock); return _n; }
-
 void Page::detachFromParent()
 {
   QWriteLocker pageLocker(_pageLock);
   _parent = nullptr;
+  _attached.storeRelease(0);
 }
 
-QRectF Page::getContentBoundingBox() const
+// Finds the bounding box of all pixels in `img` that differ from `bg`. Returns
+// a null rect if there are none.
+// NOTE: The inner loops are written to let the compiler vectorize them: each
+// row is first checked as a whole by OR-ing the differences of all pixels
+// (no early exit, no branches), which is all that needs to be done for the
+// (usually many) empty rows. Only for rows with content, the left and right
+// edges are searched, and only in the part outside the box found so far.
+static QRect contentPixelBox(const QImage & img, const QRgb bg)
+{
+  const int w = img.width();
+  int x0 = w, x1 = -1, y0 = -1, y1 = -1;
+
+  for (int y = 0; y < img.height(); ++y) {
+    const QRgb * row = reinterpret_cast<const QRgb*>(img.constScanLine(y));
+    QRgb diff = 0;
+    for (int x = 0; x < w; ++x)
+      diff |= row[x] ^ bg;
+    if (!diff)
+      continue;
+
+    if (y0 < 0)
+      y0 = y;
+    y1 = y;
+    int x = 0;
+    while (x < x0 && row[x] == bg)
+      ++x;
+    x0 = qMin(x0, x);
+    x = w - 1;
+    while (x > x1 && row[x] == bg)
+      --x;
+    x1 = qMax(x1, x);
+  }
+
+  if (y0 < 0)
+    return QRect();
+  return QRect(QPoint(x0, y0), QPoint(x1, y1));
+}
+
+QRectF Page::computeContentBoundingBox(const bool highPrecision) const
 {
   QSizeF pageSize(pageSizeF());
+  if (pageSize.isEmpty())
+    return QRectF();
+
   // render the page into a 100x100 px image (this should be fast and will allow
-  // estimating the content bounding box to about 1% of the page size)
-  QImage img = renderToImage(100. * 72 / pageSize.width(), 100. * 72 / pageSize.height());
+  // estimating the content bounding box to about 1% of the page size); in
+  // high-precision mode, use 1000x1000 px (about 0.1%)
+  const int size = (highPrecision ? 1000 : 100);
+  QImage img = renderToImage(size * 72. / pageSize.width(), size * 72. / pageSize.height());
+  if (img.isNull())
+    return QRectF();
 
   // Make sure the image is in a format we can handle here
   switch (img.format()) {
@@ -666,48 +1551,111 @@ QRectF Page::getContentBoundingBox() const
   // Make sure the same color is used in the other three corners (otherwise we
   // can't be sure it's really the global background color; in that case we
   // assume that everything is content)
-  if (bg != img.pixel(img.width() - 1, 0) || bg != img.pixel(0, img.height() - 1 || bg != img.pixel(img.width() - 1, img.height() - 1)))
+  if (bg != img.pixel(img.width() - 1, 0) || bg != img.pixel(0, img.height() - 1) || bg != img.pixel(img.width() - 1, img.height() - 1))
     return QRectF(QPointF(0, 0), pageSize);
 
   // Find the bounding box (min/max values for x and y) of the content
-  int x0 = img.width(), x1 = 0, y0 = img.height(), y1 = 0;
-  for (int y = 0; y < img.height(); ++y) {
-    const QRgb * row = reinterpret_cast<const QRgb*>(img.constScanLine(y));
-    for (int x = 0; x < img.width(); ++x) {
-      if (row[x] != bg) {
-        if (x0 > x) x0 = x;
-        if (x1 < x) x1 = x;
-        if (y0 > y) y0 = y;
-        if (y1 < y) y1 = y;
-      }
-    }
+  QRect box = contentPixelBox(img, bg);
+  // Empty pages are treated as if everything was content
+  if (box.isNull())
+    return QRectF(QPointF(0, 0), pageSize);
+
+  const qreal sx = pageSize.width() / img.width(), sy = pageSize.height() / img.height();
+  return QRectF(box.x() * sx, box.y() * sy, box.width() * sx, box.height() * sy);
+}
+
+QRectF Page::getContentBoundingBox(const bool highPrecision /* = false */) const
+{
+  {
+    QReadLocker pageLocker(_pageLock);
+    if (!_contentBoundingBox[highPrecision ? 1 : 0].isNull())
+      return _contentBoundingBox[highPrecision ? 1 : 0];
   }
 
-  return QRectF(x0 * pageSize.width() / 100., y0 * pageSize.height() / 100., (x1 - x0 + 1) * pageSize.width() / 100., (y1 - y0 + 1) * pageSize.height() / 100.);
+  // NB: Don't hold the page-lock while rendering (in case we need to wait for
+  // other operations on this page). At worst, the bounding box is computed
+  // twice.
+  QRectF bbox = computeContentBoundingBox(highPrecision);
+  if (bbox.isNull())
+    return bbox;
+
+  QWriteLocker pageLocker(_pageLock);
+  _contentBoundingBox[highPrecision ? 1 : 0] = bbox;
+  return bbox;
 }
 
-QSharedPointer<QImage> Page::getCachedImage(double xres, double yres, QRect render_box /* = QRect() */, PDFPageCache::TileStatus * status /* = nullptr */)
+bool Page::hasContentBoundingBox(const bool highPrecision /* = false */) const
+{
+  QReadLocker pageLocker(_pageLock);
+  return !_contentBoundingBox[highPrecision ? 1 : 0].isNull();
+}
+
+void Page::asyncContentBoundingBox(QObject *listener /* = nullptr */, const bool highPrecision /* = false */, const PDFPageProcessingThread::Priority priority /* = PDFPageProcessingThread::NormalPriority */)
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
-  if (!_parent) {
+  if (!_parent)
+    return;
+  // Precomputing the same box twice is pointless (e.g., if the user fits the
+  // content width repeatedly); the flag is reset when the request is deleted
+  if (!listener && (hasContentBoundingBox(highPrecision) || !_contentBoundingBoxQueued[highPrecision ? 1 : 0].testAndSetOrdered(0, 1)))
+    return;
+  _parent->processingThread().addPageProcessingRequest(new PageProcessingContentBoundingBoxRequest(this, listener, highPrecision), priority);
+}
+
+QSharedPointer<QImage> Page::getCachedImage(double xres, double yres, QRect render_box /* = QRect() */, PDFPageCache::TileStatus * status /* = nullptr */, const PDFPageColorFilter & colorFilter /* = PDFPageColorFilter() */)
+{
+  // NB: The page cache has its own lock, so this doesn't need the doc-lock or
+  // page-lock. If the page is detached concurrently, the result is the same as
+  // if this had been called just before.
+  if (!_pageCache || !_attached.loadAcquire()) {
     if (status)
       *status = PDFPageCache::UNKNOWN;
     return QSharedPointer<QImage>();
   }
-  PDFPageTile tile(xres, yres, render_box, _n);
+  PDFPageTile tile(xres, yres, render_box, _n, colorFilter);
   if (status)
-    *status = _parent->pageCache().getStatus(tile);
-  return _parent->pageCache().getImage(tile);
+    *status = _pageCache->getStatus(tile);
+  return _pageCache->getImage(tile);
+}
+
+void Page::asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box, bool cache, const PDFPageColorFilter & colorFilter /* = PDFPageColorFilter() */)
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent)
+    return;
+  _parent->processingThread().addPageProcessingRequest(new PageProcessingRenderPageRequest(this, listener, xres, yres, render_box, cache, colorFilter));
 }
 
-void Page::asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box, bool cache)
+void Page::asyncRenderThumbnail(QObject *listener, double xres, double yres, const PDFPageColorFilter & colorFilter /* = PDFPageColorFilter() */)
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
   if (!_parent)
     return;
-  _parent->processingThread().addPageProcessingRequest(new PageProcessingRenderPageRequest(this, listener, xres, yres, render_box, cache));
+  _parent->processingThread().addPageProcessingRequest(new PageProcessingRenderPageRequest(this, listener, xres, yres, QRect(), false, colorFilter), PDFPageProcessingThread::LowPriority);
+}
+
+QImage Page::renderToFilteredImage(double xres, double yres, QRect render_box, bool cache, const PDFPageColorFilter & colorFilter, const AbortToken & abort /* = AbortToken() */) const
+{
+  if (colorFilter.isNull())
+    return renderToImage(xres, yres, render_box, cache, abort);
+
+  // NB: The unfiltered image is not cached; it would only take up space
+  QImage renderedPage = renderToImage(xres, yres, render_box, false, abort);
+  if (renderedPage.isNull() || abort.isAborted())
+    return QImage();
+  colorFilter.apply(renderedPage);
+
+  // NB: Lock-free (see getCachedImage())
+  if (cache && _pageCache && _attached.loadAcquire()) {
+    PDFPageTile key(xres, yres, render_box, _n, colorFilter);
+    QImage * img = new QImage(renderedPage);
+    if (img != _pageCache->setImage(key, img, PDFPageCache::CURRENT))
+      delete img;
+  }
+  return renderedPage;
 }
 
 bool higherResolutionThan(const PDFPageTile & t1, const PDFPageTile & t2)
@@ -716,11 +1664,77 @@ bool higherResolutionThan(const PDFPageTile & t1, const PDFPageTile & t2)
   return t1.xres > t2.xres;
 }
 
-QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres, const double yres, QRect render_box /* = QRect() */)
+QImage * Page::constructPlaceholderTile(const double xres, const double yres, const QRect & render_box, const PDFPageColorFilter & colorFilter) const
+{
+  QImage * tmpImg = new QImage(render_box.width(), render_box.height(), QImage::Format_ARGB32);
+  QPainter p(tmpImg);
+  p.fillRect(tmpImg->rect(), *pageDummyBrush);
+
+  // Look through the cache to find tiles we can reuse (by scaling) for our
+  // dummy tile
+  // TODO: Benchmark this. If it is actualy too slow (i.e., just keeping the
+  // rendered image from popping up due to the lock held by getTileImage())
+  // disable it
+  if (_parent) {
+    QList<PDFPageTile> tiles = _parent->pageCache().tiles();
+    for (QList<PDFPageTile>::iterator it = tiles.begin(); it != tiles.end(); ) {
+      // Only reuse tiles with the same colors
+      if (it->page_num != pageNum() || it->color_filter != colorFilter) {
+        it = tiles.erase(it);
+        continue;
+      }
+      // See if it->render_box intersects with render_box (after proper scaling)
+      QRect scaledRect = QTransform::fromScale(xres / it->xres, yres / it->yres).mapRect(it->render_box);
+      if (!scaledRect.intersects(render_box)) {
+        it = tiles.erase(it);
+        continue;
+      }
+      ++it;
+    }
+    // Sort the remaining tiles by size, high-res first
+    qSort(tiles.begin(), tiles.end(), higherResolutionThan);
+    // Finally, crop, scale and paint each image until the whole area is
+    // filled or no images are left in the list
+    QPainterPath clipPath;
+    clipPath.addRect(0, 0, render_box.width(), render_box.height());
+    foreach (PDFPageTile tile, tiles) {
+      QSharedPointer<QImage> tileImg = _parent->pageCache().getImage(tile);
+      if (!tileImg)
+        continue;
+
+      // cropRect is the part of `tile` that overlaps the tile-to-paint (after
+      // proper scaling).
+      // paintRect is the part `tile` fills of the area we paint to (after
+      // proper scaling).
+      QRect cropRect = QTransform::fromScale(tile.xres / xres, tile.yres / yres).mapRect(render_box).intersected(tile.render_box).translated(-tile.render_box.left(), -tile.render_box.top());
+      QRect paintRect = QTransform::fromScale(xres / tile.xres, yres / tile.yres).mapRect(tile.render_box).intersected(render_box).translated(-render_box.left(), -render_box.top());
+
+      // Get the actual image and paint it onto the dummy tile
+      QImage tmp(tileImg->copy(cropRect).scaled(paintRect.size()));
+      p.setClipPath(clipPath);
+      p.drawImage(paintRect.topLeft(), tmp);
+
+      // Confine the clipping path to the part we have not painted to yet.
+      QPainterPath pp;
+      pp.addRect(paintRect);
+      clipPath = clipPath.subtracted(pp);
+      if (clipPath.isEmpty())
+        break;
+    }
+  }
+  p.end();
+  return tmpImg;
+}
+
+QImage * Page::placeholderTile(const double xres, const double yres, const QRect & render_box, const PDFPageColorFilter & colorFilter /* = PDFPageColorFilter() */) const
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
+  return constructPlaceholderTile(xres, yres, render_box, colorFilter);
+}
 
+QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres, const double yres, QRect render_box /* = QRect() */, const PDFPageColorFilter & colorFilter /* = PDFPageColorFilter() */)
+{
   // If the render_box is empty, use the whole page
   if (render_box.isNull())
     render_box = QRectF(0, 0, pageSizeF().width() * xres / 72., pageSizeF().height() * yres / 72.).toAlignedRect();
@@ -729,9 +1743,21 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
   // 1) it is current
   // 2) it is a placeholder (in this case, it is currently rendering in the
   // background and we don't need to do anything)
+  // NB: This is the common case (e.g., for every repaint), so it doesn't lock
+  // (see getCachedImage())
   PDFPageCache::TileStatus status;
-  QSharedPointer<QImage> retVal = getCachedImage(xres, yres, render_box, &status);
-  if (retVal && (status == PDFPageCache::CURRENT || status == PDFPageCache::PLACEHOLDER))
+  QSharedPointer<QImage> retVal = getCachedImage(xres, yres, render_box, &status, colorFilter);
+  if (retVal && (status == PDFPageCache::CURRENT || status == PDFPageCache::PLACEHOLDER)) {
+    if (_statistics)
+      _statistics->increment(status == PDFPageCache::CURRENT ? RenderStatistics::CacheHits : RenderStatistics::PlaceholderHits);
+    return retVal;
+  }
+  if (_statistics)
+    _statistics->increment(RenderStatistics::CacheMisses);
+
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent)
     return retVal;
 
   if (listener) {
@@ -740,83 +1766,29 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
     // Note: Start the rendering in the background before constructing the image
     // to take advantage of multi-core CPUs. Since we hold the write lock here
     // there's nothing to worry about
-    asyncRenderToImage(listener, xres, yres, render_box, true);
+    asyncRenderToImage(listener, xres, yres, render_box, true, colorFilter);
 
     if (retVal && status == PDFPageCache::OUTDATED) {
       // If we have an outdated image, use that as a placeholder
-      _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _n), retVal.data(), PDFPageCache::PLACEHOLDER, false);
+      _pageCache->setImage(PDFPageTile(xres, yres, render_box, _n, colorFilter), retVal.data(), PDFPageCache::PLACEHOLDER, false);
     }
     else {
       // otherwise construct a dummy image
-      QImage * tmpImg = new QImage(render_box.width(), render_box.height(), QImage::Format_ARGB32);
-      QPainter p(tmpImg);
-      p.fillRect(tmpImg->rect(), *pageDummyBrush);
-
-      // Look through the cache to find tiles we can reuse (by scaling) for our
-      // dummy tile
-      // TODO: Benchmark this. If it is actualy too slow (i.e., just keeping the
-      // rendered image from popping up due to the write lock we hold) disable it
-      if (_parent) {
-        QList<PDFPageTile> tiles = _parent->pageCache().tiles();
-        for (QList<PDFPageTile>::iterator it = tiles.begin(); it != tiles.end(); ) {
-          if (it->page_num != pageNum()) {
-            it = tiles.erase(it);
-            continue;
-          }
-          // See if it->render_box intersects with render_box (after proper scaling)
-          QRect scaledRect = QTransform::fromScale(xres / it->xres, yres / it->yres).mapRect(it->render_box);
-          if (!scaledRect.intersects(render_box)) {
-            it = tiles.erase(it);
-            continue;
-          }
-          ++it;
-        }
-        // Sort the remaining tiles by size, high-res first
-        qSort(tiles.begin(), tiles.end(), higherResolutionThan);
-        // Finally, crop, scale and paint each image until the whole area is
-        // filled or no images are left in the list
-        QPainterPath clipPath;
-        clipPath.addRect(0, 0, render_box.width(), render_box.height());
-        foreach (PDFPageTile tile, tiles) {
-          QSharedPointer<QImage> tileImg = _parent->pageCache().getImage(tile);
-          if (!tileImg)
-            continue;
-
-          // cropRect is the part of `tile` that overlaps the tile-to-paint (after
-          // proper scaling).
-          // paintRect is the part `tile` fills of the area we paint to (after
-          // proper scaling).
-          QRect cropRect = QTransform::fromScale(tile.xres / xres, tile.yres / yres).mapRect(render_box).intersected(tile.render_box).translated(-tile.render_box.left(), -tile.render_box.top());
-          QRect paintRect = QTransform::fromScale(xres / tile.xres, yres / tile.yres).mapRect(tile.render_box).intersected(render_box).translated(-render_box.left(), -render_box.top());
-
-          // Get the actual image and paint it onto the dummy tile
-          QImage tmp(tileImg->copy(cropRect).scaled(paintRect.size()));
-          p.setClipPath(clipPath);
-          p.drawImage(paintRect.topLeft(), tmp);
-
-          // Confine the clipping path to the part we have not painted to yet.
-          QPainterPath pp;
-          pp.addRect(paintRect);
-          clipPath = clipPath.subtracted(pp);
-          if (clipPath.isEmpty())
-            break;
-        }
-      }
-      // stop painting or else we couldn't (possibly) delete tmpImg below
-      p.end();
+      QImage * tmpImg = constructPlaceholderTile(xres, yres, render_box, colorFilter);
+      _statistics->increment(RenderStatistics::PlaceholdersCreated);
 
       // Add the dummy tile to the cache
       // Note: In the meantime the asynchronous rendering could have finished and
       // insert the final image in the cache---we must handle that case and delete
       // our temporary image
-      retVal = _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _n), tmpImg, PDFPageCache::PLACEHOLDER, false);
+      retVal = _pageCache->setImage(PDFPageTile(xres, yres, render_box, _n, colorFilter), tmpImg, PDFPageCache::PLACEHOLDER, false);
       if (retVal != tmpImg)
         delete tmpImg;
     }
     return retVal;
   }
-  renderToImage(xres, yres, render_box, true);
-  return getCachedImage(xres, yres, render_box);
+  renderToFilteredImage(xres, yres, render_box, true, colorFilter);
+  return getCachedImage(xres, yres, render_box, nullptr, colorFilter);
 }
 
 void Page::asyncLoadLinks(QObject *listener)
@@ -825,23 +1797,141 @@ void Page::asyncLoadLinks(QObject *listener)
   QReadLocker pageLocker(_pageLock);
   if (!_parent)
     return;
-  _parent->processingThread().addPageProcessingRequest(new PageProcessingLoadLinksRequest(this, listener));
+
+  bool validated = false;
+  QList< QSharedPointer<Annotation::Link> > links;
+  if (Document::cachedLinks(linkCacheKey(&validated), links)) {
+    // The links come from a page object of another document (e.g., a previous
+    // version of this file), so attach them to this one
+    QWeakPointer<Page> self(_parent->page(_n));
+    foreach (QSharedPointer<Annotation::Link> link, links)
+      link->setPage(self);
+    QCoreApplication::postEvent(listener, new PDFLinksLoadedEvent(links));
+    if (validated) {
+      if (_statistics)
+        _statistics->increment(RenderStatistics::LinkCacheHits);
+      return;
+    }
+  }
+  if (_statistics)
+    _statistics->increment(RenderStatistics::LinksRequested);
+  // NB: Links are only needed for interaction, so don't delay the rendering
+  _parent->processingThread().addPageProcessingRequest(new PageProcessingLoadLinksRequest(this, listener), PDFPageProcessingThread::LowPriority);
+}
+
+QByteArray Page::fingerprint() const
+{
+  return QByteArray();
+}
+
+QByteArray Page::linkCacheKey(bool * validated /* = nullptr */) const
+{
+  QByteArray fp(fingerprint());
+  if (validated)
+    *validated = !fp.isEmpty();
+  if (!fp.isEmpty())
+    return QByteArray("F") + fp;
+
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent)
+    return QByteArray();
+  QFileInfo fi(_parent->_fileName);
+  QString path(fi.canonicalFilePath());
+  if (path.isEmpty())
+    path = fi.absoluteFilePath();
+  return QByteArray("P") + path.toUtf8() + '#' + QByteArray::number(_n);
 }
 
 //static
 QList<SearchResult> Page::executeSearch(SearchRequest request)
 {
+  // Don't even start if the search this request belongs to was aborted (e.g.,
+  // because a new search was started in the meantime)
+  if (request.abortToken.isAborted())
+    return QList<SearchResult>();
   QSharedPointer<Document> doc(request.doc.toStrongRef());
   if (!doc)
     return QList<SearchResult>();
   QSharedPointer<Page> page = doc->page(request.pageNum).toStrongRef();
   if (!page)
     return QList<SearchResult>();
-  return page->search(request.searchString, request.flags);
+  QList<SearchResult> results(page->search(request.searchString, request.flags, request.abortToken));
+  if (!request.flags.testFlag(Search_WithContext) || results.isEmpty() || request.abortToken.isAborted())
+    return results;
+
+  // Extract the lines containing matches with one call (for most backends,
+  // each call has to extract the text of the whole page). The lines are
+  // selected by thin strips through the middle of the matches so that
+  // neighboring lines are not picked up.
+  const qreal pageWidth = page->pageSizeF().width();
+  QList<QPolygonF> lines;
+  foreach (const SearchResult & result, results)
+    lines << QPolygonF(QRectF(0, result.bbox.center().y() - result.bbox.height() / 4, pageWidth, result.bbox.height() / 2));
+  QMap<int, QRectF> charBoxes;
+  const QString text(page->selectedText(lines, nullptr, &charBoxes, false, request.abortToken));
+  if (text.isEmpty() || charBoxes.size() != text.length())
+    return results;
+
+  for (int i = 0; i < results.size(); ++i) {
+    SearchResult & result = results[i];
+    int first = -1, last = -1;
+    for (int j = 0; j < text.length(); ++j) {
+      if (!result.bbox.contains(charBoxes[j].center()))
+        continue;
+      if (first < 0)
+        first = j;
+      last = j;
+    }
+    if (first < 0)
+      continue;
+    // Stay on the line of the match (selectedText() puts line breaks between
+    // lines)
+    const int start = qMax(text.lastIndexOf(QChar::fromLatin1('\n'), first) + 1, first - SEARCH_CONTEXT_LENGTH);
+    int end = text.indexOf(QChar::fromLatin1('\n'), last);
+    if (end < 0)
+      end = text.length();
+    end = qMin(end, last + 1 + SEARCH_CONTEXT_LENGTH);
+    result.context = text.mid(start, end - start).simplified();
+  }
+  return results;
 }
 
 } // namespace Backend
 
+// Backend Interface
+// =================
+QMutex BackendInterface::_documentRegistryMutex;
+QHash< QString, QWeakPointer<Backend::Document> > BackendInterface::_documentRegistry;
+
+QSharedPointer<Backend::Document> BackendInterface::sharedDocument(const QString & fileName)
+{
+  QFileInfo fi(fileName);
+  if (!fi.exists())
+    return newDocument(fileName);
+  const QString key = name() + QChar::fromLatin1(':') + fi.canonicalFilePath();
+
+  QMutexLocker l(&_documentRegistryMutex);
+  QSharedPointer<Backend::Document> retVal(_documentRegistry.value(key).toStrongRef());
+  // NB: If the file changed, the views using the registered document will
+  // reload it eventually, but that is no reason to show stale data here
+  if (retVal && retVal->isUpToDate())
+    return retVal;
+
+  retVal = newDocument(fileName);
+  if (!retVal)
+    return retVal;
+
+  // Drop registry entries of documents no longer in use
+  QMutableHashIterator< QString, QWeakPointer<Backend::Document> > it(_documentRegistry);
+  while (it.hasNext()) {
+    if (it.next().value().isNull())
+      it.remove();
+  }
+  _documentRegistry[key] = retVal;
+  return retVal;
+}
+
 } // namespace QtPDF
 
 // vim: set sw=2 ts=2 et
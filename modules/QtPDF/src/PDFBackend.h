@@ -16,6 +16,7 @@
 
 #include <PDFAnnotations.h>
 #include <PDFTransitions.h>
+#include <MemoryPressure.h>
 
 #include <QImage>
 #include <QFileInfo>
@@ -30,7 +31,16 @@
 #include <QWaitCondition>
 #include <QEvent>
 #include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
 #include <QWeakPointer>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QVariantMap>
+
+#include <memory>
 
 namespace QtPDF {
 
@@ -45,6 +55,32 @@ class Document;
 // TODO: Find a better place to put this
 QDateTime fromPDFDate(QString pdfDate);
 
+// Cooperative cancellation of (possibly) lengthy backend operations. All copies
+// of a token share the same state, so a token handed to a worker thread can be
+// aborted from the GUI thread. Backends poll isAborted() at convenient points
+// (or pass it on to the underlying library, e.g., as a Poppler abort callback)
+// and return as soon as possible with an empty or partial result.
+// A default-constructed token can never be aborted; use create() to obtain one
+// that can.
+// This class is thread-safe.
+class AbortToken
+{
+public:
+  AbortToken() { }
+  static AbortToken create() {
+    AbortToken retVal;
+    retVal._flag = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    return retVal;
+  }
+
+  void abort() const { if (_flag) _flag->storeRelease(1); }
+  bool isAborted() const { return (_flag && _flag->loadAcquire() != 0); }
+  bool canAbort() const { return !_flag.isNull(); }
+
+private:
+  QSharedPointer<QAtomicInt> _flag;
+};
+
 class PDFFontDescriptor
 {
 public:
@@ -146,6 +182,42 @@ protected:
   FontProgramType _fontProgramType;
 };
 
+// Colour filter that is applied to rendered page images (e.g., to display
+// pages in gray scale or with inverted colors for dark environments). Filtered
+// images are produced once (by the render worker) and cached separately from
+// unfiltered ones; see PDFPageTile.
+class PDFPageColorFilter
+{
+public:
+  enum FilterType { Filter_None, Filter_GrayScale, Filter_Invert, Filter_PaperColor };
+
+  // `paperColor` is only used for Filter_PaperColor; white parts of the page
+  // are shown in that color, black parts stay black
+  PDFPageColorFilter(const FilterType type = Filter_None, const QColor & paperColor = QColor(Qt::white)) :
+    _type(type),
+    _paperColor(type == Filter_PaperColor ? paperColor.rgb() : qRgb(255, 255, 255))
+  {}
+
+  FilterType type() const { return _type; }
+  QRgb paperColor() const { return _paperColor; }
+  bool isNull() const { return _type == Filter_None; }
+
+  // Applies the filter to `img` in-place. Images that don't have 32 bits per
+  // pixel are converted to QImage::Format_ARGB32 first.
+  void apply(QImage & img) const;
+
+  bool operator==(const PDFPageColorFilter & other) const {
+    return (_type == other._type && _paperColor == other._paperColor);
+  }
+  bool operator!=(const PDFPageColorFilter & other) const { return !operator==(other); }
+
+private:
+  FilterType _type;
+  QRgb _paperColor;
+};
+
+uint qHash(const PDFPageColorFilter & filter);
+
 class PDFPageTile;
 
 // Need a hash function in order to allow `PDFPageTile` to be used as a key
@@ -159,19 +231,21 @@ public:
   // We may want an application-wide cache instead of a document-specific cache
   // to keep memory usage down. This may require an additional piece of
   // information---the document that the page belongs to.
-  PDFPageTile(double xres, double yres, QRect render_box, int page_num):
+  PDFPageTile(double xres, double yres, QRect render_box, int page_num, const PDFPageColorFilter & color_filter = PDFPageColorFilter()):
     xres(xres), yres(yres),
     render_box(render_box),
-    page_num(page_num)
+    page_num(page_num),
+    color_filter(color_filter)
   {}
 
   double xres, yres;
   QRect render_box;
   int page_num;
+  PDFPageColorFilter color_filter;
 
   bool operator==(const PDFPageTile &other) const
   {
-    return (xres == other.xres && yres == other.yres && render_box == other.render_box && page_num == other.page_num);
+    return (xres == other.xres && yres == other.yres && render_box == other.render_box && page_num == other.page_num && color_filter == other.color_filter);
   }
 
   bool operator <(const PDFPageTile &other) const
@@ -213,8 +287,16 @@ public:
   void clear() { QWriteLocker l(&_lock); Super::clear(); _tileStatus.clear(); }
   // Mark all tiles outdated
   void markOutdated();
+  // Mark a single tile outdated (e.g., if rendering the tile was aborted and
+  // the placeholder must be replaced on the next repaint)
+  void markOutdated(const PDFPageTile & tile);
+  // Drops the least recently used images until `bytes` bytes have been
+  // released (or the cache is empty); returns the number of bytes released
+  qint64 shrink(const qint64 bytes);
 
   QList<PDFPageTile> tiles() const { return keys(); }
+  // Total size (in bytes) of all images currently in the cache
+  qint64 totalSize() const { QReadLocker l(&_lock); return totalCost(); }
 protected:
   mutable QReadWriteLock _lock;
   // Map to keep track of the current status of tiles; note that the status
@@ -230,24 +312,42 @@ class PageProcessingRequest : public QObject
   // Protect c'tor and execute() so we can't access them except in derived
   // classes and friends
 protected:
-  PageProcessingRequest(Page *page, QObject *listener) : page(page), listener(listener) { }
+  PageProcessingRequest(Page *page, QObject *listener);
   // Should perform whatever processing it is designed to do
-  // Returns true if finished successfully, false otherwise
+  // Returns true if finished successfully, false otherwise (e.g., if the
+  // request was aborted)
   virtual bool execute() = 0;
+  // Called if the request is dropped (or aborted) before it could finish, e.g.,
+  // to clean up after it
+  virtual void discard() { }
 
 public:
-  enum Type { PageRendering, LoadLinks };
+  enum Type { PageRendering, LoadLinks, ContentBoundingBox };
 
   virtual ~PageProcessingRequest() { }
   virtual Type type() const = 0;
 
+  // Request the (cooperative) cancellation of this request; if it is currently
+  // being executed, execute() returns as soon as the backend notices
+  void abort() { abortToken.abort(); }
+  bool isAborted() const { return abortToken.isAborted(); }
+
   Page *page;
   QObject *listener;
+  AbortToken abortToken;
+  // Started when the request is added to the work stack (only if render
+  // statistics are collected); see RenderStatistics
+  QElapsedTimer queueTimer;
   
   virtual bool operator==(const PageProcessingRequest & r) const;
 #ifdef DEBUG
   virtual operator QString() const = 0;
 #endif
+
+private:
+  // Keeps `page` alive while the request is pending, even if the document
+  // evicts it in the meantime (see Document::setMaxResidentPages())
+  QSharedPointer<Page> _pageRef;
 };
 
 class PageProcessingRenderPageRequest : public PageProcessingRequest
@@ -256,11 +356,12 @@ class PageProcessingRenderPageRequest : public PageProcessingRequest
   friend class PDFPageProcessingThread;
 
 public:
-  PageProcessingRenderPageRequest(Page *page, QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false) :
+  PageProcessingRenderPageRequest(Page *page, QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false, const PDFPageColorFilter & color_filter = PDFPageColorFilter()) :
     PageProcessingRequest(page, listener),
     xres(xres), yres(yres),
     render_box(render_box),
-    cache(cache)
+    cache(cache),
+    color_filter(color_filter)
   {}
   Type type() const { return PageRendering; }
 
@@ -271,10 +372,12 @@ public:
 
 protected:
   bool execute();
+  void discard();
 
   double xres, yres;
   QRect render_box;
   bool cache;
+  PDFPageColorFilter color_filter;
 };
 
 
@@ -282,11 +385,13 @@ class PDFPageRenderedEvent : public QEvent
 {
 
 public:
-  PDFPageRenderedEvent(double xres, double yres, QRect render_rect, QImage rendered_page):
+  PDFPageRenderedEvent(double xres, double yres, QRect render_rect, QImage rendered_page, int page_num = -1, const PDFPageColorFilter & color_filter = PDFPageColorFilter()):
     QEvent(PageRenderedEvent),
     xres(xres), yres(yres),
     render_rect(render_rect),
-    rendered_page(rendered_page)
+    rendered_page(rendered_page),
+    page_num(page_num),
+    color_filter(color_filter)
   {}
 
   static const QEvent::Type PageRenderedEvent;
@@ -294,6 +399,9 @@ public:
   const double xres, yres;
   const QRect render_rect;
   const QImage rendered_page;
+  const int page_num;
+  // The filter that has already been applied to rendered_page
+  const PDFPageColorFilter color_filter;
 
 };
 
@@ -316,6 +424,52 @@ protected:
 };
 
 
+// Computes (and caches) the content bounding box of a page in the background;
+// see Page::getContentBoundingBox(). If `listener` is given, a
+// PDFContentBoundingBoxEvent is posted to it when done.
+class PageProcessingContentBoundingBoxRequest : public PageProcessingRequest
+{
+  Q_OBJECT
+  friend class PDFPageProcessingThread;
+
+public:
+  PageProcessingContentBoundingBoxRequest(Page *page, QObject *listener, const bool highPrecision = false) :
+    PageProcessingRequest(page, listener),
+    highPrecision(highPrecision)
+  { }
+  virtual ~PageProcessingContentBoundingBoxRequest();
+  Type type() const { return ContentBoundingBox; }
+
+  virtual bool operator==(const PageProcessingRequest & r) const;
+#ifdef DEBUG
+  virtual operator QString() const;
+#endif
+
+protected:
+  bool execute();
+
+  bool highPrecision;
+};
+
+
+class PDFContentBoundingBoxEvent : public QEvent
+{
+
+public:
+  PDFContentBoundingBoxEvent(const int page_num, const QRectF bounding_box):
+    QEvent(ContentBoundingBoxEvent),
+    page_num(page_num),
+    bounding_box(bounding_box)
+  {}
+
+  static const QEvent::Type ContentBoundingBoxEvent;
+
+  const int page_num;
+  const QRectF bounding_box;
+
+};
+
+
 class PDFLinksLoadedEvent : public QEvent
 {
 
@@ -332,6 +486,105 @@ public:
 };
 
 
+// Collects counters and latency histograms of the render pipeline of a
+// document (see Document::renderStatistics()). Collection is disabled by
+// default; while it is, recording amounts to checking an atomic flag.
+// This class is thread-safe.
+class RenderStatistics
+{
+public:
+  // Latency histogram with power-of-two buckets: bucket 0 holds samples below
+  // 1 ms, bucket i (0 < i < BucketCount - 1) holds samples in
+  // [2^(i-1), 2^i) ms, and the last bucket holds everything above.
+  class Histogram
+  {
+  public:
+    enum { BucketCount = 16 };
+
+    Histogram();
+    void add(const qint64 usec);
+
+    quint64 count() const { return _count; }
+    // All times in ms
+    double mean() const { return (_count > 0 ? static_cast<double>(_total) / 1000. / static_cast<double>(_count) : 0); }
+    double max() const { return static_cast<double>(_max) / 1000.; }
+    // Returns an upper bound of the `p`-quantile (0 <= p <= 1), i.e., the
+    // upper boundary of the bucket containing it
+    double percentile(const double p) const;
+    quint64 bucket(const int i) const { return (i >= 0 && i < BucketCount ? _buckets[i] : 0); }
+    QVariantMap toVariantMap() const;
+
+  private:
+    quint64 _count;
+    qint64 _total, _max; // in us
+    quint64 _buckets[BucketCount];
+  };
+
+  enum Counter {
+    TilesRendered, // finished page rendering requests
+    RendersAborted, // aborted page rendering requests
+    CacheHits, // tile lookups answered by a current tile
+    PlaceholderHits, // tile lookups answered by a tile still being rendered
+    CacheMisses, // tile lookups that triggered a render request
+    PlaceholdersCreated, // dummy tiles constructed for cache misses
+    TilesPrefetched, // tiles requested ahead of scrolling (see PDFScrollPrefetcher)
+    LinkCacheHits, // link requests answered by validated links from the link cache
+    LinksRequested, // link loading requests queued (see Page::asyncLoadLinks())
+    CounterCount
+  };
+
+  // A consistent copy of all values at some point in time
+  class Snapshot
+  {
+  public:
+    Snapshot();
+
+    bool enabled;
+    // Time (in ms) that statistics were collected for since the last reset
+    qint64 elapsed;
+    Histogram queueWait, renderTime;
+    quint64 counters[CounterCount];
+    // Not collected by RenderStatistics itself; filled in by
+    // Document::renderStatistics()
+    QString backend;
+    qint64 bytesCached;
+    // Number of page objects currently held by the document (see
+    // Document::setMaxResidentPages())
+    int residentPages;
+
+    // Ratio of tile lookups answered from the cache (0 if there were none)
+    double cacheHitRate() const;
+    // Average throughput since the last reset
+    double tilesPerSecond() const;
+    QVariantMap toVariantMap() const;
+  };
+
+  RenderStatistics();
+
+  bool isEnabled() const { return _enabled.loadAcquire() != 0; }
+  // Enabling starts a new collection period (see reset())
+  void setEnabled(const bool enabled);
+  void reset();
+
+  // The following do nothing unless collection is enabled
+  void addQueueWait(const qint64 usec);
+  void addRenderTime(const qint64 usec);
+  void increment(const Counter counter);
+
+  Snapshot snapshot() const;
+
+private:
+  Q_DISABLE_COPY(RenderStatistics)
+
+  QAtomicInt _enabled;
+  mutable QMutex _mutex;
+  // Guarded by _mutex
+  QElapsedTimer _timer;
+  Histogram _queueWait, _renderTime;
+  quint64 _counters[CounterCount];
+};
+
+
 // Class to perform (possibly) lengthy operations on pages in the background
 // Modelled after the "Blocking Fortune Client Example" in the Qt docs
 // (http://doc.qt.nokia.com/stable/network-blockingfortuneclient.html)
@@ -340,33 +593,77 @@ class PDFPageProcessingThread : public QThread
   Q_OBJECT
 
 public:
+  // Low priority requests (e.g., thumbnails) are only processed when no
+  // normal priority requests are pending
+  enum Priority { NormalPriority, LowPriority };
+
   PDFPageProcessingThread();
   virtual ~PDFPageProcessingThread();
 
   // add a processing request to the work stack
   // Note: request must have been created on the heap and must be in the scope
   // of this thread; use requestRenderPage() and requestLoadLinks() for that
-  void addPageProcessingRequest(PageProcessingRequest * request);
+  void addPageProcessingRequest(PageProcessingRequest * request, const Priority priority = NormalPriority);
 
-  // drop all remaining processing requests
+  // drop all remaining processing requests and abort the one currently being
+  // processed (if any)
   // WARNING: This function *must not* be called while the calling thread holds
   // any locks that would prevent and work item from finishing. Otherwise, we
   // could run into the following deadlock scenario:
-  // clearWorkStack() waits for the currently active work items to finish. The
-  // currently active work item waits to acquire a lock necessary for it to
-  // finish. However, that lock is held by the caller of clearWorkStack().
+  // clearWorkStack() waits for the currently active work item to return (which
+  // should happen quickly as it is aborted). The currently active work item
+  // waits to acquire a lock necessary for it to return. However, that lock is
+  // held by the caller of clearWorkStack().
   void clearWorkStack();
 
+  // drop all remaining processing requests for `listener` and abort the one
+  // currently being processed (if it is for `listener`) without waiting for
+  // it; as that one may still post its result, `listener` must ignore results
+  // it no longer needs (use cancelRequestsAndWait() before destroying it)
+  void cancelRequests(const QObject * listener);
+  // same as above, but only drops requests of the given `type`
+  void cancelRequests(const QObject * listener, const PageProcessingRequest::Type type);
+  // same as above, but for several listeners at once (in one pass over the
+  // work stack)
+  void cancelRequests(const QSet<const QObject*> & listeners, const PageProcessingRequest::Type type);
+  // drop the pending rendering requests of `listener` whose tiles are not in
+  // `keep` (e.g., the prefetches the view has scrolled past, while those still
+  // ahead stay queued); the request currently being processed is not aborted
+  void cancelRenderRequests(const QObject * listener, const QSet<PDFPageTile> & keep);
+  // same as cancelRequests(listener), but also waits for the current request
+  // (if it is for `listener`) to return; afterwards, no more events are posted
+  // to `listener` (e.g., so it can be destroyed). As some backends can't abort
+  // rendering, this can block for as long as rendering a tile takes.
+  // WARNING: The same restrictions as for clearWorkStack() apply
+  void cancelRequestsAndWait(const QObject * listener);
+
+  // Lock-free (the object lives as long as the thread object)
+  RenderStatistics & statistics() { return *_statistics; }
+  // Lock-free; for objects that may outlive the thread object (see
+  // Page::getTileImage())
+  QSharedPointer<RenderStatistics> sharedStatistics() const { return _statistics; }
+
 protected:
   virtual void run();
 
 private:
+  // Does the actual work for cancelRequests() and cancelRequestsAndWait(); if
+  // `type` is nullptr, requests of any type are dropped
+  void cancelMatchingRequests(const QSet<const QObject*> & listeners, const PageProcessingRequest::Type * type, const bool wait);
+
   QStack<PageProcessingRequest*> _workStack;
+  QStack<PageProcessingRequest*> _lowPriorityWorkStack;
+  // The request currently being executed (if any); guarded by _mutex
+  PageProcessingRequest * _currentWorkItem;
   QMutex _mutex;
   QWaitCondition _waitCondition;
   bool _idle;
   QWaitCondition _idleCondition;
+  // Signalled whenever a work item has been processed (see
+  // cancelRequestsAndWait())
+  QWaitCondition _workItemDoneCondition;
   bool _quit;
+  const QSharedPointer<RenderStatistics> _statistics;
 #ifdef DEBUG
   QTime _renderTimer;
   static void dumpWorkStack(const QStack<PageProcessingRequest*> & ws);
@@ -415,7 +712,9 @@ protected:
 
 typedef QList<PDFToCItem> PDFToC;
 
-enum SearchFlag { Search_WrapAround = 0x01, Search_CaseInsensitive = 0x02, Search_Backwards = 0x04};
+// Search_WithContext is only honored by Page::executeSearch() (see
+// SearchResult::context); the backends ignore it
+enum SearchFlag { Search_WrapAround = 0x01, Search_CaseInsensitive = 0x02, Search_Backwards = 0x04, Search_WithContext = 0x08};
 Q_DECLARE_FLAGS(SearchFlags, SearchFlag)
 Q_DECLARE_OPERATORS_FOR_FLAGS(SearchFlags)
 
@@ -425,15 +724,54 @@ struct SearchRequest
   int pageNum;
   QString searchString;
   SearchFlags flags;
+  // Shared by all requests of one search so the whole search can be aborted
+  AbortToken abortToken;
 };
 
 struct SearchResult
 {
   unsigned int pageNum;
   QRectF bbox;
+  // The match along with some text before and after it on the same line
+  // (e.g., for listing results); empty unless Search_WithContext was requested
+  // and the backend supports extracting text with character boxes
+  QString context;
 };
 
 
+// Read-only contents of one version ("generation") of a PDF file. All documents
+// showing the same generation of a file (e.g., in several windows) share one
+// instance, so the file is only read once and its data is not duplicated in
+// memory. A new generation is read whenever the file's size or modification
+// time changes.
+// This class is thread-safe.
+class FileSource
+{
+public:
+  // Returns the source for the current generation of `fileName`, reading the
+  // file only if no document holds that generation already. Returns a null
+  // pointer if the file can't be read.
+  static QSharedPointer<const FileSource> open(const QString & fileName);
+  // Returns true if the registry has an entry for `fileName`. Entries of
+  // sources no longer in use are only dropped when another file is opened.
+  static bool isRegistered(const QString & fileName);
+
+  const QByteArray & data() const { return _data; }
+  qint64 size() const { return _data.size(); }
+  QDateTime lastModified() const { return _lastModified; }
+
+private:
+  FileSource(const QByteArray & data, const QDateTime & lastModified) : _data(data), _lastModified(lastModified) { }
+  Q_DISABLE_COPY(FileSource)
+
+  const QByteArray _data;
+  const QDateTime _lastModified;
+
+  // Maps canonical file names to the sources currently in use
+  static QMutex _registryMutex;
+  static QHash< QString, QWeakPointer<const FileSource> > _registry;
+};
+
 // PDF ABCs
 // ========
 // This header file defines a set of Abstract Base Classes (ABCs) for PDF
@@ -444,7 +782,9 @@ struct SearchResult
 // documentChanged() after reload, unlocking, etc.)?
 
 // This class is thread-safe. See implementation for internals.
-class Document
+// Documents register themselves with CacheRegistry, so their rendered tiles
+// and page objects are released if memory runs low.
+class Document : public ShrinkableCache
 {
   friend class Page;
 
@@ -461,31 +801,130 @@ public:
                   };
   Q_DECLARE_FLAGS(Permissions, Permission)
 
+protected:
+  // Immutable snapshot of the document-level data of one "generation" of the
+  // document, i.e., from one (re)load or unlock to the next. Snapshots are
+  // published with an atomic pointer swap, so getters never need to lock.
+  struct MetaData
+  {
+    MetaData() : numPages(-1), fileSize(0), trapped(Trapped_Unknown) { }
+
+    int numPages;
+    QString fileName;
+    Permissions permissions;
+    QString title;
+    QString author;
+    QString subject;
+    QString keywords;
+    QSizeF pageSize;
+    QString creator;
+    QString producer;
+    QDateTime creationDate;
+    QDateTime modDate;
+    qint64 fileSize;
+    TrappedState trapped;
+    QMap<QString, QString> other;
+  };
+
+  // Table of page objects of one generation of the document. The size is fixed
+  // on construction. Slots are filled when page objects are created and
+  // emptied when they are evicted (see Document::setMaxResidentPages()); each
+  // slot is replaced atomically, so it can be read without locking. A new
+  // (empty) table is published whenever the pages are cleared.
+  class PageTable
+  {
+  public:
+    explicit PageTable(const int size);
+    ~PageTable();
+
+    int size() const { return _size; }
+    // Lock-free; returns a null pointer if the page was not created, yet (or
+    // was evicted)
+    QSharedPointer<Page> at(const int i) const;
+    // Lock-free; number of occupied slots
+    int numResident() const { return _numResident.loadAcquire(); }
+    // Puts `page` into slot `i` (taking ownership) unless the slot is already
+    // occupied, in which case `page` is deleted. Returns the page in the slot.
+    // Calls must be serialized (see Document::_pageCreationMutex).
+    QSharedPointer<Page> insert(const int i, Page * page);
+    // Empties slot `i` and returns the page that was in it. Calls must be
+    // serialized (see Document::_pageCreationMutex).
+    QSharedPointer<Page> remove(const int i);
+    // Indices of the occupied slots. Calls must be serialized (see
+    // Document::_pageCreationMutex).
+    QList<int> residentSlots() const { return _residentSlots; }
+
+  private:
+    Q_DISABLE_COPY(PageTable)
+    const int _size;
+    // NB: Only access the slots through std::atomic_load/std::atomic_store
+    std::shared_ptr< QSharedPointer<Page> > * _slots;
+    QAtomicInt _numResident;
+    // Guarded by Document::_pageCreationMutex
+    QList<int> _residentSlots;
+  };
+
+public:
+
   Document(const QString fileName);
   virtual ~Document();
 
-  // Uses doc-read-lock
-  int numPages();
-  // Uses doc-read-lock
-  QString fileName() const { QReadLocker docLocker(_docLock.data()); return _fileName; }
-  // Uses doc-read-lock
-  PDFPageProcessingThread& processingThread();
-  // Uses doc-read-lock
-  PDFPageCache& pageCache();
-
-  // Uses doc-read-lock and may use doc-write-lock
-  virtual QWeakPointer<Page> page(int at) = 0;
-  // Uses doc-read-lock
-  virtual QWeakPointer<Page> page(int at) const = 0;
+  // Lock-free
+  int numPages() const { return metaData()->numPages; }
+  // Lock-free
+  QString fileName() const { return metaData()->fileName; }
+  // Lock-free (the objects live as long as the document)
+  PDFPageProcessingThread& processingThread() { return _processingThread; }
+  // Lock-free (the objects live as long as the document)
+  PDFPageCache& pageCache() { return *_pageCache; }
+  // Collection of render statistics is disabled by default; enable it with
+  // processingThread().statistics().setEnabled(true)
+  // Lock-free
+  RenderStatistics::Snapshot renderStatistics();
+  // Name of the backend handling this document (as BackendInterface::name())
+  // Lock-free
+  virtual QString backendName() const { return QString(); }
+
+  // ShrinkableCache interface; the size only accounts for the rendered tiles
+  // (see pageCache()). If releasing tiles is not enough, the least recently
+  // used half of the page objects is released as well (their size is not
+  // known, so they don't count as released).
+  // Lock-free (cacheName(), cacheSize()) / uses doc-read-lock (shrinkCache())
+  QString cacheName() const;
+  qint64 cacheSize() const { return _pageCache->totalSize(); }
+  qint64 shrinkCache(const qint64 bytes);
+
+  // Lock-free if the page object already exists; otherwise uses doc-read-lock
+  // to create it (see newPage())
+  virtual QWeakPointer<Page> page(int at);
+  // Lock-free; only returns page objects that already exist
+  virtual QWeakPointer<Page> page(int at) const;
+  // Returns the size (in pt) of page `at`, or an empty size if there is no
+  // such page. Unlike page(at)->pageSizeF(), this need not create the page
+  // object (which can be expensive), e.g., for laying out all pages. The
+  // default implementation does create it, though.
+  // Lock-free if the page object exists; otherwise uses doc-read-lock
+  virtual QSizeF pageSizeF(int at);
+
+  // Limits the number of page objects the document holds at any time to
+  // `maxPages` (0 means no limit). If the limit is exceeded, the least
+  // recently used page objects are released; they are created again by
+  // page() when they are needed. Page objects that are still referenced
+  // elsewhere (e.g., by pending processing requests) live on until they are
+  // released there. This bounds the memory used by the backends' page data
+  // for very large documents.
+  // Lock-free
+  void setMaxResidentPages(const int maxPages) { _maxResidentPages.storeRelease(qMax(0, maxPages)); }
+  int maxResidentPages() const { return _maxResidentPages.loadAcquire(); }
+  // Lock-free
+  int residentPages() const { return pageTable()->numResident(); }
   virtual PDFDestination resolveDestination(const PDFDestination & namedDestination) const {
     return (namedDestination.isExplicit() ? namedDestination : PDFDestination());
   }
 
 
-  // Uses doc-read-lock
-  Permissions permissions() const { QReadLocker docLocker(_docLock.data()); return _permissions; }
-  // Uses doc-read-lock
-  Permissions& permissions() { QReadLocker docLocker(_docLock.data()); return _permissions; }
+  // Lock-free
+  Permissions permissions() const { return metaData()->permissions; }
   
   // Uses doc-read-lock
   virtual bool isValid() const = 0;
@@ -493,6 +932,10 @@ public:
   virtual bool isLocked() const = 0;
   // Uses doc-write-lock
   virtual void reload() = 0;
+  // Returns true if the document was parsed from the current version of the
+  // file on disk (see FileSource), i.e., if reload() wouldn't change anything
+  // Uses doc-read-lock
+  bool isUpToDate() const;
 
   // Returns `true` if unlocking was successful and `false` otherwise.  
   // Uses doc-read-lock and may use doc-write-lock
@@ -502,20 +945,39 @@ public:
   // strutures of the pdf file.
   virtual PDFToC toc() const { return PDFToC(); }
   virtual QList<PDFFontInfo> fonts() const { return QList<PDFFontInfo>(); }
+  // Same as toc() and fonts(), but the results are kept for as long as the
+  // file doesn't change (see FileSource), so reloading an unchanged file
+  // doesn't extract them again. As the extraction can take long for large
+  // documents, these are meant to be called from a background thread.
+  // Concurrent calls don't block each other, but may extract the same
+  // results more than once.
+  // Uses doc-read-lock
+  PDFToC cachedToC();
+  QList<PDFFontInfo> cachedFonts();
+
+  // Links loaded for a page (see Page::asyncLoadLinks()), keyed by
+  // Page::linkCacheKey(). The cache is shared by all documents, so the links
+  // of unchanged pages are available right away after a file was regenerated
+  // and loaded into a new document object (see PDFDocumentWidget::load()).
+  // The returned links are copies that can be attached to a page freely.
+  // Lock-free (uses an internal mutex)
+  static bool cachedLinks(const QByteArray & key, QList< QSharedPointer<Annotation::Link> > & links);
+  static void cacheLinks(const QByteArray & key, const QList< QSharedPointer<Annotation::Link> > & links);
 
   // <metadata>
-  QString title() const { QReadLocker docLocker(_docLock.data()); return _meta_title; }
-  QString author() const { QReadLocker docLocker(_docLock.data()); return _meta_author; }
-  QString subject() const { QReadLocker docLocker(_docLock.data()); return _meta_subject; }
-  QString keywords() const { QReadLocker docLocker(_docLock.data()); return _meta_keywords; }
-  QString creator() const { QReadLocker docLocker(_docLock.data()); return _meta_creator; }
-  QString producer() const { QReadLocker docLocker(_docLock.data()); return _meta_producer; }
-  QDateTime creationDate() const { QReadLocker docLocker(_docLock.data()); return _meta_creationDate; }
-  QDateTime modDate() const { QReadLocker docLocker(_docLock.data()); return _meta_modDate; }
-  QSizeF pageSize() const { QReadLocker docLocker(_docLock.data()); return _meta_pageSize; }
-  qint64 fileSize() const { QReadLocker docLocker(_docLock.data()); return _meta_fileSize; }
-  TrappedState trapped() const { QReadLocker docLocker(_docLock.data()); return _meta_trapped; }
-  QMap<QString, QString> metaDataOther() const { QReadLocker docLocker(_docLock.data()); return _meta_other; }
+  // All lock-free
+  QString title() const { return metaData()->title; }
+  QString author() const { return metaData()->author; }
+  QString subject() const { return metaData()->subject; }
+  QString keywords() const { return metaData()->keywords; }
+  QString creator() const { return metaData()->creator; }
+  QString producer() const { return metaData()->producer; }
+  QDateTime creationDate() const { return metaData()->creationDate; }
+  QDateTime modDate() const { return metaData()->modDate; }
+  QSizeF pageSize() const { return metaData()->pageSize; }
+  qint64 fileSize() const { return metaData()->fileSize; }
+  TrappedState trapped() const { return metaData()->trapped; }
+  QMap<QString, QString> metaDataOther() const { return metaData()->other; }
   // </metadata>
 
   // Searches the entire document for the given string and returns a list of
@@ -527,19 +989,50 @@ public:
   //     return the search results one at a time rather than all at once.
   //
   //   - See TODO list in `Page::search`
-  virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags, const int startPage = 0);
+  virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags, const int startPage = 0, const AbortToken & abort = AbortToken());
 
 protected:
+  // Creates the backend-specific page object for page `at`. Called from
+  // page() with the doc-read-lock and _pageCreationMutex held. May return
+  // nullptr if the page cannot be created.
+  virtual Page * newPage(int at) = 0;
+
+  // Uses doc-write-lock
   virtual void clearPages();
+  // Releases the least recently used page objects of `table` (except the one
+  // in slot `keep`) until at most `maxPages` remain (0 means no limit).
+  // The caller must hold a doc-read-lock and _pageCreationMutex.
+  void evictPages(PageTable & table, const int keep, const int maxPages);
+  // Detaches all page objects and publishes a new, empty page table for
+  // _numPages pages. Unlike clearPages(), this does not touch the processing
+  // thread and can therefore be called while holding the doc-write-lock.
+  void resetPageTable();
+  // Resets the staging members below; publishMetaData() must be called
+  // afterwards to make the changes visible.
   virtual void clearMetaData();
+  // Publishes a new immutable snapshot of the staging members below (and a new
+  // page table if the number of pages changed). Uses doc-write-lock.
+  void publishMetaData();
+
+  // Lock-free access to the current snapshots
+  std::shared_ptr<const MetaData> metaData() const { return std::atomic_load(&_metaData); }
+  std::shared_ptr<PageTable> pageTable() const { return std::atomic_load(&_pageTable); }
 
-  int _numPages;
   PDFPageProcessingThread _processingThread;
-  PDFPageCache _pageCache;
-  QVector< QSharedPointer<Page> > _pages;
+  // Shared with the page objects, so they can look up tiles without locking
+  // (see Page::getCachedImage())
+  const QSharedPointer<PDFPageCache> _pageCache;
+
+  // Staging area for the document-level data. These members are only accessed
+  // by the backends while holding the doc-write-lock (e.g., while (re)parsing
+  // the document); readers use the snapshot published by publishMetaData().
+  int _numPages;
   Permissions _permissions;
 
   QString _fileName;
+  // The data the backend parsed the current generation of the document from;
+  // must be kept alive as long as the backend may read from it
+  QSharedPointer<const FileSource> _fileSource;
 
   QString _meta_title;
   QString _meta_author;
@@ -554,19 +1047,76 @@ protected:
   TrappedState _meta_trapped;
   QMap<QString, QString> _meta_other;
   QSharedPointer<QReadWriteLock> _docLock;
+
+private:
+  // NB: Only access these through std::atomic_load/std::atomic_store (see
+  // metaData() and pageTable()).
+  std::shared_ptr<const MetaData> _metaData;
+  std::shared_ptr<PageTable> _pageTable;
+
+  // Returns the generation the results of cachedToC() and cachedFonts() must
+  // belong to, or a null pointer if the results must not be cached (e.g.,
+  // because the document is locked).
+  // Uses doc-read-lock
+  QSharedPointer<const FileSource> currentInfoCacheSource();
+
+  // Only held while accessing the cached results, not while extracting them,
+  // so e.g. the ToC doesn't have to wait for a lengthy font scan
+  QMutex _infoCacheMutex;
+  // Guarded by _infoCacheMutex; each result is valid for the generation it
+  // was extracted from
+  QWeakPointer<const FileSource> _cachedToCSource, _cachedFontsSource;
+  PDFToC _cachedToC;
+  QList<PDFFontInfo> _cachedFonts;
+  static QMutex _linkCacheMutex;
+  // Guarded by _linkCacheMutex; the cost of an entry is the number of links
+  static QCache< QByteArray, QList< QSharedPointer<Annotation::Link> > > _linkCache;
+  // Serializes the creation of page objects (which happens lazily) without
+  // blocking readers
+  QMutex _pageCreationMutex;
+  // Page objects evicted from the current page table that may still be
+  // referenced elsewhere; they must be detached when the document changes.
+  // Guarded by _pageCreationMutex.
+  QList< QWeakPointer<Page> > _evictedPages;
+  QAtomicInt _maxResidentPages;
+  // Incremented on every access to a page object (see Page::_lastAccess)
+  QAtomicInt _accessClock;
 };
 
 // This class is thread-safe. See implementation for internals.
-class Page
+class Page : public QEnableSharedFromThis<Page>
 {
   friend class Document;
+  friend class PageProcessingRenderPageRequest;
+  friend class PageProcessingContentBoundingBoxRequest;
 
 protected:
   Document *_parent;
   const int _n;
+  // Value of the parent's access clock when the page was last accessed through
+  // Document::page(); used to find the least recently used pages
+  QAtomicInt _lastAccess;
   Transition::AbstractTransition * _transition;
   QReadWriteLock * _pageLock;
   const QSharedPointer<QReadWriteLock> _docLock;
+  // The parent's page cache and render statistics; as they are shared, they
+  // can be used without holding any locks (unlike _parent)
+  const QSharedPointer<PDFPageCache> _pageCache;
+  const QSharedPointer<RenderStatistics> _statistics;
+  // Non-zero as long as the page is attached to its parent (see
+  // detachFromParent()); lets lock-free code check for that
+  QAtomicInt _attached;
+  // Cached results of getContentBoundingBox() (low and high precision); null
+  // if not computed, yet. Guarded by _pageLock.
+  mutable QRectF _contentBoundingBox[2];
+  // Non-zero while a request to precompute the content bounding box (low and
+  // high precision) is queued (see asyncContentBoundingBox())
+  QAtomicInt _contentBoundingBoxQueued[2];
+
+  // Does the actual work for getContentBoundingBox() (without caching); can be
+  // reimplemented by backends that can determine the bounding box directly.
+  // Uses page-read-lock and doc-read-lock.
+  virtual QRectF computeContentBoundingBox(const bool highPrecision) const;
 
   // Getter for derived classes (that are not friends of Document)
   QSharedPointer<QReadWriteLock> docLock() const { return _docLock; }
@@ -575,11 +1125,15 @@ protected:
 
   Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock);
 
-  // Uses doc-read-lock and page-read-lock.
-  QSharedPointer<QImage> getCachedImage(double xres, double yres, QRect render_box = QRect(), PDFPageCache::TileStatus * status = nullptr);
+  // Renders the page, applies `colorFilter` and (if `cache` is true) puts the
+  // result into the page cache under the key including the filter. For a null
+  // filter, this is equivalent to renderToImage().
+  // Uses page-read-lock and doc-read-lock (for rendering).
+  QImage renderToFilteredImage(double xres, double yres, QRect render_box, bool cache, const PDFPageColorFilter & colorFilter, const AbortToken & abort = AbortToken()) const;
 
-  // Uses doc-read-lock and page-read-lock.
-  virtual void asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false);
+  // Does the actual work for placeholderTile().
+  // The caller must hold a doc-read-lock and page-read-lock.
+  QImage * constructPlaceholderTile(const double xres, const double yres, const QRect & render_box, const PDFPageColorFilter & colorFilter) const;
 
 public:
   // Class to encapsulate boxes, e.g., for selecting
@@ -592,14 +1146,49 @@ public:
   virtual ~Page();
 
   Document * document() { QReadLocker pageLocker(_pageLock); return _parent; }
-  int pageNum();
+  // Lock-free (the page number never changes)
+  int pageNum() const { return _n; }
   virtual QSizeF pageSizeF() const = 0;
-  virtual QRectF getContentBoundingBox() const;
+  // Returns the bounding box of the content of the page (in pdf coordinates,
+  // i.e., bp). The page is rendered at low resolution for this, which yields
+  // an accuracy of about 1% of the page size (0.1% if `highPrecision` is true).
+  // The result is cached, so only the first call for each page object (i.e.,
+  // per document generation) is expensive.
+  // Uses page-read-lock and doc-read-lock (and page-write-lock to cache).
+  QRectF getContentBoundingBox(const bool highPrecision = false) const;
+  // Returns true if getContentBoundingBox() is cached and therefore cheap.
+  // Uses page-read-lock.
+  bool hasContentBoundingBox(const bool highPrecision = false) const;
+  // Computes the content bounding box in the background (see
+  // PageProcessingContentBoundingBoxRequest). If there is no `listener` (i.e.,
+  // the box is only precomputed), nothing is queued if the box is cached or
+  // queued already.
+  // Uses doc-read-lock and page-read-lock.
+  virtual void asyncContentBoundingBox(QObject *listener = nullptr, const bool highPrecision = false, const PDFPageProcessingThread::Priority priority = PDFPageProcessingThread::NormalPriority);
   Transition::AbstractTransition * transition() { QReadLocker pageLocker(_pageLock); return _transition; }
 
-  virtual QList< QSharedPointer<Annotation::Link> > loadLinks() = 0;
+  // If `abort` is triggered before the links could be loaded, an empty list is
+  // returned and the links are loaded again on the next call
+  virtual QList< QSharedPointer<Annotation::Link> > loadLinks(const AbortToken & abort = AbortToken()) = 0;
+  // Posts the links to `listener` (see PDFLinksLoadedEvent). If the links are
+  // not in the link cache (see Document::cachedLinks()), they are loaded in
+  // the background with low priority (i.e., after all pending tiles have been
+  // rendered). If the cached links can't be validated (see linkCacheKey()),
+  // they are posted right away and again once they have been reloaded.
   // Uses doc-read-lock and page-read-lock.
   virtual void asyncLoadLinks(QObject *listener);
+  // Returns a hash of the page's annotations (which include its links) that
+  // doesn't depend on the file they come from, or an empty value if the
+  // backend can't compute one (the default).
+  // Uses page-read-lock.
+  virtual QByteArray fingerprint() const;
+  // Returns the key of the page's links in the link cache. It is derived from
+  // fingerprint() if available (`validated` is set to `true`); otherwise, it
+  // is derived from the file name and the page number, i.e., the links of a
+  // previous version of the file are carried over and must be reloaded to
+  // validate them.
+  // Uses doc-read-lock and page-read-lock.
+  QByteArray linkCacheKey(bool * validated = nullptr) const;
   
   // Returns a list of boxes (e.g., for the purpose of selecting text)
   // Box rectangles are in pdf coordinates (i.e., bp)
@@ -607,7 +1196,8 @@ public:
   // of characters) to speed up hit calculations. Only one level of subboxes is
   // currently supported. The big box boundingBox must completely encompass all
   // subBoxes' boundingBoxes.
-  virtual QList<Box> boxes() { return QList<Box>(); }
+  // If `abort` is triggered, the (possibly incomplete) list is returned early.
+  virtual QList<Box> boxes(const AbortToken & abort = AbortToken()) { Q_UNUSED(abort) return QList<Box>(); }
   // Return selected text
   // The returned text should contain all characters inside (at least) one of
   // the `selection` polygons.
@@ -615,24 +1205,53 @@ public:
   // Optionally, the function can also return wordBoxes and/or charBoxes for
   // each character (i.e., a rect enclosing the word the character is part of
   // and/or a rect enclosing the actual character)
-  virtual QString selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes = nullptr, QMap<int, QRectF> * charBoxes = nullptr, const bool onlyFullyEnclosed = false) {
+  // If `abort` is triggered, the (possibly incomplete) text is returned early.
+  virtual QString selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes = nullptr, QMap<int, QRectF> * charBoxes = nullptr, const bool onlyFullyEnclosed = false, const AbortToken & abort = AbortToken()) {
     Q_UNUSED(selection)
     Q_UNUSED(onlyFullyEnclosed)
+    Q_UNUSED(abort)
     if (wordBoxes) wordBoxes->clear();
     if (charBoxes) charBoxes->clear();
     return QString();
   }
 
+  // If `abort` is triggered while rendering, a null image is returned and
+  // nothing is added to the cache.
   // Uses page-read-lock and doc-read-lock.
-  virtual QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false) const = 0;
+  virtual QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const AbortToken & abort = AbortToken()) const = 0;
+
+  // Renders the page in the background; once done, a PDFPageRenderedEvent is
+  // posted to `listener`. If `cache` is true, the result is also put into the
+  // page cache.
+  // Uses doc-read-lock and page-read-lock.
+  virtual void asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false, const PDFPageColorFilter & colorFilter = PDFPageColorFilter());
+  // Same as asyncRenderToImage() (with `cache` = false), but with low priority,
+  // i.e., the request is only processed when no other requests are pending.
+  // Intended for thumbnails and similar low-resolution images that must not
+  // delay the rendering of the main view.
+  // Uses doc-read-lock and page-read-lock.
+  void asyncRenderThumbnail(QObject *listener, double xres, double yres, const PDFPageColorFilter & colorFilter = PDFPageColorFilter());
 
   // Returns either a cached image (if it exists), or triggers a render request.
   // If listener != nullptr, this is an asynchronous render request and the method
   // returns a dummy image (which is added to the cache to speed up future
   // requests). Otherwise, the method renders the page synchronously and returns
   // the result.
+  // The returned image has `colorFilter` applied already (filtered tiles are
+  // cached separately), so it can be painted as-is.
+  // Lock-free if the tile is cached (or pending) already; otherwise uses
+  // doc-read-lock and page-read-lock.
+  QSharedPointer<QImage> getTileImage(QObject * listener, const double xres, const double yres, QRect render_box = QRect(), const PDFPageColorFilter & colorFilter = PDFPageColorFilter());
+  // Returns the tile from the page cache (regardless of its status) without
+  // triggering any rendering, or a null pointer if it is not cached.
+  // Lock-free
+  QSharedPointer<QImage> getCachedImage(double xres, double yres, QRect render_box = QRect(), PDFPageCache::TileStatus * status = nullptr, const PDFPageColorFilter & colorFilter = PDFPageColorFilter());
+  // Constructs a dummy image for the tile `render_box` (at `xres` x `yres`),
+  // reusing (by scaling) whatever overlapping tiles of this page the page
+  // cache currently holds. The cache itself is not modified. The caller takes
+  // ownership of the returned image.
   // Uses page-read-lock and doc-read-lock.
-  QSharedPointer<QImage> getTileImage(QObject * listener, const double xres, const double yres, QRect render_box = QRect());
+  QImage * placeholderTile(const double xres, const double yres, const QRect & render_box, const PDFPageColorFilter & colorFilter = PDFPageColorFilter()) const;
 
   virtual QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations() { return QList< QSharedPointer<Annotation::AbstractAnnotation> >(); }
 
@@ -649,7 +1268,12 @@ public:
   //
   // This is very tricky to do in C++. God I miss Python and its `itertools`
   // library.
-  virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags) = 0;
+  //
+  // If `abort` is triggered, the results found so far are returned.
+  virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags, const AbortToken & abort = AbortToken()) = 0;
+  // Runs `request` (e.g., in a background thread, see QtConcurrent::mapped());
+  // with Search_WithContext, the text of all lines with matches is extracted
+  // in one go to fill in SearchResult::context
   static QList<SearchResult> executeSearch(SearchRequest request);
 };
 
@@ -663,11 +1287,27 @@ public:
   virtual QSharedPointer<Backend::Document> newDocument(const QString & fileName) = 0;
   virtual QString name() const = 0;
   virtual bool canHandleFile(const QString & fileName) = 0;
+
+  // Returns the document of this backend that is open for the current version
+  // of `fileName` if there is one, or a new one (see newDocument()) otherwise.
+  // Several views of the same file can thus share one document, including its
+  // processing thread and page cache, so the file is parsed and each tile is
+  // rendered only once.
+  // Thread-safe
+  QSharedPointer<Backend::Document> sharedDocument(const QString & fileName);
+
+private:
+  // Maps backend names and canonical file names to the documents in use
+  static QMutex _documentRegistryMutex;
+  static QHash< QString, QWeakPointer<Backend::Document> > _documentRegistry;
 };
 
 } // namespace QtPDF
 
 Q_DECLARE_INTERFACE(QtPDF::BackendInterface, "org.tug.QtPDF/1.0")
+// Allow abort tokens to be passed as QVariant closures (e.g., to Poppler's
+// abort callbacks)
+Q_DECLARE_METATYPE(QtPDF::Backend::AbortToken)
 
 // Backend Implementations
 // =======================
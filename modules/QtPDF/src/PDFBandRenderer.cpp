@@ -0,0 +1,158 @@
+/**
+ * Copyright (C) 2013-2018  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#include "PDFBandRenderer.h"
+
+#include <QtConcurrent>
+
+namespace QtPDF {
+
+// Default height (in pixels) of the bands
+static const int DEFAULT_BAND_HEIGHT = 256;
+
+PDFBandRenderer::PDFBandRenderer(const QList< QSharedPointer<Backend::Document> > & docs, const QList<int> & pages, const double dpi, QObject * parent /* = nullptr */) :
+  QObject(parent),
+  _docs(docs),
+  _pages(pages),
+  _dpi(dpi),
+  _bandHeight(DEFAULT_BAND_HEIGHT),
+  _maxBufferedBands(2 * qMax(1, docs.size())),
+  _nextBand(0),
+  _nextToDeliver(0),
+  _abort(Backend::AbortToken::create()),
+  _running(false),
+  _cancelled(false)
+{
+  _threadPool.setMaxThreadCount(qMax(1, docs.size()));
+}
+
+PDFBandRenderer::~PDFBandRenderer()
+{
+  if (_running) {
+    _abort.abort();
+    _freeSlots.release(_docs.size());
+    _workers.waitForFinished();
+  }
+}
+
+void PDFBandRenderer::start()
+{
+  if (_running || _docs.isEmpty() || !_docs.first())
+    return;
+
+  // Split all pages into bands
+  // NB: Compute the page size like Page::renderToImage() does for full pages
+  _bands.clear();
+  foreach (int page, _pages) {
+    const QSizeF size(_docs.first()->pageSizeF(page));
+    Band band;
+    band.page = page;
+    band.pageSize = QRectF(0, 0, size.width() * _dpi / 72., size.height() * _dpi / 72.).toAlignedRect().size();
+    for (int y = 0; y < band.pageSize.height(); y += _bandHeight) {
+      band.rect = QRect(0, y, band.pageSize.width(), qMin(_bandHeight, band.pageSize.height() - y));
+      _bands << band;
+    }
+  }
+
+  _nextBand.storeRelease(0);
+  _nextToDeliver = 0;
+  _rendered.clear();
+  _cancelled = false;
+  _running = true;
+  _freeSlots.acquire(_freeSlots.available());
+  _freeSlots.release(_maxBufferedBands);
+
+  emit progress(0, _bands.size());
+  if (_bands.isEmpty()) {
+    finish();
+    return;
+  }
+  _workers.clearFutures();
+  foreach (QSharedPointer<Backend::Document> doc, _docs)
+    _workers.addFuture(QtConcurrent::run(&_threadPool, this, &PDFBandRenderer::work, doc));
+}
+
+void PDFBandRenderer::cancel()
+{
+  if (!_running)
+    return;
+  _cancelled = true;
+  _abort.abort();
+  // Wake up workers waiting for a free slot
+  _freeSlots.release(_docs.size());
+  finish();
+}
+
+void PDFBandRenderer::finish()
+{
+  // NB: Only the band currently being rendered (if any) needs to finish (or
+  // abort) here
+  _workers.waitForFinished();
+  _running = false;
+  {
+    QMutexLocker l(&_renderedMutex);
+    _rendered.clear();
+  }
+  emit finished(_cancelled);
+}
+
+void PDFBandRenderer::work(QSharedPointer<Backend::Document> doc)
+{
+  while (true) {
+    _freeSlots.acquire();
+    const int idx = _nextBand.fetchAndAddOrdered(1);
+    if (idx >= _bands.size() || _abort.isAborted()) {
+      // Pass the slot on to the next worker so it can terminate as well
+      _freeSlots.release();
+      break;
+    }
+
+    const Band & band = _bands[idx];
+    QImage img;
+    QSharedPointer<Backend::Page> page(doc ? doc->page(band.page).toStrongRef() : QSharedPointer<Backend::Page>());
+    if (page)
+      img = page->renderToImage(_dpi, _dpi, band.rect, false, _abort);
+    {
+      QMutexLocker l(&_renderedMutex);
+      _rendered.insert(idx, img);
+    }
+    QMetaObject::invokeMethod(this, "deliverBands", Qt::QueuedConnection);
+  }
+}
+
+void PDFBandRenderer::deliverBands()
+{
+  while (_running && _nextToDeliver < _bands.size()) {
+    QImage img;
+    {
+      QMutexLocker l(&_renderedMutex);
+      if (!_rendered.contains(_nextToDeliver))
+        return;
+      img = _rendered.take(_nextToDeliver);
+    }
+    const Band & band = _bands[_nextToDeliver];
+    ++_nextToDeliver;
+    // NB: The receiver may cancel() in response
+    emit bandReady(band.page, band.rect, band.pageSize, img);
+    if (!_running)
+      return;
+    _freeSlots.release();
+    emit progress(_nextToDeliver, _bands.size());
+  }
+  if (_running && _nextToDeliver >= _bands.size())
+    finish();
+}
+
+} // namespace QtPDF
+
+// vim: set sw=2 ts=2 et
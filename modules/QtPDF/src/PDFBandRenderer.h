@@ -0,0 +1,113 @@
+/**
+ * Copyright (C) 2013-2018  Stefan Löffler
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFBandRenderer_H
+#define PDFBandRenderer_H
+
+#include <PDFBackend.h>
+
+#include <QFutureSynchronizer>
+#include <QSemaphore>
+#include <QThreadPool>
+
+namespace QtPDF {
+
+// Rasterizes pages of a PDF document in horizontal bands (e.g., for printing
+// or for exporting pages as images) using several workers in parallel. Each
+// worker renders with its own document instance as the backends serialize
+// rendering per document (the instances share the file data, see
+// Backend::FileSource).
+// The bands are delivered in order (page by page, top to bottom) by
+// bandReady() in the thread the renderer lives in (usually the GUI thread). At
+// most maxBufferedBands() bands are rendered ahead of delivery, so the memory
+// needed is bounded by the size of a few bands, independent of the number of
+// pages and the resolution.
+class PDFBandRenderer : public QObject
+{
+  Q_OBJECT
+
+public:
+  // `docs` holds one document instance per worker (all for the same file);
+  // `pages` are 0-based
+  PDFBandRenderer(const QList< QSharedPointer<Backend::Document> > & docs, const QList<int> & pages, const double dpi, QObject * parent = nullptr);
+  // Cancels rendering (if necessary) and waits for the workers to finish
+  virtual ~PDFBandRenderer();
+
+  double dpi() const { return _dpi; }
+  // Height (in pixels) of the bands; must be set before start()
+  int bandHeight() const { return _bandHeight; }
+  void setBandHeight(const int bandHeight) { if (!_running && bandHeight > 0) _bandHeight = bandHeight; }
+  // Must be set before start()
+  int maxBufferedBands() const { return _maxBufferedBands; }
+  void setMaxBufferedBands(const int maxBufferedBands) { if (!_running && maxBufferedBands > 0) _maxBufferedBands = maxBufferedBands; }
+
+  bool isRunning() const { return _running; }
+  bool wasCancelled() const { return _cancelled; }
+
+public slots:
+  void start();
+  // Stops rendering as soon as possible; no more bands are delivered
+  void cancel();
+
+signals:
+  // `rect` is the part of page `page` (in pixels at dpi()) shown by `image`,
+  // `pageSize` the size of the whole page (in pixels). `image` is null if
+  // rendering failed.
+  void bandReady(int page, QRect rect, QSize pageSize, QImage image);
+  void progress(int done, int total);
+  void finished(bool cancelled);
+
+private slots:
+  // Emits bandReady() for all bands that are available in order
+  void deliverBands();
+
+private:
+  struct Band {
+    int page;
+    QRect rect;
+    QSize pageSize;
+  };
+
+  // Run by each worker
+  void work(QSharedPointer<Backend::Document> doc);
+  void finish();
+
+  QList< QSharedPointer<Backend::Document> > _docs;
+  QList<int> _pages;
+  double _dpi;
+  int _bandHeight;
+  int _maxBufferedBands;
+
+  QList<Band> _bands;
+  // Index (into _bands) of the next band to render
+  QAtomicInt _nextBand;
+  // Limits the number of bands that are rendered but not yet delivered
+  QSemaphore _freeSlots;
+  // Guards _rendered
+  QMutex _renderedMutex;
+  QMap<int, QImage> _rendered;
+  // Index (into _bands) of the next band to deliver
+  int _nextToDeliver;
+  Backend::AbortToken _abort;
+  bool _running;
+  bool _cancelled;
+
+  // NB: The workers don't use the global thread pool so they don't block (or
+  // get blocked by) other background tasks (e.g., searching)
+  QThreadPool _threadPool;
+  QFutureSynchronizer<void> _workers;
+};
+
+} // namespace QtPDF
+
+#endif // PDFBandRenderer_H
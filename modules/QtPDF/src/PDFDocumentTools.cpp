@@ -164,6 +164,8 @@ void MagnifyingGlass::mousePressEvent(QMouseEvent * event)
   if (_started) {
     _magnifier->prepareToShow();
     _magnifier->setPosition(event->pos());
+    _magnifier->prefetchTiles();
+    _lastPos = event->pos();
   }
   _magnifier->setVisible(_started);
 
@@ -189,6 +191,9 @@ void MagnifyingGlass::mouseMoveEvent(QMouseEvent * event)
   _parent->viewport()->update(r);
 
   _magnifier->setPosition(event->pos());
+  // Render the magnified tiles the magnifier is heading for in the background
+  _magnifier->prefetchTiles(event->pos() - _lastPos);
+  _lastPos = event->pos();
 }
 
 void MagnifyingGlass::mouseReleaseEvent(QMouseEvent * event)
@@ -119,6 +119,8 @@ protected:
 
   PDFDocumentMagnifierView * _magnifier;
   bool _started;
+  // Last mouse position (used to determine the direction of motion)
+  QPoint _lastPos;
 };
 
 class MarqueeZoom : public AbstractTool
@@ -51,6 +51,31 @@ static bool isPageItem(const QGraphicsItem *item) { return ( item->type() == PDF
 QTranslator * PDFDocumentView::_translator = nullptr;
 QString PDFDocumentView::_translatorLanguage;
 
+// Time (in ms) the zoom level must be stable before a zoom gesture is
+// considered finished (see PDFDocumentView::zoomByGesture())
+static const int ZOOM_GESTURE_SETTLE_TIME = 200;
+// Time (in ms) after which changedDocumentDeferred() is emitted even if the
+// first pixel is not shown, yet
+static const int DEFERRED_DOCUMENT_CHANGE_DELAY = 1000;
+// Time (in ms) of scrolling at the current velocity the scroll prefetcher
+// looks ahead (see PDFScrollPrefetcher)
+static const int SCROLL_PREFETCH_HORIZON = 500;
+// Upper bound of the look-ahead (in multiples of the viewport size)
+static const qreal SCROLL_PREFETCH_MAX_VIEWPORTS = 2;
+// Minimum time (in ms) between two prefetch passes while scrolling
+static const int SCROLL_PREFETCH_INTERVAL = 50;
+// Scroll steps further apart (in ms) are considered separate movements (i.e.,
+// the velocity starts over)
+static const int SCROLL_IDLE_TIME = 300;
+// Time (in ms) replaceScene() waits for the tiles of the new scene at most
+static const int SCENE_REPLACE_TIMEOUT = 1000;
+// Number of pages before and after the visible ones whose content bounding
+// boxes zoomFitContentWidth() precomputes
+static const int CONTENT_BOX_PREFETCH_PAGES = 3;
+// Number of viewport heights above and below the visible thumbnails that
+// PDFThumbnailsInfoWidget requests as well
+static const int THUMBNAIL_PREFETCH_VIEWPORTS = 1;
+
 // This class descends from `QGraphicsView` and is responsible for controlling
 // and displaying the contents of a `Document` using a `QGraphicsScene`.
 PDFDocumentView::PDFDocumentView(QWidget *parent /* = nullptr */):
@@ -60,10 +85,15 @@ PDFDocumentView::PDFDocumentView(QWidget *parent /* = nullptr */):
   _currentPage(-1),
   _lastPage(-1),
   _currentSearchResult(-1),
-  _useGrayScale(false),
+  _searchFlags(Backend::Search_CaseInsensitive),
   _pageMode(PageMode_OneColumnContinuous),
   _mouseMode(MouseMode_Move),
-  _armedTool(nullptr)
+  _armedTool(nullptr),
+  _zoomGestureActive(false),
+  _zoomGestureBaseScale(1.0),
+  _renderStatisticsOverlayVisible(false),
+  _deferredDocumentChangePending(false),
+  _scrollPrefetcher(this)
 {
   initResources();
   // FIXME: Allow to initialize with a specific language (in case the
@@ -107,10 +137,41 @@ PDFDocumentView::PDFDocumentView(QWidget *parent /* = nullptr */):
   
   connect(&_searchResultWatcher, SIGNAL(resultReadyAt(int)), this, SLOT(searchResultReady(int)));
   connect(&_searchResultWatcher, SIGNAL(progressValueChanged(int)), this, SLOT(searchProgressValueChanged(int)));
+  _searchHighlightTimer.setSingleShot(true);
+  _searchHighlightTimer.setInterval(0);
+  connect(&_searchHighlightTimer, SIGNAL(timeout()), this, SLOT(updateSearchResultHighlights()));
+
+  _transitionFrameTimer.setSingleShot(true);
+  _transitionFrameTimer.setTimerType(Qt::PreciseTimer);
+  connect(&_transitionFrameTimer, SIGNAL(timeout()), viewport(), SLOT(update()));
+
+  _zoomGestureTimer.setSingleShot(true);
+  _zoomGestureTimer.setInterval(ZOOM_GESTURE_SETTLE_TIME);
+  connect(&_zoomGestureTimer, SIGNAL(timeout()), this, SLOT(endZoomGesture()));
+  viewport()->grabGesture(Qt::PinchGesture);
+
+  _renderStatisticsTimer.setInterval(500);
+  connect(&_renderStatisticsTimer, SIGNAL(timeout()), viewport(), SLOT(update()));
+
+  _sceneReplaceTimer.setSingleShot(true);
+  _sceneReplaceTimer.setInterval(SCENE_REPLACE_TIMEOUT);
+  connect(&_sceneReplaceTimer, SIGNAL(timeout()), this, SLOT(finishReplaceScene()));
+
+  _deferredDocumentChangeTimer.setSingleShot(true);
+  _deferredDocumentChangeTimer.setInterval(DEFERRED_DOCUMENT_CHANGE_DELAY);
+  connect(&_deferredDocumentChangeTimer, SIGNAL(timeout()), this, SLOT(finishDeferredDocumentChange()));
+  connect(this, SIGNAL(changedDocument(const QWeakPointer<QtPDF::Backend::Document>)), this, SLOT(startDeferredDocumentChange()));
 }
 
 PDFDocumentView::~PDFDocumentView()
 {
+  // Make sure no pending presentation renders post events to us after we are
+  // gone
+  clearPresentationSlides();
+  QSharedPointer<Backend::Document> doc(_pdf_scene ? _pdf_scene->document().toStrongRef() : QSharedPointer<Backend::Document>());
+  if (doc)
+    doc->processingThread().cancelRequestsAndWait(this);
+  _searchAbortToken.abort();
   if (!_searchResultWatcher.isFinished())
     _searchResultWatcher.cancel();
 }
@@ -118,11 +179,42 @@ PDFDocumentView::~PDFDocumentView()
 // Accessors
 // ---------
 void PDFDocumentView::setScene(QSharedPointer<PDFDocumentScene> a_scene)
+{
+  // A scene that is still being prepared (see replaceScene()) is superseded
+  _pendingScene.clear();
+  _sceneReplaceTimer.stop();
+
+  attachScene(a_scene);
+
+  // ensure the zoom is reset if we load a new document
+  zoom100();
+  
+  // Ensure we're at the top left corner (we need to set _currentPage to -1 to
+  // ensure goToPage() actually does anything.
+  int page = _currentPage;
+  if (page >= 0) {
+    _currentPage = -1;
+    goToPage(page);
+  }
+
+  // Ensure proper layout
+  setPageMode(_pageMode, true);
+
+  if (_pdf_scene)
+    emit changedDocument(_pdf_scene->document());
+  else
+    emit changedDocument(QSharedPointer<Backend::Document>());
+}
+
+void PDFDocumentView::attachScene(QSharedPointer<PDFDocumentScene> a_scene)
 {
   // FIXME: Make setScene(QGraphicsScene*) (from parent class) invisible to the
   // outside world
   Super::setScene(a_scene.data());
 
+  // Pre-rendered slides (and pending renders) belong to the old document
+  clearPresentationSlides();
+
   // disconnect us from the old scene (if any)
   if (_pdf_scene) {
     disconnect(_pdf_scene.data(), nullptr, this, nullptr);
@@ -145,31 +237,102 @@ void PDFDocumentView::setScene(QSharedPointer<PDFDocumentScene> a_scene)
     connect(_pdf_scene.data(), SIGNAL(pageChangeRequested(int)), this, SLOT(goToPage(int)));
     connect(_pdf_scene.data(), SIGNAL(pdfActionTriggered(const QtPDF::PDFAction*)), this, SLOT(pdfActionTriggered(const QtPDF::PDFAction*)));
     connect(_pdf_scene.data(), SIGNAL(documentChanged(const QWeakPointer<QtPDF::Backend::Document>)), this, SLOT(reinitializeFromScene()));
+    connect(_pdf_scene.data(), SIGNAL(firstPixelAvailable(qint64)), this, SLOT(finishDeferredDocumentChange()));
     // The connection PDFDocumentScene::documentChanged > PDFDocumentView::changedDocument
     // must be last in this list to ensure all internal states are updated (e.g.
     // in _lastPage in reinitializeFromScene()) before the signal is
     // communicated on to the "outside world".
     connect(_pdf_scene.data(), SIGNAL(documentChanged(const QWeakPointer<QtPDF::Backend::Document>)), this, SIGNAL(changedDocument(const QWeakPointer<QtPDF::Backend::Document>)));
   }
-  
-  // ensure the zoom is reset if we load a new document
-  zoom100();
-  
-  // Ensure we're at the top left corner (we need to set _currentPage to -1 to
-  // ensure goToPage() actually does anything.
-  int page = _currentPage;
-  if (page >= 0) {
-    _currentPage = -1;
-    goToPage(page);
+}
+
+void PDFDocumentView::replaceScene(QSharedPointer<PDFDocumentScene> a_scene)
+{
+  // Drop any scene that is still being prepared (destroying it cancels its
+  // pending renders)
+  if (_pendingScene)
+    disconnect(_pendingScene.data(), nullptr, this, nullptr);
+  _pendingScene.clear();
+  _sceneReplaceTimer.stop();
+
+  // If there is nothing that could be kept (or nothing to render in the new
+  // scene), there is no point in waiting
+  QSharedPointer<Backend::Document> newDoc(a_scene ? a_scene->document().toStrongRef() : QSharedPointer<Backend::Document>());
+  QGraphicsItem * oldPage = (_pdf_scene ? _pdf_scene->pageAt(_currentPage) : nullptr);
+  if (!oldPage || !newDoc || !newDoc->isValid() || newDoc->isLocked() || a_scene->lastPage() <= 0 || _pageMode == PageMode_Presentation) {
+    setScene(a_scene);
+    return;
   }
 
-  // Ensure proper layout
-  setPageMode(_pageMode, true);
+  _pendingScene = a_scene;
 
-  if (_pdf_scene)
-    emit changedDocument(_pdf_scene->document());
+  // Lay out the new scene like the current one. Pages whose size is not known,
+  // yet, are assumed to be unchanged, but the ones that are currently visible
+  // are measured so they end up in the right place.
+  a_scene->adoptPageSizes(*_pdf_scene);
+  QRectF visibleRect(mapToScene(viewport()->rect()).boundingRect());
+  int first = _currentPage, last = _currentPage;
+  foreach (QGraphicsItem * item, _pdf_scene->items(visibleRect)) {
+    if (!item || !isPageItem(item) || !item->isVisible())
+      continue;
+    const int idx = _pdf_scene->pageNumFor(static_cast<PDFPageGraphicsItem*>(item));
+    first = qMin(first, idx);
+    last = qMax(last, idx);
+  }
+  a_scene->measurePageRange(first, last);
+  switch (_pageMode) {
+    case PageMode_SinglePage:
+    case PageMode_Presentation:
+      a_scene->showOnePage(qMin(_currentPage, a_scene->lastPage() - 1));
+      a_scene->pageLayout().setContinuous(false);
+      break;
+    case PageMode_OneColumnContinuous:
+      a_scene->pageLayout().setColumnCount(1, 0);
+      break;
+    case PageMode_TwoColumnContinuous:
+      a_scene->pageLayout().setColumnCount(2, 1);
+      break;
+  }
+  a_scene->pageLayout().relayout();
+
+  // Render what will be visible after the swap (see finishReplaceScene())
+  QGraphicsItem * newPage = a_scene->pageAt(qMin(_currentPage, a_scene->lastPage() - 1));
+  if (newPage)
+    visibleRect.translate(newPage->pos() - oldPage->pos());
+  connect(a_scene.data(), SIGNAL(prerenderingFinished()), this, SLOT(finishReplaceScene()));
+  if (a_scene->prerender(visibleRect, transform().m11(), _pageColorFilter) == 0)
+    finishReplaceScene();
   else
-    emit changedDocument(QSharedPointer<Backend::Document>());
+    _sceneReplaceTimer.start();
+}
+
+void PDFDocumentView::finishReplaceScene()
+{
+  if (!_pendingScene)
+    return;
+  _sceneReplaceTimer.stop();
+  QSharedPointer<PDFDocumentScene> a_scene(_pendingScene);
+  _pendingScene.clear();
+  disconnect(a_scene.data(), nullptr, this, nullptr);
+
+  // Remember the point of the current page that is shown in the center of the
+  // view
+  QGraphicsItem * oldPage = (_pdf_scene ? _pdf_scene->pageAt(_currentPage) : nullptr);
+  if (!oldPage) {
+    setScene(a_scene);
+    return;
+  }
+  const QPointF anchor(oldPage->mapFromScene(mapToScene(viewport()->rect().center())));
+
+  // NB: Unlike setScene(), this keeps the zoom level (i.e., the view's
+  // transform) and the current page (reinitializeFromScene() only clamps it)
+  attachScene(a_scene);
+  setPageMode(_pageMode, true);
+  QGraphicsItem * newPage = _pdf_scene->pageAt(_currentPage);
+  if (newPage)
+    centerOn(newPage->mapToScene(anchor));
+
+  emit changedDocument(_pdf_scene->document());
 }
 int PDFDocumentView::currentPage() { return _currentPage; }
 int PDFDocumentView::lastPage()    { return _lastPage; }
@@ -228,8 +391,11 @@ void PDFDocumentView::setPageMode(const PageMode pageMode, const bool forceRelay
   // current palette and background role)
   if (pageMode == PageMode_Presentation)
     setBackgroundBrush(QBrush(Qt::black));
-  else
+  else {
     setBackgroundBrush(Qt::NoBrush);
+    // The pre-rendered slides are no longer needed
+    clearPresentationSlides();
+  }
   
   _pageMode = pageMode;
   _pdf_scene->pageLayout().relayout();
@@ -275,6 +441,29 @@ QDockWidget * PDFDocumentView::dockWidget(const Dock type, QWidget * parent /* =
       infoWidget = new PDFAnnotationsInfoWidget(dock);
       // TODO: possibility to jump to selected/activated annotation
       break;
+    case Dock_Thumbnails:
+    {
+      PDFThumbnailsInfoWidget * thumbnailsWidget = new PDFThumbnailsInfoWidget(dock);
+      connect(thumbnailsWidget, SIGNAL(pageActivated(int)), this, SLOT(goToPage(int)));
+      connect(this, SIGNAL(changedPage(int)), thumbnailsWidget, SLOT(setCurrentPage(int)));
+      infoWidget = thumbnailsWidget;
+      break;
+    }
+    case Dock_SearchResults:
+    {
+      PDFSearchResultsInfoWidget * searchResultsWidget = new PDFSearchResultsInfoWidget(dock);
+      // Pick up the search that is currently shown (if any)
+      searchResultsWidget->addSearchResults(_searchResults);
+      searchResultsWidget->setCurrentSearchResult(_currentSearchResult);
+      connect(this, SIGNAL(searchResultsAdded(const QList<QtPDF::Backend::SearchResult> &)), searchResultsWidget, SLOT(addSearchResults(const QList<QtPDF::Backend::SearchResult> &)));
+      connect(this, SIGNAL(searchResultsCleared()), searchResultsWidget, SLOT(clear()));
+      connect(this, SIGNAL(currentSearchResultChanged(const int)), searchResultsWidget, SLOT(setCurrentSearchResult(const int)));
+      connect(searchResultsWidget, SIGNAL(searchResultActivated(int)), this, SLOT(goToSearchResult(int)));
+      connect(dock, SIGNAL(visibilityChanged(bool)), this, SLOT(searchResultsDockVisibilityChanged(bool)));
+      _searchResultsDocks << dock;
+      infoWidget = searchResultsWidget;
+      break;
+    }
     default:
       infoWidget = nullptr;
       break;
@@ -285,7 +474,8 @@ QDockWidget * PDFDocumentView::dockWidget(const Dock type, QWidget * parent /* =
   }
   if (_pdf_scene && _pdf_scene->document())
       infoWidget->initFromDocument(_pdf_scene->document());
-  connect(this, SIGNAL(changedDocument(const QWeakPointer<QtPDF::Backend::Document>)), infoWidget, SLOT(initFromDocument(const QWeakPointer<QtPDF::Backend::Document>)));
+  // Don't let the docks compete with showing the (new) document
+  connect(this, SIGNAL(changedDocumentDeferred(const QWeakPointer<QtPDF::Backend::Document>)), infoWidget, SLOT(initFromDocument(const QWeakPointer<QtPDF::Backend::Document>)));
 
   dock->setWindowTitle(infoWidget->windowTitle());
   dock->setObjectName(infoWidget->objectName() + QString::fromLatin1(".DockWidget"));
@@ -307,6 +497,17 @@ QDockWidget * PDFDocumentView::dockWidget(const Dock type, QWidget * parent /* =
 
 // path in PDF coordinates
 QGraphicsPathItem * PDFDocumentView::addHighlightPath(const unsigned int page, const QPainterPath & path, const QBrush & brush, const QPen & pen /* = Qt::NoPen */)
+{
+  // A highlight (e.g., of a SyncTeX jump) added while a new version of the
+  // document is being prepared (see replaceScene()) belongs to that version;
+  // as it is supposed to be seen right away, don't wait for the prerendering.
+  // Otherwise, it would be destroyed along with the old scene.
+  if (_pendingScene)
+    finishReplaceScene();
+  return createHighlightPath(page, path, brush, pen);
+}
+
+QGraphicsPathItem * PDFDocumentView::createHighlightPath(const unsigned int page, const QPainterPath & path, const QBrush & brush, const QPen & pen)
 {
   if (!_pdf_scene)
     return nullptr;
@@ -605,10 +806,64 @@ void PDFDocumentView::zoomBy(const qreal zoomFactor, const QGraphicsView::Viewpo
   setTransformationAnchor(anchor);
   this->scale(zoomFactor, zoomFactor);
   setTransformationAnchor(oldAnchor);
+  // Prefetched tiles have the wrong resolution now
+  _scrollPrefetcher.cancel();
 
   emit changedZoom(_zoomLevel);
 }
 
+void PDFDocumentView::zoomByGesture(const qreal zoomFactor, const QGraphicsView::ViewportAnchor anchor)
+{
+  if (zoomFactor <= 0)
+    return;
+
+  if (!_zoomGestureActive) {
+    _zoomGestureActive = true;
+    _zoomGestureBaseScale = transform().m11();
+    // Tiles that are still pending would only be superseded by the new
+    // resolution before long
+    // NB: Don't cancel other requests (e.g., for loading links) of the pages
+    QSharedPointer<Backend::Document> doc(_pdf_scene ? _pdf_scene->document().toStrongRef() : QSharedPointer<Backend::Document>());
+    if (doc) {
+      QSet<const QObject*> pageItems;
+      foreach (QGraphicsItem * item, _pdf_scene->pages()) {
+        if (item && isPageItem(item))
+          pageItems << static_cast<PDFPageGraphicsItem*>(item);
+      }
+      doc->processingThread().cancelRequests(pageItems, Backend::PageProcessingRequest::PageRendering);
+    }
+  }
+  _zoomGestureTimer.start();
+  zoomBy(zoomFactor, anchor);
+}
+
+void PDFDocumentView::startDeferredDocumentChange()
+{
+  _deferredDocumentChangePending = true;
+  // If there is nothing to wait for, don't wait (e.g., so the docks are
+  // cleared right away if the document is closed)
+  if (!_pdf_scene || _pdf_scene->timeToFirstPixel() >= 0 || _pdf_scene->document().isNull())
+    finishDeferredDocumentChange();
+  else
+    _deferredDocumentChangeTimer.start();
+}
+
+void PDFDocumentView::finishDeferredDocumentChange()
+{
+  if (!_deferredDocumentChangePending)
+    return;
+  _deferredDocumentChangePending = false;
+  _deferredDocumentChangeTimer.stop();
+  emit changedDocumentDeferred(document());
+}
+
+void PDFDocumentView::endZoomGesture()
+{
+  _zoomGestureActive = false;
+  // Repaint to request the tiles at the final resolution
+  viewport()->update();
+}
+
 void PDFDocumentView::setZoomLevel(const qreal zoomLevel, const QGraphicsView::ViewportAnchor anchor /* = QGraphicsView::AnchorViewCenter */)
 {
   if (zoomLevel <= 0)
@@ -694,6 +949,40 @@ void PDFDocumentView::zoomFitContentWidth()
     return;
 
   QRectF rect(page->getContentBoundingBox());
+
+  // Chances are the user will want to fit the pages nearby as well; the
+  // bounding boxes are cached, so compute them in the background now to make
+  // that instantaneous. Only do this for the visible pages and a few around
+  // them, though; creating the page objects of all pages would be expensive
+  // and evict the visible ones (see Document::setMaxResidentPages()). Use low
+  // priority so this doesn't delay rendering the visible tiles.
+  // NB: The processing thread works on a stack, so the pages closest to the
+  // current one are queued last to be processed first.
+  QSharedPointer<Backend::Document> doc(_pdf_scene->document().toStrongRef());
+  if (doc) {
+    int first = _currentPage, last = _currentPage;
+    foreach (QGraphicsItem * item, _pdf_scene->pages(mapToScene(viewport()->rect()))) {
+      if (!item || !isPageItem(item))
+        continue;
+      const int n = _pdf_scene->pageNumFor(static_cast<PDFPageGraphicsItem*>(item));
+      if (n < 0)
+        continue;
+      first = qMin(first, n);
+      last = qMax(last, n);
+    }
+    first = qMax(0, first - CONTENT_BOX_PREFETCH_PAGES);
+    last = qMin(doc->numPages() - 1, last + CONTENT_BOX_PREFETCH_PAGES);
+    for (int dist = qMax(_currentPage - first, last - _currentPage); dist > 0; --dist) {
+      foreach (int i, QList<int>() << _currentPage + dist << _currentPage - dist) {
+        if (i < first || i > last)
+          continue;
+        QSharedPointer<Backend::Page> p(doc->page(i).toStrongRef());
+        if (p)
+          p->asyncContentBoundingBox(nullptr, false, Backend::PDFPageProcessingThread::LowPriority);
+      }
+    }
+  }
+
   rect = currentPage->mapRectToScene(QRectF(currentPage->mapFromPage(rect.topLeft()), currentPage->mapFromPage(rect.bottomRight())));
 
   // Store current y position so we can center on it later.
@@ -788,8 +1077,23 @@ void PDFDocumentView::setMagnifierSize(const int size)
     magnifier->setMagnifierSize(size);
 }
 
+void PDFDocumentView::setPageColorFilter(const Backend::PDFPageColorFilter & filter)
+{
+  if (_pageColorFilter == filter)
+    return;
+  _pageColorFilter = filter;
+  // Filtered tiles are cached separately, so we merely need to repaint (which
+  // requests the tiles with the new filter)
+  viewport()->update();
+}
+
 void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* = Backend::Search_CaseInsensitive */)
 {
+  // Search the new version of the document if one is being prepared (see
+  // replaceScene()); the results for the old one would be discarded when the
+  // scenes are swapped
+  if (_pendingScene)
+    finishReplaceScene();
   if ( not _pdf_scene )
     return;
 
@@ -811,6 +1115,23 @@ void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* =
   
   clearSearchResults();
 
+  // If another search is still running, abort it---after all, the user wants
+  // to perform a new search.
+  // NB: We don't wait for the old search to finish. The page currently being
+  // searched notices the aborted token and returns quickly, remaining requests
+  // of the old search bail out immediately, and setFuture() below disconnects
+  // the watcher from the old future so no stale results reach us.
+  _searchAbortToken.abort();
+  if (!_searchResultWatcher.isFinished())
+    _searchResultWatcher.cancel();
+  _searchAbortToken = Backend::AbortToken::create();
+
+  // Extracting the context of the results is not free, so only do it if the
+  // results are listed somewhere
+  _searchFlags = flags & ~Backend::SearchFlags(Backend::Search_WithContext);
+  if (isSearchResultsDockVisible())
+    _searchFlags |= Backend::Search_WithContext;
+
   // Construct a list of requests that can be passed to QtConcurrent::mapped()
   QList<Backend::SearchRequest> requests;
   int i;
@@ -819,7 +1140,8 @@ void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* =
     request.doc = _pdf_scene->document();
     request.pageNum = i;
     request.searchString = searchText;
-    request.flags = flags;
+    request.flags = _searchFlags;
+    request.abortToken = _searchAbortToken;
     requests << request;
   }
   for (i = 0; i < _currentPage; ++i) {
@@ -827,16 +1149,10 @@ void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* =
     request.doc = _pdf_scene->document();
     request.pageNum = i;
     request.searchString = searchText;
-    request.flags = flags;
+    request.flags = _searchFlags;
+    request.abortToken = _searchAbortToken;
     requests << request;
   }
-  
-  // If another search is still running, cancel it---after all, the user wants
-  // to perform a new search
-  if (!_searchResultWatcher.isFinished()) {
-    _searchResultWatcher.cancel();
-    _searchResultWatcher.waitForFinished();
-  }
 
   _currentSearchResult = -1;
   _searchString = searchText;
@@ -849,32 +1165,10 @@ void PDFDocumentView::nextSearchResult()
     return;
 
   // Note: _currentSearchResult is initially -1 if no result is selected
-  if (_currentSearchResult >= 0 && _searchResults[_currentSearchResult])
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult])->setBrush(_searchResultHighlightBrush);
-
   if ( (_currentSearchResult + 1) >= _searchResults.size() )
-    _currentSearchResult = 0;
+    goToSearchResult(0);
   else
-    ++_currentSearchResult;
-
-  // FIXME: The rest of the code in this method is the same as in previousSearchResult()
-  // We should move this into its own private method
-
-  QGraphicsPathItem* highlightPath = dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult]);
-
-  if (!highlightPath)
-    return;
-
-  highlightPath->setBrush(_currentSearchResultHighlightBrush);
-  centerOn(highlightPath);
-
-  PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem *>(highlightPath->parentItem());
-  if (pageItem) {
-    QSharedPointer<Backend::Page> page = pageItem->page().toStrongRef();
-    // FIXME: shape subpath coordinates seem to be in upside down pdf coordinates. We should find a better place to construct the proper transform (e.g., in PDFPageGraphicsItem)
-    if (page)
-      emit searchResultHighlighted(pageItem->pageNum(), highlightPath->shape().toSubpathPolygons(QTransform::fromTranslate(0, page->pageSizeF().height()).scale(1, -1)));
-  }
+    goToSearchResult(_currentSearchResult + 1);
 }
 
 void PDFDocumentView::previousSearchResult()
@@ -882,18 +1176,27 @@ void PDFDocumentView::previousSearchResult()
   if ( not _pdf_scene || _searchResults.empty() )
     return;
 
-  if (_currentSearchResult >= 0 && _searchResults[_currentSearchResult])
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult])->setBrush(_searchResultHighlightBrush);
-
   if ( (_currentSearchResult - 1) < 0 )
-    _currentSearchResult = _searchResults.size() - 1;
+    goToSearchResult(_searchResults.size() - 1);
   else
-    --_currentSearchResult;
+    goToSearchResult(_currentSearchResult - 1);
+}
+
+void PDFDocumentView::goToSearchResult(const int index)
+{
+  // NB: While a new scene is being prepared (see replaceScene()), the results
+  // belong to the old one and are discarded when the scenes are swapped
+  if ( not _pdf_scene || _pendingScene || index < 0 || index >= _searchResults.size() )
+    return;
 
-  // FIXME: The rest of the code in this method is the same as in previousSearchResult()
-  // We should move this into its own private method
+  QGraphicsPathItem * oldHighlightPath = _searchResultItems.value(_currentSearchResult, nullptr);
+  if (oldHighlightPath)
+    oldHighlightPath->setBrush(_searchResultHighlightBrush);
 
-  QGraphicsPathItem* highlightPath = dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult]);
+  _currentSearchResult = index;
+  emit currentSearchResultChanged(index);
+
+  QGraphicsPathItem* highlightPath = searchResultItem(index);
 
   if (!highlightPath)
     return;
@@ -915,27 +1218,99 @@ void PDFDocumentView::clearSearchResults()
   if ( not _pdf_scene || _searchResults.empty() )
     return;
 
-  foreach( QGraphicsItem *item, _searchResults )
-    _pdf_scene->removeItem(item);
-
+  // NB: The highlights are children of the page items, so deleting them also
+  // removes them from the scene
+  qDeleteAll(_searchResultItems);
+  _searchResultItems.clear();
   _searchResults.clear();
+  _searchResultsByPage.clear();
+  _currentSearchResult = -1;
+  _searchHighlightTimer.stop();
+  emit searchResultsCleared();
+}
+
+bool PDFDocumentView::isSearchResultsDockVisible() const
+{
+  foreach (const QPointer<QDockWidget> & dock, _searchResultsDocks) {
+    if (dock && dock->isVisible())
+      return true;
+  }
+  return false;
+}
+
+void PDFDocumentView::searchResultsDockVisibilityChanged(bool visible)
+{
+  if (!visible || _searchString.isEmpty() || _searchFlags.testFlag(Backend::Search_WithContext))
+    return;
+  // NB: search() merely moves on to the next result if the search string is
+  // unchanged
+  const QString searchString(_searchString);
+  clearSearchResults();
+  _searchString.clear();
+  search(searchString, _searchFlags);
+}
+
+QGraphicsPathItem * PDFDocumentView::searchResultItem(const int index)
+{
+  if (index < 0 || index >= _searchResults.size())
+    return nullptr;
+  QGraphicsPathItem * item = _searchResultItems.value(index, nullptr);
+  if (item)
+    return item;
+
+  // NB: Don't use addHighlightPath(), which could swap the scenes (and thus
+  // discard the search results) under our feet
+  const Backend::SearchResult & result = _searchResults[index];
+  item = createHighlightPath(result.pageNum, result.bbox, (index == _currentSearchResult ? _currentSearchResultHighlightBrush : _searchResultHighlightBrush));
+  if (item)
+    _searchResultItems.insert(index, item);
+  return item;
+}
+
+void PDFDocumentView::updateSearchResultHighlights()
+{
+  // See goToSearchResult()
+  if (!_pdf_scene || _pendingScene || _searchResults.empty())
+    return;
+
+  QSet<int> visiblePages;
+  foreach (QGraphicsItem * item, _pdf_scene->pages(mapToScene(viewport()->rect())))
+    visiblePages << _pdf_scene->pageNumFor(dynamic_cast<PDFPageGraphicsItem *>(item));
+
+  // Remove highlights that can't be seen anymore (except for the current
+  // result, whose brush is special)
+  QMutableHashIterator<int, QGraphicsPathItem *> it(_searchResultItems);
+  while (it.hasNext()) {
+    it.next();
+    if (it.key() == _currentSearchResult || visiblePages.contains(_searchResults[it.key()].pageNum))
+      continue;
+    delete it.value();
+    it.remove();
+  }
+
+  foreach (int pageNum, visiblePages) {
+    foreach (int index, _searchResultsByPage.value(pageNum))
+      searchResultItem(index);
+  }
 }
 
 void PDFDocumentView::setSearchResultHighlightBrush(const QBrush & brush)
 {
   _searchResultHighlightBrush = brush;
-  for (int i = 0; i < _searchResults.size(); ++i) {
-    if (i == _currentSearchResult || !_searchResults[i])
-      continue;
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[i])->setBrush(brush);
+  QHashIterator<int, QGraphicsPathItem *> it(_searchResultItems);
+  while (it.hasNext()) {
+    it.next();
+    if (it.key() != _currentSearchResult)
+      it.value()->setBrush(brush);
   }
 }
 
 void PDFDocumentView::setCurrentSearchResultHighlightBrush(const QBrush & brush)
 {
   _currentSearchResultHighlightBrush = brush;
-  if (_currentSearchResult >= 0 && _currentSearchResult < _searchResults.size() && _searchResults[_currentSearchResult])
-    dynamic_cast<QGraphicsPathItem*>(_searchResults[_currentSearchResult])->setBrush(brush);
+  QGraphicsPathItem * item = _searchResultItems.value(_currentSearchResult, nullptr);
+  if (item)
+    item->setBrush(brush);
 }
 
 
@@ -943,10 +1318,17 @@ void PDFDocumentView::setCurrentSearchResultHighlightBrush(const QBrush & brush)
 // --------------
 void PDFDocumentView::searchResultReady(int index)
 {
-  // Convert the search result to highlight boxes
-  foreach( Backend::SearchResult result, _searchResultWatcher.future().resultAt(index) )
-    _searchResults << addHighlightPath(result.pageNum, result.bbox, _searchResultHighlightBrush);
-  
+  // Highlights are created lazily (see updateSearchResultHighlights())
+  const QList<Backend::SearchResult> results(_searchResultWatcher.future().resultAt(index));
+  foreach( Backend::SearchResult result, results ) {
+    _searchResultsByPage[result.pageNum] << _searchResults.size();
+    _searchResults << result;
+  }
+  if (!results.isEmpty()) {
+    emit searchResultsAdded(results);
+    _searchHighlightTimer.start();
+  }
+
   // If this is the first result that becomes available in a new search, center
   // on the first result
   if (_currentSearchResult == -1)
@@ -1081,11 +1463,13 @@ void PDFDocumentView::goToPage(const PDFPageGraphicsItem * page, const int align
     
     if (backendPage && backendPage->transition()) {
       backendPage->transition()->reset();
-      // Setting listener = nullptr in calls to getTileImage to force synchronous
-      // rendering
+      // The slides are usually pre-rendered (otherwise, presentationSlide()
+      // renders them synchronously). Get the old one first so the cache ends
+      // up prefetching around the new slide.
       if (oldPage) {
-        QSharedPointer<Backend::Page> oldBackendPage(oldPage->page().toStrongRef());
-        backendPage->transition()->start(*(oldBackendPage->getTileImage(nullptr, oldXres, oldYres)), *(backendPage->getTileImage(nullptr, xres, yres)));
+        QImage oldImg(presentationSlide(oldPage->pageNum(), oldXres, oldYres));
+        QImage newImg(presentationSlide(pageNum, xres, yres));
+        backendPage->transition()->start(oldImg, newImg);
       }
     }
   }
@@ -1280,6 +1664,8 @@ void PDFDocumentView::switchInterfaceLocale(const QLocale & newLocale)
 
 void PDFDocumentView::reinitializeFromScene()
 {
+  // Pending prefetches may belong to a document that is no longer shown
+  _scrollPrefetcher.cancel();
   if (_pdf_scene) {
     _lastPage = _pdf_scene->lastPage();
     if (_lastPage <= 0)
@@ -1295,6 +1681,8 @@ void PDFDocumentView::reinitializeFromScene()
     _lastPage = -1;
     _currentPage = -1;
   }
+  // Pre-rendered slides are outdated if the document changed
+  clearPresentationSlides();
   // Ensure the text selection marker is reset (if any) as it holds pointers to
   // page items (highlight path, boxes) that are now changed and/or destroyed.
   DocumentTool::Select * selectTool = dynamic_cast<DocumentTool::Select*>(getToolByType(DocumentTool::AbstractTool::Tool_Select));
@@ -1303,7 +1691,14 @@ void PDFDocumentView::reinitializeFromScene()
   // Ensure (old) search data is destroyed as well
   if (!_searchResultWatcher.isFinished())
     _searchResultWatcher.cancel();
-  _searchResults.clear();
+  // NB: The highlights were destroyed along with the page items
+  _searchResultItems.clear();
+  _searchResultsByPage.clear();
+  _searchHighlightTimer.stop();
+  if (!_searchResults.isEmpty()) {
+    _searchResults.clear();
+    emit searchResultsCleared();
+  }
   _currentSearchResult = -1;
   // Also reset _searchString. Otherwise the next search for the same string
   // will assume the search has already been run (without results as
@@ -1372,8 +1767,67 @@ void PDFDocumentView::paintEvent(QPaintEvent *event)
     }
   }
 
+  // Scrolling, zooming, etc. may have revealed pages with search results
+  if (!_searchResults.isEmpty() && !_searchHighlightTimer.isActive())
+    _searchHighlightTimer.start();
+
   if (_armedTool)
     _armedTool->paintEvent(event);
+
+  if (_renderStatisticsOverlayVisible)
+    paintRenderStatisticsOverlay();
+}
+
+void PDFDocumentView::setRenderStatisticsOverlayVisible(const bool visible)
+{
+  if (visible == _renderStatisticsOverlayVisible)
+    return;
+  _renderStatisticsOverlayVisible = visible;
+
+  if (visible) {
+    QSharedPointer<Backend::Document> doc(_pdf_scene ? _pdf_scene->document().toStrongRef() : QSharedPointer<Backend::Document>());
+    if (doc)
+      doc->processingThread().statistics().setEnabled(true);
+    _renderStatisticsTimer.start();
+  }
+  else
+    _renderStatisticsTimer.stop();
+  viewport()->update();
+}
+
+void PDFDocumentView::paintRenderStatisticsOverlay()
+{
+  QSharedPointer<Backend::Document> doc(_pdf_scene ? _pdf_scene->document().toStrongRef() : QSharedPointer<Backend::Document>());
+  if (!doc)
+    return;
+  // Documents are replaced on reload, so make sure the statistics of the
+  // current one are collected
+  doc->processingThread().statistics().setEnabled(true);
+
+  Backend::RenderStatistics::Snapshot stats = doc->renderStatistics();
+  QStringList lines;
+  lines << trUtf8("Backend: %1").arg(stats.backend);
+  lines << trUtf8("Queue wait: %1 ms (p95: %2 ms)").arg(stats.queueWait.mean(), 0, 'f', 1).arg(stats.queueWait.percentile(0.95));
+  lines << trUtf8("Render time: %1 ms (p95: %2 ms, max: %3 ms)").arg(stats.renderTime.mean(), 0, 'f', 1).arg(stats.renderTime.percentile(0.95)).arg(stats.renderTime.max(), 0, 'f', 0);
+  lines << trUtf8("Tiles: %1 rendered, %2 aborted (%3/s)").arg(stats.counters[Backend::RenderStatistics::TilesRendered]).arg(stats.counters[Backend::RenderStatistics::RendersAborted]).arg(stats.tilesPerSecond(), 0, 'f', 1);
+  lines << trUtf8("Cache hit rate: %1%").arg(100 * stats.cacheHitRate(), 0, 'f', 1);
+  lines << trUtf8("Placeholders: %1 created, %2 shown").arg(stats.counters[Backend::RenderStatistics::PlaceholdersCreated]).arg(stats.counters[Backend::RenderStatistics::PlaceholderHits]);
+  lines << trUtf8("Prefetched tiles: %1").arg(stats.counters[Backend::RenderStatistics::TilesPrefetched]);
+  lines << trUtf8("Cached: %1 MiB").arg(stats.bytesCached / 1024. / 1024., 0, 'f', 1);
+  lines << trUtf8("Resident pages: %1").arg(stats.residentPages);
+  if (_pdf_scene && _pdf_scene->timeToFirstPixel() >= 0)
+    lines << trUtf8("Time to first pixel: %1 ms").arg(_pdf_scene->timeToFirstPixel());
+  QString text(lines.join(QString::fromLatin1("\n")));
+
+  QPainter painter(viewport());
+  QRect textRect(painter.fontMetrics().boundingRect(viewport()->rect(), Qt::AlignLeft | Qt::AlignTop, text));
+  textRect.translate(10, 10);
+
+  QColor background(Qt::black);
+  background.setAlphaF(0.6);
+  painter.fillRect(textRect.adjusted(-5, -5, 5, 5), background);
+  painter.setPen(Qt::white);
+  painter.drawText(textRect, Qt::AlignLeft | Qt::AlignTop, text);
 }
 
 void PDFDocumentView::keyPressEvent(QKeyEvent *event)
@@ -1517,10 +1971,10 @@ void PDFDocumentView::wheelEvent(QWheelEvent * event)
     // same for all mice. delta() returns the rotation in 1/8 degrees. Here, we
     // use a zoom factor of 1.5 every 15 degrees (= delta() == 120, which seems
     // to be a widespread default resolution).
-    // TODO: for high-resolution mice, this may trigger many small zooms,
-    // resulting in the rendering of many intermediate resolutions. This can
-    // cause a lagging display and can potentially fill the pdf cache.
-    zoomBy(pow(1.5, delta / 120.), QGraphicsView::AnchorUnderMouse);
+    // NB: Especially for high-resolution mice, this may trigger many small
+    // zooms; zoomByGesture() ensures we don't render all the intermediate
+    // resolutions.
+    zoomByGesture(pow(1.5, delta / 120.), QGraphicsView::AnchorUnderMouse);
     event->accept();
     return;
   }
@@ -1554,6 +2008,136 @@ void PDFDocumentView::wheelEvent(QWheelEvent * event)
   Super::wheelEvent(event);
 }
 
+void PDFDocumentView::scrollContentsBy(int dx, int dy)
+{
+  Super::scrollContentsBy(dx, dy);
+  _scrollPrefetcher.scrolled();
+}
+
+bool PDFDocumentView::viewportEvent(QEvent * event)
+{
+  if (event && event->type() == QEvent::Gesture) {
+    QGestureEvent * gestureEvent = static_cast<QGestureEvent*>(event);
+    QPinchGesture * pinch = static_cast<QPinchGesture*>(gestureEvent->gesture(Qt::PinchGesture));
+    if (pinch) {
+      // NB: scaleFactor() is the change relative to the previous event
+      if (pinch->changeFlags() & QPinchGesture::ScaleFactorChanged)
+        zoomByGesture(pinch->scaleFactor(), QGraphicsView::AnchorUnderMouse);
+      gestureEvent->accept(pinch);
+      return true;
+    }
+  }
+  return Super::viewportEvent(event);
+}
+
+bool PDFDocumentView::event(QEvent * event)
+{
+  // Look for background renders of presentation slides
+  if (event && event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+    event->accept();
+    const Backend::PDFPageRenderedEvent * renderedEvent = dynamic_cast<const Backend::PDFPageRenderedEvent*>(event);
+    QMap<int, PresentationSlide>::iterator it = _presentationSlides.find(renderedEvent->page_num);
+    // Discard results that are no longer needed (e.g., because the slide
+    // changed in the meantime)
+    if (it != _presentationSlides.end() && it->image.isNull() &&
+        qFuzzyCompare(it->xres, renderedEvent->xres) && qFuzzyCompare(it->yres, renderedEvent->yres)) {
+      if (renderedEvent->rendered_page.isNull())
+        _presentationSlides.erase(it);
+      else
+        it->image = renderedEvent->rendered_page;
+    }
+    return true;
+  }
+  return Super::event(event);
+}
+
+void PDFDocumentView::scheduleTransitionFrame()
+{
+  if (_transitionFrameTimer.isActive())
+    return;
+
+  // Paint one frame per display refresh (painting more often is pointless)
+  qreal refreshRate = 60;
+  QWindow * win = window()->windowHandle();
+  QScreen * screen = (win ? win->screen() : QGuiApplication::primaryScreen());
+  if (screen && screen->refreshRate() > 1)
+    refreshRate = screen->refreshRate();
+  _transitionFrameTimer.start(qMax(1, qRound(1000. / refreshRate)));
+}
+
+QImage PDFDocumentView::presentationSlide(const int pageNum, const double xres, const double yres)
+{
+  if (!_pdf_scene)
+    return QImage();
+
+  QImage retVal;
+  QMap<int, PresentationSlide>::iterator it = _presentationSlides.find(pageNum);
+  if (it != _presentationSlides.end() && !it->image.isNull() &&
+      qFuzzyCompare(it->xres, xres) && qFuzzyCompare(it->yres, yres))
+    retVal = it->image;
+  else {
+    QSharedPointer<Backend::Document> doc(_pdf_scene->document().toStrongRef());
+    QSharedPointer<Backend::Page> page(doc ? doc->page(pageNum).toStrongRef() : QSharedPointer<Backend::Page>());
+    if (page) {
+      retVal = page->renderToImage(xres, yres);
+      PresentationSlide slide;
+      slide.xres = xres;
+      slide.yres = yres;
+      slide.image = retVal;
+      // NB: This overwrites a pending background render for the same slide (if
+      // any); its result will be discarded in event()
+      _presentationSlides.insert(pageNum, slide);
+    }
+  }
+
+  prefetchPresentationSlides(pageNum, xres, yres);
+  return retVal;
+}
+
+void PDFDocumentView::prefetchPresentationSlides(const int pageNum, const double xres, const double yres)
+{
+  if (!_pdf_scene)
+    return;
+  QSharedPointer<Backend::Document> doc(_pdf_scene->document().toStrongRef());
+  if (!doc)
+    return;
+
+  // Drop slides we don't need anymore
+  QMap<int, PresentationSlide>::iterator it = _presentationSlides.begin();
+  while (it != _presentationSlides.end()) {
+    if (qAbs(it.key() - pageNum) > 1 || !qFuzzyCompare(it->xres, xres) || !qFuzzyCompare(it->yres, yres))
+      it = _presentationSlides.erase(it);
+    else
+      ++it;
+  }
+
+  // Render the adjacent slides in the background
+  // NB: The processing thread works on a stack, so the next slide (which is
+  // the most likely to be needed) is queued last
+  foreach (int i, QList<int>() << pageNum - 1 << pageNum + 1) {
+    if (i < 0 || i >= doc->numPages() || _presentationSlides.contains(i))
+      continue;
+    QSharedPointer<Backend::Page> page(doc->page(i).toStrongRef());
+    if (!page)
+      continue;
+    PresentationSlide slide;
+    slide.xres = xres;
+    slide.yres = yres;
+    _presentationSlides.insert(i, slide);
+    page->asyncRenderToImage(this, xres, yres);
+  }
+}
+
+void PDFDocumentView::clearPresentationSlides()
+{
+  _presentationSlides.clear();
+  if (!_pdf_scene)
+    return;
+  QSharedPointer<Backend::Document> doc(_pdf_scene->document().toStrongRef());
+  if (doc)
+    doc->processingThread().cancelRequests(this);
+}
+
 void PDFDocumentView::changeEvent(QEvent * event)
 {
   if (event && event->type() == QEvent::LanguageChange) {
@@ -1588,16 +2172,204 @@ void PDFDocumentView::disarmTool()
 }
 
 
-// PDFDocumentMagnifierView
-// ========================
-//
-PDFDocumentMagnifierView::PDFDocumentMagnifierView(PDFDocumentView *parent /* = nullptr */) :
-  Super(parent),
-  _parent_view(parent),
-  _zoomLevel(1.0),
-  _zoomFactor(2.0),
-  _shape(DocumentTool::MagnifyingGlass::Magnifier_Circle),
-  _size(300)
+// PDFScrollPrefetcher
+// ===================
+PDFScrollPrefetcher::PDFScrollPrefetcher(PDFDocumentView * view) :
+  _view(view)
+{
+  _prefetchTimer.setSingleShot(true);
+  _prefetchTimer.setInterval(SCROLL_PREFETCH_INTERVAL);
+  connect(&_prefetchTimer, SIGNAL(timeout()), this, SLOT(prefetch()));
+}
+
+PDFScrollPrefetcher::~PDFScrollPrefetcher()
+{
+  // Make sure no pending renders post events to us after we are gone
+  QSharedPointer<Backend::Document> doc(_document.toStrongRef());
+  if (doc)
+    doc->processingThread().cancelRequestsAndWait(this);
+  cancel();
+}
+
+void PDFScrollPrefetcher::scrolled()
+{
+  if (!_view || !_view->viewport())
+    return;
+
+  QPointF center(_view->mapToScene(_view->viewport()->rect().center()));
+  if (!_clock.isValid() || _clock.elapsed() > SCROLL_IDLE_TIME) {
+    // A new movement starts; we don't know its velocity, yet
+    _clock.start();
+    _lastCenter = center;
+    _velocity = QPointF();
+    return;
+  }
+
+  const qint64 elapsed = qMax(Q_INT64_C(1), _clock.restart());
+  QPointF velocity((center - _lastCenter) / elapsed);
+  _lastCenter = center;
+
+  // Whatever was prefetched in the old direction is no longer needed if the
+  // user turns around
+  if (QPointF::dotProduct(velocity, _velocity) < 0) {
+    cancel();
+    _clock.start();
+    _lastCenter = center;
+    _velocity = velocity;
+  }
+  else {
+    // Smooth the velocity as the intervals between scroll steps (e.g., of
+    // kinetic scrolling or of the mouse wheel) are irregular
+    _velocity = (_velocity + velocity) / 2;
+  }
+
+  if (!_prefetchTimer.isActive())
+    _prefetchTimer.start();
+}
+
+void PDFScrollPrefetcher::cancel()
+{
+  _prefetchTimer.stop();
+  _clock.invalidate();
+  _velocity = QPointF();
+  QSharedPointer<Backend::Document> doc(_document.toStrongRef());
+  if (doc)
+    doc->processingThread().cancelRequests(this);
+  _document.clear();
+}
+
+void PDFScrollPrefetcher::prefetch()
+{
+  if (!_view || !_view->viewport() || _view->pageMode() == PDFDocumentView::PageMode_Presentation || _view->isZoomGestureActive())
+    return;
+  PDFDocumentScene * pdfScene = qobject_cast<PDFDocumentScene*>(_view->scene());
+  QSharedPointer<Backend::Document> doc(pdfScene ? pdfScene->document().toStrongRef() : QSharedPointer<Backend::Document>());
+  if (!doc)
+    return;
+
+  // The distance the view will travel within the horizon, but not more than a
+  // few viewports (e.g., if the user drags the scroll bar)
+  QRectF visibleRect(_view->mapToScene(_view->viewport()->rect()).boundingRect());
+  const qreal maxX = SCROLL_PREFETCH_MAX_VIEWPORTS * visibleRect.width();
+  const qreal maxY = SCROLL_PREFETCH_MAX_VIEWPORTS * visibleRect.height();
+  QPointF offset(_velocity * SCROLL_PREFETCH_HORIZON);
+  offset = QPointF(qBound(-maxX, offset.x(), maxX), qBound(-maxY, offset.y(), maxY));
+  if (offset.manhattanLength() < 1)
+    return;
+
+  // Requests issued to a previous document are of no use anymore
+  if (_document != doc) {
+    cancel();
+    _document = doc;
+    // Keep the current velocity (cancel() resets it)
+    _clock.start();
+    _velocity = offset / SCROLL_PREFETCH_HORIZON;
+  }
+
+  // NB: Include the visible part, as tiles requested here earlier may have
+  // become visible in the meantime; these are needed first.
+  QRectF prefetchRect(visibleRect | visibleRect.translated(offset));
+  const QPointF center(visibleRect.center());
+  const Backend::PDFPageColorFilter colorFilter(_view->pageColorFilter());
+
+  struct Prefetch {
+    qreal distance;
+    QSharedPointer<Backend::Page> page;
+    double xres, yres;
+    QRect tile;
+    bool operator<(const Prefetch & other) const { return distance > other.distance; }
+  };
+  QList<Prefetch> prefetches;
+  // All tiles in the prefetch area; pending prefetches of other tiles are
+  // those the view has passed by in the meantime
+  QSet<Backend::PDFPageTile> tiles;
+
+  foreach (QGraphicsItem * item, pdfScene->items(prefetchRect)) {
+    if (!item || !isPageItem(item))
+      continue;
+    PDFPageGraphicsItem * pageItem = static_cast<PDFPageGraphicsItem*>(item);
+    QSharedPointer<Backend::Page> page(pageItem->page().toStrongRef());
+    if (!page)
+      continue;
+    // NB: Use the same scale factor PDFPageGraphicsItem::paint() will see so
+    // the tiles' keys match exactly
+    const qreal scaleFactor = pageItem->deviceTransform(_view->viewportTransform()).m11();
+    const double xres = pageItem->dpiX() * scaleFactor, yres = pageItem->dpiY() * scaleFactor;
+    QRectF rect(pageItem->mapRectFromScene(prefetchRect).intersected(pageItem->boundingRect()));
+    foreach (QRect tile, pageItem->tilesForRect(rect, scaleFactor)) {
+      const Backend::PDFPageTile key(xres, yres, tile, page->pageNum(), colorFilter);
+      tiles << key;
+      // Skip tiles that are available or pending already
+      Backend::PDFPageCache::TileStatus status = doc->pageCache().getStatus(key);
+      if (status == Backend::PDFPageCache::CURRENT || status == Backend::PDFPageCache::PLACEHOLDER)
+        continue;
+      Prefetch p;
+      QRectF tileRect(pageItem->mapRectToScene(QRectF(tile.x() / scaleFactor, tile.y() / scaleFactor, tile.width() / scaleFactor, tile.height() / scaleFactor)));
+      QPointF d(tileRect.center() - center);
+      p.distance = d.x() * d.x() + d.y() * d.y();
+      p.page = page;
+      p.xres = xres;
+      p.yres = yres;
+      p.tile = tile;
+      prefetches << p;
+    }
+  }
+
+  // Only drop the prefetches that are no longer needed (without waiting for
+  // the tile being rendered); the others stay queued. Tiles that were dropped
+  // are marked as outdated, so they are requested again by the page items if
+  // they are needed after all.
+  doc->processingThread().cancelRenderRequests(this, tiles);
+
+  // The processing thread works on a stack, so queue the tiles farthest away
+  // first
+  qSort(prefetches);
+  foreach (const Prefetch & p, prefetches) {
+    // NB: getTileImage() puts a placeholder into the cache, so the page items
+    // don't request the tile a second time if it becomes visible before it is
+    // finished
+    p.page->getTileImage(this, p.xres, p.yres, p.tile, colorFilter);
+    doc->processingThread().statistics().increment(Backend::RenderStatistics::TilesPrefetched);
+  }
+}
+
+bool PDFScrollPrefetcher::event(QEvent * event)
+{
+  if (event && event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+    event->accept();
+    const Backend::PDFPageRenderedEvent * renderedEvent = dynamic_cast<const Backend::PDFPageRenderedEvent*>(event);
+    PDFDocumentScene * pdfScene = (_view ? qobject_cast<PDFDocumentScene*>(_view->scene()) : nullptr);
+    QGraphicsItem * item = (pdfScene && renderedEvent ? pdfScene->pageAt(renderedEvent->page_num) : nullptr);
+    if (item && isPageItem(item)) {
+      PDFPageGraphicsItem * pageItem = static_cast<PDFPageGraphicsItem*>(item);
+      // Map the tile (given in pixels at the rendering resolution) back to
+      // item coordinates
+      qreal sx = (renderedEvent->xres > 0 ? pageItem->dpiX() / renderedEvent->xres : 0);
+      qreal sy = (renderedEvent->yres > 0 ? pageItem->dpiY() / renderedEvent->yres : 0);
+      const QRect & r = renderedEvent->render_rect;
+      pageItem->update(QRectF(r.x() * sx, r.y() * sy, r.width() * sx, r.height() * sy));
+    }
+    return true;
+  }
+  return Super::event(event);
+}
+
+
+// PDFDocumentMagnifierView
+// ========================
+//
+// Maximum size (in bytes) of the magnifier's own tile cache; this holds 16 full
+// tiles, i.e., enough for the magnifier and the neighbourhood prefetched around
+// it
+static const int MAGNIFIER_CACHE_SIZE = 16 * TILE_SIZE * TILE_SIZE * 4;
+
+PDFDocumentMagnifierView::PDFDocumentMagnifierView(PDFDocumentView *parent /* = nullptr */) :
+  Super(parent),
+  _parent_view(parent),
+  _zoomLevel(1.0),
+  _zoomFactor(2.0),
+  _shape(DocumentTool::MagnifyingGlass::Magnifier_Circle),
+  _size(300)
 {
   // the magnifier should initially be hidden
   hide();
@@ -1613,11 +2385,24 @@ PDFDocumentMagnifierView::PDFDocumentMagnifierView(PDFDocumentView *parent /* =
     // transfer some settings from the parent view
     setBackgroundRole(parent->backgroundRole());
     setAlignment(parent->alignment());
+    // magnified tiles of the old document are useless after a reload
+    connect(parent, SIGNAL(changedDocument(const QWeakPointer<QtPDF::Backend::Document>)), this, SLOT(clearTileCache()));
   }
 
+  _tileCache.setMaxSize(MAGNIFIER_CACHE_SIZE);
+
   setShape(_shape);
 }
 
+PDFDocumentMagnifierView::~PDFDocumentMagnifierView()
+{
+  // Ensure no render request can post its result to us after we're gone
+  QSharedPointer<Backend::Document> doc(_tileDocument.toStrongRef());
+  if (doc)
+    doc->processingThread().cancelRequestsAndWait(this);
+  clearTileCache();
+}
+
 void PDFDocumentMagnifierView::prepareToShow()
 {
   qreal zoomLevel;
@@ -1626,12 +2411,18 @@ void PDFDocumentMagnifierView::prepareToShow()
     return;
 
   // Ensure we have the same scene
-  if (_parent_view->scene() != scene())
+  if (_parent_view->scene() != scene()) {
     setScene(_parent_view->scene());
+    clearTileCache();
+  }
   // Fix the zoom
   zoomLevel = _parent_view->zoomLevel() * _zoomFactor;
-  if (zoomLevel != _zoomLevel)
+  if (zoomLevel != _zoomLevel) {
     scale(zoomLevel / _zoomLevel, zoomLevel / _zoomLevel);
+    // Tiles at the old magnification will hardly be needed again soon; don't
+    // waste time on finishing any pending renders of them
+    clearTileCache();
+  }
   _zoomLevel = zoomLevel;
   // Ensure we have enough padding at the border that we can display the
   // magnifier even beyond the edge
@@ -1729,6 +2520,124 @@ void PDFDocumentMagnifierView::paintEvent(QPaintEvent * event)
   // PDFDocumentMagnifierView::dropShadow().
 }
 
+QSharedPointer<QImage> PDFDocumentMagnifierView::getTileImage(QSharedPointer<Backend::Page> page, const double xres, const double yres, const QRect & tile, const Backend::PDFPageColorFilter & colorFilter)
+{
+  if (!page)
+    return QSharedPointer<QImage>();
+
+  Backend::PDFPageTile key(xres, yres, tile, page->pageNum(), colorFilter);
+  requestTile(page, key);
+
+  QSharedPointer<QImage> retVal = _tileCache.getImage(key);
+  if (retVal)
+    return retVal;
+
+  // The tile is still rendering in the background (and has no placeholder
+  // image, yet, e.g., because it was prefetched), so construct one now. As
+  // the unmagnified tiles are usually available, this shows a blurred version
+  // of the page rather than the "rendering" dummy.
+  QImage * tmpImg = page->placeholderTile(xres, yres, tile, colorFilter);
+  retVal = _tileCache.setImage(key, tmpImg, Backend::PDFPageCache::PLACEHOLDER, false);
+  if (retVal != tmpImg)
+    delete tmpImg;
+  return retVal;
+}
+
+void PDFDocumentMagnifierView::requestTile(QSharedPointer<Backend::Page> page, const Backend::PDFPageTile & key)
+{
+  if (!page)
+    return;
+
+  QSharedPointer<QImage> img = _tileCache.getImage(key);
+  switch (_tileCache.getStatus(key)) {
+    case Backend::PDFPageCache::PLACEHOLDER:
+      // Already rendering in the background
+      return;
+    case Backend::PDFPageCache::CURRENT:
+      // NB: The image may have been evicted from the cache in the meantime
+      if (img)
+        return;
+      break;
+    default:
+      break;
+  }
+
+  // NB: Render without caching so the result doesn't end up in (and evict
+  // tiles from) the document's page cache; we put it into _tileCache in
+  // event() instead
+  page->asyncRenderToImage(this, key.xres, key.yres, key.render_box, false, key.color_filter);
+  // Mark the tile as pending (keeping any outdated image as placeholder)
+  _tileCache.setImage(key, img.data(), Backend::PDFPageCache::PLACEHOLDER, false);
+}
+
+void PDFDocumentMagnifierView::prefetchTiles(const QPoint & motion /* = QPoint() */)
+{
+  if (!scene() || !_parent_view)
+    return;
+
+  Backend::PDFPageColorFilter colorFilter(_parent_view->pageColorFilter());
+
+  // The part of the scene currently shown in the magnifier
+  QRectF visibleRect(mapToScene(viewport()->rect()).boundingRect());
+  // Prefetch a small neighbourhood around it...
+  QRectF prefetchRect(visibleRect.adjusted(-visibleRect.width() / 4, -visibleRect.height() / 4, visibleRect.width() / 4, visibleRect.height() / 4));
+  // ... and look ahead by one magnifier size in the direction of motion
+  qreal length = qSqrt(motion.x() * motion.x() + motion.y() * motion.y());
+  if (length > 0)
+    prefetchRect |= visibleRect.translated(visibleRect.width() * motion.x() / length, visibleRect.height() * motion.y() / length);
+
+  foreach (QGraphicsItem * item, scene()->items(prefetchRect)) {
+    if (!item || item->type() != PDFPageGraphicsItem::Type)
+      continue;
+    PDFPageGraphicsItem * pageItem = static_cast<PDFPageGraphicsItem*>(item);
+    QSharedPointer<Backend::Page> page(pageItem->page().toStrongRef());
+    if (!page)
+      continue;
+    // NB: Use the same scale factor PDFPageGraphicsItem::paint() will see so
+    // the tiles' keys match exactly
+    qreal scaleFactor = pageItem->deviceTransform(viewportTransform()).m11();
+    QRectF rect(pageItem->mapRectFromScene(prefetchRect).intersected(pageItem->boundingRect()));
+    foreach (QRect tile, pageItem->tilesForRect(rect, scaleFactor))
+      requestTile(page, Backend::PDFPageTile(pageItem->dpiX() * scaleFactor, pageItem->dpiY() * scaleFactor, tile, page->pageNum(), colorFilter));
+  }
+}
+
+void PDFDocumentMagnifierView::clearTileCache()
+{
+  QSharedPointer<Backend::Document> doc(_tileDocument.toStrongRef());
+  if (doc)
+    doc->processingThread().cancelRequests(this);
+  _tileCache.clear();
+
+  PDFDocumentScene * pdfScene = qobject_cast<PDFDocumentScene*>(scene());
+  _tileDocument = (pdfScene ? pdfScene->document() : QWeakPointer<Backend::Document>());
+}
+
+bool PDFDocumentMagnifierView::event(QEvent * event)
+{
+  // Look for background renders of magnified tiles
+  if (event && event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+    event->accept();
+    const Backend::PDFPageRenderedEvent * renderedEvent = dynamic_cast<const Backend::PDFPageRenderedEvent*>(event);
+    Backend::PDFPageTile key(renderedEvent->xres, renderedEvent->yres, renderedEvent->render_rect, renderedEvent->page_num, renderedEvent->color_filter);
+    // Discard results that are no longer needed (e.g., because the cache was
+    // cleared in the meantime)
+    if (_tileCache.getStatus(key) != Backend::PDFPageCache::PLACEHOLDER)
+      return true;
+    if (renderedEvent->rendered_page.isNull()) {
+      // Rendering failed; try again the next time the tile is painted
+      _tileCache.markOutdated(key);
+      return true;
+    }
+    QImage * img = new QImage(renderedEvent->rendered_page);
+    if (img != _tileCache.setImage(key, img, Backend::PDFPageCache::CURRENT))
+      delete img;
+    viewport()->update();
+    return true;
+  }
+  return Super::event(event);
+}
+
 // Modelled after http://labs.qt.nokia.com/2009/10/07/magnifying-glass
 QPixmap& PDFDocumentMagnifierView::dropShadow()
 {
@@ -1817,10 +2726,47 @@ QPixmap& PDFDocumentMagnifierView::dropShadow()
 // A large canvas that manages the layout of QGraphicsItem subclasses. The
 // primary items we are concerned with are PDFPageGraphicsItem and
 // PDFLinkGraphicsItem.
+QList<PDFDocumentScene*> PDFDocumentScene::_allScenes;
+
+// Number of pages at the beginning of the document whose size is determined
+// right away when (re)initializing the scene (see reinitializeScene())
+static const int INITIALLY_MEASURED_PAGES = 4;
+// Number of pages measured per call of PDFDocumentScene::measurePages()
+static const int MEASURE_PAGES_BATCH_SIZE = 100;
+// Time (in ms) after which the pages are measured even if no tile could be
+// shown, yet (e.g., because the scene is not visible)
+static const int MEASURE_PAGES_DELAY = 1000;
+// Intervals (in ms) between the checks whether a file that changed on disk has
+// been written completely (see PDFDocumentScene::checkFileStability())
+static const int RELOAD_CHECK_MIN_INTERVAL = 50;
+static const int RELOAD_CHECK_MAX_INTERVAL = 800;
+// Time (in ms) after which a changed file is reloaded even if it doesn't look
+// complete (e.g., because it is damaged)
+static const int RELOAD_MAX_WAIT = 5000;
+
+// Returns true if the file `fileName` looks like a complete PDF file, i.e., if
+// it ends with an end-of-file marker (which PDF writers write last)
+static bool isCompletePDFFile(const QString & fileName)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  // NB: The marker must be in the last 1024 bytes (PDF reference, sec. 3.4.4)
+  if (file.size() > 1024)
+    file.seek(file.size() - 1024);
+  return file.read(1024).contains("%%EOF");
+}
+
 PDFDocumentScene::PDFDocumentScene(QSharedPointer<Backend::Document> a_doc, QObject *parent /* = nullptr */, const double dpiX /* = -1 */, const double dpiY /* = -1 */):
   Super(parent),
   _doc(a_doc),
   _lastPage(-1),
+  _watchForDocumentChangesOnDisk(false),
+  _reloadCheckInterval(RELOAD_CHECK_MIN_INTERVAL),
+  _reloadFileSize(-1),
+  _nextPageToMeasure(0),
+  _timeToFirstPixel(-1),
+  _pendingPrerenderTiles(0),
   _shownPageIdx(-2)
 {
   Q_ASSERT(a_doc != nullptr);
@@ -1863,20 +2809,27 @@ PDFDocumentScene::PDFDocumentScene(QSharedPointer<Backend::Document> a_doc, QObj
   // We must not respond to a QFileSystemWatcher::timeout() signal directly as
   // file operations need not be atomic. I.e., QFileSystemWatcher could fire
   // several times between the begging of a change to the file and its
-  // completion. Hence, we use a timer to delay the call to reloadDocument(). If
-  // the QFileSystemWatcher fires several times, the timer gets restarted every
-  // time.
+  // completion. Hence, we use a timer to check (at increasing intervals)
+  // whether the file has stopped changing before calling reloadDocument() (see
+  // checkFileStability()).
   _reloadTimer.setSingleShot(true);
-  _reloadTimer.setInterval(500);
-  connect(&_reloadTimer, SIGNAL(timeout()), this, SLOT(reloadDocument()));
-  connect(&_fileWatcher, SIGNAL(fileChanged(const QString &)), &_reloadTimer, SLOT(start()));
+  connect(&_reloadTimer, SIGNAL(timeout()), this, SLOT(checkFileStability()));
+  connect(&_fileWatcher, SIGNAL(fileChanged(const QString &)), this, SLOT(fileChangedOnDisk()));
   setWatchForDocumentChangesOnDisk(true);
 
+  _measureTimer.setSingleShot(true);
+  connect(&_measureTimer, SIGNAL(timeout()), this, SLOT(measurePages()));
+
+  _allScenes << this;
   reinitializeScene();
 }
 
 PDFDocumentScene::~PDFDocumentScene()
 {
+  _allScenes.removeOne(this);
+  // Make sure no pending prerenders post events to us after we are gone
+  if (_pendingPrerenderTiles > 0)
+    _doc->processingThread().cancelRequestsAndWait(this);
   // Destroy the _unlockProxy if it is not currently attached to the scene (in
   // which case it is destroyed automatically)
   if (!_unlockProxy->scene()) {
@@ -1995,6 +2948,21 @@ bool PDFDocumentScene::event(QEvent *event)
     handleActionEvent(action_event);
     return true;
   }
+  if (event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+    // A tile requested by prerender() has arrived (it is in the page cache
+    // now)
+    event->accept();
+    // If the scene is shown already (e.g., because prerendering took too
+    // long), the page item only has the placeholder and is not notified
+    // otherwise
+    const Backend::PDFPageRenderedEvent * renderedEvent = dynamic_cast<const Backend::PDFPageRenderedEvent*>(event);
+    QGraphicsItem * item = (renderedEvent ? pageAt(renderedEvent->page_num) : nullptr);
+    if (item)
+      item->update();
+    if (_pendingPrerenderTiles > 0 && --_pendingPrerenderTiles == 0)
+      emit prerenderingFinished();
+    return true;
+  }
 
   return Super::event(event);
 }
@@ -2062,6 +3030,12 @@ void PDFDocumentScene::reinitializeScene()
   clear();
   _pages.clear();
   _pageLayout.clearPages();
+  _measureTimer.stop();
+
+  // Count from now unless the time the document was (re)loaded is known
+  if (!_openTimer.isValid())
+    _openTimer.start();
+  _timeToFirstPixel = -1;
 
   _lastPage = _doc->numPages();
   if (!_doc->isValid())
@@ -2079,22 +3053,130 @@ void PDFDocumentScene::reinitializeScene()
     if (_shownPageIdx >= _lastPage)
       _shownPageIdx = _lastPage - 1;
 
+    // To show the first pixels as soon as possible, only the sizes of the pages
+    // that are likely to be visible initially are determined right away. All
+    // other pages get an estimated size (the one from before the reload, if
+    // any, or that of the first page) and are measured in the background once
+    // the first tile could be shown (see measurePages()). The page objects
+    // themselves are only created when they are needed (e.g., for painting).
+    _pageSizes.resize(_lastPage);
+    for (i = 0; i < qMin(_lastPage, INITIALLY_MEASURED_PAGES); ++i)
+      _pageSizes[i] = _doc->pageSizeF(i);
+    if (_shownPageIdx >= INITIALLY_MEASURED_PAGES)
+      _pageSizes[_shownPageIdx] = _doc->pageSizeF(_shownPageIdx);
+
     for (i = 0; i < _lastPage; ++i)
     {
-      PDFPageGraphicsItem * pagePtr = new PDFPageGraphicsItem(_doc->page(i), _dpiX, _dpiY);
+      PDFPageGraphicsItem * pagePtr = new PDFPageGraphicsItem(i, (_pageSizes[i].isEmpty() ? _pageSizes[0] : _pageSizes[i]), _dpiX, _dpiY);
       pagePtr->setVisible(i == _shownPageIdx || _shownPageIdx == -2);
       _pages.append(pagePtr);
       addItem(pagePtr);
       _pageLayout.addPage(pagePtr);
     }
     _pageLayout.relayout();
+
+    _nextPageToMeasure = qMin(_lastPage, INITIALLY_MEASURED_PAGES);
+    _measureTimer.start(MEASURE_PAGES_DELAY);
+  }
+}
+
+void PDFDocumentScene::measurePages()
+{
+  const int end = qMin(_lastPage, _nextPageToMeasure + MEASURE_PAGES_BATCH_SIZE);
+  bool changed = false;
+  for (; _nextPageToMeasure < end && _nextPageToMeasure < _pages.size(); ++_nextPageToMeasure) {
+    const QSizeF size(_doc->pageSizeF(_nextPageToMeasure));
+    if (size.isEmpty())
+      continue;
+    _pageSizes[_nextPageToMeasure] = size;
+    PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem*>(_pages[_nextPageToMeasure]);
+    if (pageItem && pageItem->setPageSize(size))
+      changed = true;
+  }
+  // Only relayout if an estimate was wrong; usually, all pages have the same
+  // size (or, after a reload, the same sizes as before)
+  if (changed)
+    _pageLayout.relayout();
+  // Give the event loop a chance to process other events between batches
+  if (_nextPageToMeasure < qMin(_lastPage, _pages.size()))
+    _measureTimer.start(0);
+}
+
+void PDFDocumentScene::tileAvailable()
+{
+  if (_timeToFirstPixel >= 0 || !_openTimer.isValid())
+    return;
+  _timeToFirstPixel = _openTimer.elapsed();
+  _openTimer.invalidate();
+  emit firstPixelAvailable(_timeToFirstPixel);
+  // Now that the user sees something, determine the remaining page sizes
+  if (_measureTimer.isActive())
+    _measureTimer.start(0);
+}
+
+void PDFDocumentScene::adoptPageSizes(const PDFDocumentScene & other)
+{
+  bool changed = false;
+  for (int i = qMax(_nextPageToMeasure, INITIALLY_MEASURED_PAGES); i < _pages.size() && i < other._pageSizes.size(); ++i) {
+    if (!_pageSizes[i].isEmpty() || other._pageSizes[i].isEmpty())
+      continue;
+    PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem*>(_pages[i]);
+    // NB: Leave _pageSizes[i] empty; the page still needs to be measured
+    if (pageItem && pageItem->setPageSize(other._pageSizes[i]))
+      changed = true;
+  }
+  if (changed)
+    _pageLayout.relayout();
+}
+
+void PDFDocumentScene::measurePageRange(const int first, const int last)
+{
+  bool changed = false;
+  for (int i = qMax(0, first); i <= last && i < _pages.size(); ++i) {
+    if (!_pageSizes[i].isEmpty())
+      continue;
+    const QSizeF size(_doc->pageSizeF(i));
+    if (size.isEmpty())
+      continue;
+    _pageSizes[i] = size;
+    PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem*>(_pages[i]);
+    if (pageItem && pageItem->setPageSize(size))
+      changed = true;
+  }
+  if (changed)
+    _pageLayout.relayout();
+}
+
+int PDFDocumentScene::prerender(const QRectF & rect, const qreal scaleFactor, const Backend::PDFPageColorFilter & colorFilter)
+{
+  int retVal = 0;
+  foreach (QGraphicsItem * item, items(rect)) {
+    if (!item || !isPageItem(item) || !item->isVisible())
+      continue;
+    PDFPageGraphicsItem * pageItem = static_cast<PDFPageGraphicsItem*>(item);
+    QSharedPointer<Backend::Page> page(pageItem->page().toStrongRef());
+    if (!page)
+      continue;
+    const double xres = pageItem->dpiX() * scaleFactor, yres = pageItem->dpiY() * scaleFactor;
+    QRectF pageRect(pageItem->mapRectFromScene(rect).intersected(pageItem->boundingRect()));
+    foreach (QRect tile, pageItem->tilesForRect(pageRect, scaleFactor)) {
+      Backend::PDFPageCache::TileStatus status = _doc->pageCache().getStatus(Backend::PDFPageTile(xres, yres, tile, page->pageNum(), colorFilter));
+      if (status == Backend::PDFPageCache::CURRENT || status == Backend::PDFPageCache::PLACEHOLDER)
+        continue;
+      // NB: getTileImage() puts a placeholder into the cache, so the page item
+      // doesn't request the tile a second time if it is painted before the
+      // tile is finished
+      page->getTileImage(this, xres, yres, tile, colorFilter);
+      ++retVal;
+    }
   }
+  _pendingPrerenderTiles += retVal;
+  return retVal;
 }
 
 void PDFDocumentScene::finishUnlock()
 {
-  reinitializeScene();
-  emit documentChanged(_doc);
+  reinitializeSharingScenes();
 }
 
 void PDFDocumentScene::reloadDocument()
@@ -2103,9 +3185,76 @@ void PDFDocumentScene::reloadDocument()
   if(!QFile::exists(_doc->fileName()))
     return;
 
+  // If the document is shared, another scene may have reloaded it already (in
+  // which case this scene was reinitialized, too)
+  if (_doc->isUpToDate()) {
+    reinitializeScene();
+    emit documentChanged(_doc.toWeakRef());
+    return;
+  }
+  // The time to the first pixel includes reloading the document
+  _openTimer.start();
   _doc->reload();
-  reinitializeScene();
-  emit documentChanged(_doc.toWeakRef());
+  reinitializeSharingScenes();
+}
+
+void PDFDocumentScene::fileChangedOnDisk()
+{
+  // Some programs replace the file instead of rewriting it, in which case
+  // QFileSystemWatcher stops watching it (if the file doesn't exist at the
+  // moment, checkFileStability() watches it again once it does)
+  if (!_fileWatcher.files().contains(_doc->fileName()) && QFile::exists(_doc->fileName()))
+    _fileWatcher.addPath(_doc->fileName());
+
+  // Start over (if a check is pending already, the file is still changing)
+  QFileInfo fi(_doc->fileName());
+  _reloadFileSize = fi.size();
+  _reloadFileModified = fi.lastModified();
+  _reloadCheckInterval = RELOAD_CHECK_MIN_INTERVAL;
+  if (!_reloadTimer.isActive())
+    _reloadWaitTimer.start();
+  _reloadTimer.start(_reloadCheckInterval);
+}
+
+void PDFDocumentScene::checkFileStability()
+{
+  QFileInfo fi(_doc->fileName());
+  // The file was removed (e.g., by a program that deletes it before writing
+  // it anew); as QFileSystemWatcher stopped watching it, poll until it is
+  // recreated
+  if (!fi.exists()) {
+    _reloadTimer.start(RELOAD_CHECK_MAX_INTERVAL);
+    return;
+  }
+  if (_watchForDocumentChangesOnDisk && !_fileWatcher.files().contains(_doc->fileName())) {
+    _fileWatcher.addPath(_doc->fileName());
+    // Give the program writing the file the full time to complete it
+    _reloadWaitTimer.start();
+  }
+  const bool stable = (fi.size() == _reloadFileSize && fi.lastModified() == _reloadFileModified);
+  if ((stable && isCompletePDFFile(fi.filePath())) || _reloadWaitTimer.elapsed() > RELOAD_MAX_WAIT) {
+    reloadDocument();
+    return;
+  }
+  // The file is still being written; check again later, but less eagerly as
+  // the program writing it is evidently taking its time
+  _reloadFileSize = fi.size();
+  _reloadFileModified = fi.lastModified();
+  _reloadCheckInterval = qMin(2 * _reloadCheckInterval, RELOAD_CHECK_MAX_INTERVAL);
+  _reloadTimer.start(_reloadCheckInterval);
+}
+
+void PDFDocumentScene::reinitializeSharingScenes()
+{
+  foreach (PDFDocumentScene * scene, _allScenes) {
+    if (scene->_doc != _doc)
+      continue;
+    // The scene is up to date now, so a pending reload is unnecessary
+    if (scene != this)
+      scene->_reloadTimer.stop();
+    scene->reinitializeScene();
+    emit scene->documentChanged(_doc.toWeakRef());
+  }
 }
 
 
@@ -2158,6 +3307,11 @@ void PDFDocumentScene::showAllPages()
 
 void PDFDocumentScene::setWatchForDocumentChangesOnDisk(const bool doWatch /* = true */)
 {
+  // Changes noticed before are handled by whoever stops watching (e.g., after
+  // typesetting finishes)
+  if (!doWatch)
+    _reloadTimer.stop();
+  _watchForDocumentChangesOnDisk = doWatch;
   if (!_fileWatcher.files().empty())
     _fileWatcher.removePaths(_fileWatcher.files());
   if (doWatch) {
@@ -2192,7 +3346,8 @@ PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, con
   _pageNum(-1),
   _linksLoaded(false),
   _annotationsLoaded(false),
-  _zoomLevel(0.0)
+  _zoomLevel(0.0),
+  _gesturePlaceholderScale(0)
 {
   _dpiX = (dpiX > 0 ? dpiX : QApplication::desktop()->physicalDpiX());
   _dpiY = (dpiY > 0 ? dpiY : QApplication::desktop()->physicalDpiY());
@@ -2206,43 +3361,75 @@ PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, con
   QSharedPointer<Backend::Page> page(_page.toStrongRef());
   if (page) {
     _pageNum = page->pageNum();
-    // Create an empty pixmap that is the same size as the PDF page. This
-    // allows us to delay the rendering of pages until they actually come into
-    // view yet still know what the page size is.
-    _pageSize = page->pageSizeF();
-    _pageSize.setWidth(_pageSize.width() * _dpiX / 72.0);
-    _pageSize.setHeight(_pageSize.height() * _dpiY / 72.0);
-
-    // `_pageScale` holds a transformation matrix that can map between normalized
-    // page coordinates (in the range 0...1) and the coordinate system for this
-    // graphics item. `_pointScale` is similar, except it maps from coordinates
-    // expressed in pixels at a resolution of 72 dpi.
-    _pageScale = QTransform::fromScale(_pageSize.width(), _pageSize.height());
-    _pointScale = QTransform::fromScale(_dpiX / 72.0, _dpiY / 72.0);
+    setPageSize(page->pageSizeF());
   }
 }
 
+PDFPageGraphicsItem::PDFPageGraphicsItem(const int pageNum, const QSizeF & pageSize, const double dpiX, const double dpiY, QGraphicsItem *parent /* = nullptr */):
+  Super(parent),
+  _pageNum(pageNum),
+  _linksLoaded(false),
+  _annotationsLoaded(false),
+  _zoomLevel(0.0),
+  _gesturePlaceholderScale(0)
+{
+  _dpiX = (dpiX > 0 ? dpiX : QApplication::desktop()->physicalDpiX());
+  _dpiY = (dpiY > 0 ? dpiY : QApplication::desktop()->physicalDpiY());
+  setFlags(QGraphicsItem::ItemUsesExtendedStyleOption);
+  setPageSize(pageSize);
+}
+
+bool PDFPageGraphicsItem::setPageSize(const QSizeF & pageSize)
+{
+  // The item has the same size as the PDF page. This allows us to delay the
+  // rendering of pages until they actually come into view yet still know what
+  // the page size is.
+  QSizeF size(pageSize.width() * _dpiX / 72.0, pageSize.height() * _dpiY / 72.0);
+  if (size == _pageSize)
+    return false;
+  prepareGeometryChange();
+  _pageSize = size;
+
+  // `_pageScale` holds a transformation matrix that can map between normalized
+  // page coordinates (in the range 0...1) and the coordinate system for this
+  // graphics item. `_pointScale` is similar, except it maps from coordinates
+  // expressed in pixels at a resolution of 72 dpi.
+  _pageScale = QTransform::fromScale(_pageSize.width(), _pageSize.height());
+  _pointScale = QTransform::fromScale(_dpiX / 72.0, _dpiY / 72.0);
+  return true;
+}
+
 QRectF PDFPageGraphicsItem::boundingRect() const { return QRectF(QPointF(0.0, 0.0), _pageSize); }
 int PDFPageGraphicsItem::type() const { return Type; }
 
+QWeakPointer<Backend::Page> PDFPageGraphicsItem::page() const
+{
+  // If the document evicted the page object to save memory, get a new one
+  if (_page.isNull() && _pageNum >= 0) {
+    PDFDocumentScene * pdfScene = qobject_cast<PDFDocumentScene*>(scene());
+    QSharedPointer<Backend::Document> doc(pdfScene ? pdfScene->document().toStrongRef() : QSharedPointer<Backend::Document>());
+    if (doc)
+      _page = doc->page(_pageNum);
+  }
+  return _page;
+}
+
+// NB: The mapping functions only use the page size cached in the item so they
+// don't need the page object (which may have been evicted, see page())
 QPointF PDFPageGraphicsItem::mapFromPage(const QPointF & point) const
 {
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
-  if (!page)
+  if (_pageNum < 0)
     return QPointF();
   // item coordinates are in pixels
-  return QPointF(_pageSize.width() * point.x() / page->pageSizeF().width(), \
-    _pageSize.height() * (1.0 - point.y() / page->pageSizeF().height()));
+  return QPointF(point.x() * _dpiX / 72.0, _pageSize.height() - point.y() * _dpiY / 72.0);
 }
 
 QPointF PDFPageGraphicsItem::mapToPage(const QPointF & point) const
 {
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
-  if (!page)
+  if (_pageNum < 0)
     return QPointF();
   // item coordinates are in pixels
-  return QPointF(page->pageSizeF().width() * point.x() / _pageSize.width(), \
-    page->pageSizeF().height() * (1.0 - point.y() / _pageSize.height()));
+  return QPointF(point.x() * 72.0 / _dpiX, (_pageSize.height() - point.y()) * 72.0 / _dpiY);
 }
 
 // An overloaded paint method allows us to handle rendering via asynchronous
@@ -2254,7 +3441,7 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   qreal scaleFactor = painter->transform().m11();
   QTransform scaleT = QTransform::fromScale(scaleFactor, scaleFactor);
   QRect pageRect = scaleT.mapRect(boundingRect()).toAlignedRect();
-  QSharedPointer<Backend::Page> page(_page.toStrongRef());
+  QSharedPointer<Backend::Page> page(this->page().toStrongRef());
   QSharedPointer<QImage> renderedPage;
 
   if (!page)
@@ -2269,8 +3456,10 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   }
   
   if (!_annotationsLoaded) {
+    // Don't hold up painting (in particular, of the first page after opening
+    // the document); load them once control returns to the event loop
     // FIXME: Load annotations asynchronously?
-    addAnnotations(page->loadAnnotations());
+    QTimer::singleShot(0, this, SLOT(loadAnnotations()));
     _annotationsLoaded = true;
   }
 
@@ -2307,19 +3496,19 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
       QImage img(page->transition()->getImage());
       QPoint offset((pageRect.width() - img.width()) / 2, (pageRect.height() - img.height()) / 2);
       painter->drawImage(offset, img);
-      // Trigger an update as soon as possible (without recursion) to proceed
-      // with the animation.
-      if (widget) {
-        QTimer::singleShot(1, widget, SLOT(update()));
-      }
+      // Schedule the next frame (in sync with the display's refresh rate) to
+      // proceed with the animation.
+      view->scheduleTransitionFrame();
     }
     else {
-      // render the whole page synchronously (we don't want "rendering" to show
-      // up during presentations, and we don't need tiles as we always display
-      // the full page, anyway).
-      renderedPage = page->getTileImage(nullptr, _dpiX * scaleFactor, _dpiY * scaleFactor);
-      if (renderedPage)
-        painter->drawImage(QPoint(0, 0), *renderedPage);
+      // The view keeps the current and the adjacent slides pre-rendered at
+      // screen resolution, so this usually is a mere blit (otherwise, the whole
+      // page is rendered synchronously as we don't want "rendering" to show up
+      // during presentations; we don't need tiles as we always display the full
+      // page, anyway).
+      QImage slide(view->presentationSlide(page->pageNum(), _dpiX * scaleFactor, _dpiY * scaleFactor));
+      if (!slide.isNull())
+        painter->drawImage(QPoint(0, 0), slide);
     }
   }
   else { // presentation mode
@@ -2341,81 +3530,132 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
     painter->setPen(tilePen);
 #endif
 
-    QRect visibleRect = scaleT.mapRect(option->exposedRect).toAlignedRect();
-  
-    int i, imin, imax;
-    int j, jmin, jmax;
-  
-    imin = (visibleRect.left() - pageRect.left()) / TILE_SIZE;
-    imax = (visibleRect.right() - pageRect.left());
-    if (imax % TILE_SIZE == 0)
-      imax /= TILE_SIZE;
-    else
-      imax = imax / TILE_SIZE + 1;
-  
-    jmin = (visibleRect.top() - pageRect.top()) / TILE_SIZE;
-    jmax = (visibleRect.bottom() - pageRect.top());
-    if (jmax % TILE_SIZE == 0)
-      jmax /= TILE_SIZE;
-    else
-      jmax = jmax / TILE_SIZE + 1;
-  
-    for (j = jmin; j < jmax; ++j) {
-      for (i = imin; i < imax; ++i) {
-        QRect tile(i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    Backend::PDFPageColorFilter colorFilter;
+    // If we are rendering a PDFDocumentView that has a color filter set
+    // respect that setting.
+    if (view)
+      colorFilter = view->pageColorFilter();
+    // If we are rendering a PDFDocumentMagnifierView who's parent
+    // PDFDocumentView has a color filter set respect that setting.
+    else if (widget && widget->parent() && widget->parent()->parent()) {
+      PDFDocumentView * parentView = qobject_cast<PDFDocumentView*>(widget->parent()->parent());
+      if (parentView)
+        colorFilter = parentView->pageColorFilter();
+    }
   
-        bool useGrayScale = false;
-        // If we are rendering a PDFDocumentView that has `useGrayScale` set
-        // respect that setting.
-        if (view && view->useGrayScale())
-          useGrayScale = true;
-        // If we are rendering a PDFDocumentMagnifierView who's parent
-        // PDFDocumentView has `useGrayScale` set respect that setting.
-        else if (widget && widget->parent() && widget->parent()->parent()) {
-          PDFDocumentView * view = (widget ? qobject_cast<PDFDocumentView*>(widget->parent()->parent()) : nullptr);
-          if (view && view->useGrayScale())
-            useGrayScale = true;
+    if (view && view->isZoomGestureActive()) {
+      // While the zoom level is changing continuously, merely scale the tiles
+      // rendered before the gesture started; the tiles at the new resolution
+      // are requested once the zoom has settled
+      const qreal baseScale = view->zoomGestureBaseScale();
+      const qreal s = scaleFactor / baseScale;
+      if (!qFuzzyCompare(_gesturePlaceholderScale, baseScale) || _gesturePlaceholderFilter != colorFilter) {
+        _gesturePlaceholders.clear();
+        _gesturePlaceholderScale = baseScale;
+        _gesturePlaceholderFilter = colorFilter;
+      }
+      foreach (QRect tile, tilesForRect(option->exposedRect, baseScale)) {
+        QRectF target(tile.left() * s, tile.top() * s, tile.width() * s, tile.height() * s);
+        renderedPage = page->getCachedImage(_dpiX * baseScale, _dpiY * baseScale, tile, nullptr, colorFilter);
+        if (renderedPage) {
+          page->document()->pageCache().lock();
+          painter->drawImage(target, *renderedPage);
+          page->document()->pageCache().unlock();
         }
+        else {
+          // Not rendered at the base resolution (e.g., because it only became
+          // visible during the gesture), so try to make do with whatever is
+          // there at other resolutions. Building that is expensive, so only
+          // do it once per tile and gesture rather than on every frame.
+          QImage & placeholder = _gesturePlaceholders[qMakePair(tile.x(), tile.y())];
+          if (placeholder.isNull()) {
+            QImage * tmpImg = page->placeholderTile(_dpiX * baseScale, _dpiY * baseScale, tile, colorFilter);
+            placeholder = *tmpImg;
+            delete tmpImg;
+          }
+          painter->drawImage(target, placeholder);
+        }
+      }
+      painter->restore();
+      return;
+    }
+    if (view && !_gesturePlaceholders.isEmpty()) {
+      // The gesture is over
+      _gesturePlaceholders.clear();
+      _gesturePlaceholderScale = 0;
+    }
 
-        renderedPage = page->getTileImage(this, _dpiX * scaleFactor, _dpiY * scaleFactor, tile);
+    // If we are rendering a PDFDocumentMagnifierView, magnified tiles are taken
+    // from its own tile cache (see PDFDocumentMagnifierView::getTileImage())
+    PDFDocumentMagnifierView * magnifier = (!view && widget ? qobject_cast<PDFDocumentMagnifierView*>(widget->parent()) : nullptr);
+    PDFDocumentScene * pdfScene = qobject_cast<PDFDocumentScene*>(scene());
+
+    foreach (QRect tile, tilesForRect(option->exposedRect, scaleFactor)) {
+      if (magnifier) {
+        // NB: The magnifier's cache is only ever modified from the main (GUI)
+        // thread, so the image cannot change while we draw it
+        renderedPage = magnifier->getTileImage(page, _dpiX * scaleFactor, _dpiY * scaleFactor, tile, colorFilter);
+        if (renderedPage)
+          painter->drawImage(tile.topLeft(), *renderedPage);
+      }
+      else {
+        renderedPage = page->getTileImage(this, _dpiX * scaleFactor, _dpiY * scaleFactor, tile, colorFilter);
         // we don't want a finished render thread to change our image while we
         // draw it
         page->document()->pageCache().lock();
         // renderedPage as returned from getTileImage _should_ always be valid
-        if ( renderedPage ) {
-          if (useGrayScale) {
-            // In gray scale mode, we need to obtain a deep copy of the rendered
-            // page image to avoid altering the cached (color) image
-            QImage postProcessed = renderedPage->copy();
-            imageToGrayScale(postProcessed);
-            painter->drawImage(tile.topLeft(), postProcessed);
-          }
-          else
-            painter->drawImage(tile.topLeft(), *renderedPage);
-        }
+        // NB: Color filters (e.g., gray scale) have already been applied by the
+        // render thread (filtered tiles are cached separately)
+        if ( renderedPage )
+          painter->drawImage(tile.topLeft(), *renderedPage);
         page->document()->pageCache().unlock();
+        // Tiles that were cached already (e.g., because another view shares the
+        // document) never arrive as PDFPageRenderedEvent, so check for them
+        // here (as long as it matters, see PDFDocumentScene::tileAvailable())
+        if (renderedPage && pdfScene && pdfScene->timeToFirstPixel() < 0 && \
+            page->document()->pageCache().getStatus(Backend::PDFPageTile(_dpiX * scaleFactor, _dpiY * scaleFactor, tile, _pageNum, colorFilter)) == Backend::PDFPageCache::CURRENT)
+          pdfScene->tileAvailable();
+      }
 #ifdef DEBUG
-        painter->drawRect(tile);
+      painter->drawRect(tile);
 #endif
-      }
     }
   }
   painter->restore();
 }
 
-//static
-void PDFPageGraphicsItem::imageToGrayScale(QImage & img)
+QList<QRect> PDFPageGraphicsItem::tilesForRect(const QRectF & rect, const qreal scaleFactor) const
 {
-  // Casting to QRgb* only works for 32bit images
-  Q_ASSERT(img.depth() == 32);
-  QRgb * data = reinterpret_cast<QRgb*>(img.scanLine(0));
-  int i;
-  for (i = 0; i < img.byteCount() / 4; ++i) {
-    // Qt formula (qGray()): 0.34375 * r + 0.5 * g + 0.15625 * b
-    // MuPDF formula (rgb_to_gray()): r * 0.3f + g * 0.59f + b * 0.11f;
-    int gray = qGray(data[i]);
-    data[i] = qRgba(gray, gray, gray, qAlpha(data[i]));
+  QList<QRect> tiles;
+  if (rect.isEmpty())
+    return tiles;
+
+  QTransform scaleT = QTransform::fromScale(scaleFactor, scaleFactor);
+  QRect pageRect = scaleT.mapRect(boundingRect()).toAlignedRect();
+  QRect visibleRect = scaleT.mapRect(rect).toAlignedRect();
+
+  int i, imin, imax;
+  int j, jmin, jmax;
+
+  imin = (visibleRect.left() - pageRect.left()) / TILE_SIZE;
+  imax = (visibleRect.right() - pageRect.left());
+  if (imax % TILE_SIZE == 0)
+    imax /= TILE_SIZE;
+  else
+    imax = imax / TILE_SIZE + 1;
+
+  jmin = (visibleRect.top() - pageRect.top()) / TILE_SIZE;
+  jmax = (visibleRect.bottom() - pageRect.top());
+  if (jmax % TILE_SIZE == 0)
+    jmax /= TILE_SIZE;
+  else
+    jmax = jmax / TILE_SIZE + 1;
+
+  for (j = jmin; j < jmax; ++j) {
+    for (i = imin; i < imax; ++i)
+      tiles << QRect(i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE);
   }
+  return tiles;
 }
 
 // Event Handlers
@@ -2443,6 +3683,9 @@ bool PDFPageGraphicsItem::event(QEvent *event)
     //
     // Perhaps there should be a separate event for when the cache is updated.
     update();
+    PDFDocumentScene * pdfScene = qobject_cast<PDFDocumentScene*>(scene());
+    if (pdfScene)
+      pdfScene->tileAvailable();
 
     return true;
   }
@@ -2462,6 +3705,13 @@ void PDFPageGraphicsItem::addLinks(QList< QSharedPointer<Annotation::Link> > lin
 #ifdef DEBUG
   stopwatch.start();
 #endif
+  // Links may be posted more than once (e.g., links carried over from a
+  // previous version of the file before they are validated; see
+  // Backend::Page::asyncLoadLinks()), so replace any previous ones
+  foreach (QGraphicsItem * child, childItems()) {
+    if (child->type() == PDFLinkGraphicsItem::Type)
+      delete child;
+  }
   foreach( QSharedPointer<Annotation::Link> link, links ){
     PDFLinkGraphicsItem * linkItem = new PDFLinkGraphicsItem(link);
     // Map the link from pdf coordinates to scene coordinates
@@ -2475,6 +3725,13 @@ void PDFPageGraphicsItem::addLinks(QList< QSharedPointer<Annotation::Link> > lin
   update();
 }
 
+void PDFPageGraphicsItem::loadAnnotations()
+{
+  QSharedPointer<Backend::Page> page(this->page().toStrongRef());
+  if (page)
+    addAnnotations(page->loadAnnotations());
+}
+
 void PDFPageGraphicsItem::addAnnotations(QList< QSharedPointer<Annotation::AbstractAnnotation> > annotations)
 {
   PDFMarkupAnnotationGraphicsItem *markupAnnotItem;
@@ -2831,6 +4088,10 @@ PDFToCInfoWidget::PDFToCInfoWidget(QWidget * parent) :
 
   layout->addWidget(_tree);
   setLayout(layout);
+
+  _addItemsTimer.setInterval(0);
+  connect(&_addItemsTimer, SIGNAL(timeout()), this, SLOT(addPendingItems()));
+  connect(&_tocWatcher, SIGNAL(finished()), this, SLOT(tocReady()));
 }
 
 void PDFToCInfoWidget::retranslateUi()
@@ -2850,16 +4111,47 @@ void PDFToCInfoWidget::initFromDocument(const QWeakPointer<Backend::Document> ne
   PDFDocumentInfoWidget::initFromDocument(newDoc);
   
   clear();
-  QSharedPointer<Backend::Document> doc(newDoc.toStrongRef());
-  if (doc) {
-    const Backend::PDFToC data = doc->toc();
-    recursiveAddTreeItems(data, _tree->invisibleRootItem());
-  }
+  // Extracting the outline can take a while for large documents, so do it in
+  // the background. NB: setFuture() detaches the watcher from any previous
+  // (still running) extraction, so its result is ignored.
+  if (!newDoc.isNull())
+    _tocWatcher.setFuture(QtConcurrent::run(PDFToCInfoWidget::loadToC, newDoc));
+}
+
+//static
+Backend::PDFToC PDFToCInfoWidget::loadToC(QWeakPointer<Backend::Document> doc)
+{
+  QSharedPointer<Backend::Document> theDoc(doc.toStrongRef());
+  if (!theDoc)
+    return Backend::PDFToC();
+  return theDoc->cachedToC();
+}
+
+void PDFToCInfoWidget::tocReady()
+{
+  _pendingItems = _tocWatcher.result();
+  if (!_pendingItems.isEmpty())
+    _addItemsTimer.start();
+}
+
+void PDFToCInfoWidget::addPendingItems()
+{
+  Q_ASSERT(_tree != nullptr);
+  // Add a batch of top-level items (with all their children) at a time, so
+  // the GUI stays responsive even for huge outlines
+  const int batchSize = 50;
+  const int n = qMin(batchSize, _pendingItems.size());
+  recursiveAddTreeItems(_pendingItems.mid(0, n), _tree->invisibleRootItem());
+  _pendingItems.erase(_pendingItems.begin(), _pendingItems.begin() + n);
+  if (_pendingItems.isEmpty())
+    _addItemsTimer.stop();
 }
 
 void PDFToCInfoWidget::clear()
 {
   Q_ASSERT(_tree != nullptr);
+  _addItemsTimer.stop();
+  _pendingItems.clear();
   // make sure that no item is (and can be) selected while we clear the tree
   // (otherwise clearing it could trigger (numerous) itemSelectionChanged signals)
   _tree->setSelectionMode(QAbstractItemView::NoSelection);
@@ -3183,6 +4475,10 @@ PDFFontsInfoWidget::PDFFontsInfoWidget(QWidget * parent) :
 
   layout->addWidget(_table);
   setLayout(layout);
+
+  _addRowsTimer.setInterval(0);
+  connect(&_addRowsTimer, SIGNAL(timeout()), this, SLOT(addPendingRows()));
+  connect(&_fontsWatcher, SIGNAL(finished()), this, SLOT(fontsReady()));
   retranslateUi();
 }
 
@@ -3198,15 +4494,41 @@ void PDFFontsInfoWidget::reload()
   Q_ASSERT(_table != nullptr);
 
   clear();
-  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
-  if (!doc)
-    return;
+  // Scanning the document for fonts can take a long time, so do it in the
+  // background. NB: setFuture() detaches the watcher from any previous (still
+  // running) scan, so its result is ignored.
+  if (!_doc.isNull())
+    _fontsWatcher.setFuture(QtConcurrent::run(PDFFontsInfoWidget::loadFonts, _doc));
+}
 
-  QList<Backend::PDFFontInfo> fonts = doc->fonts();
-  _table->setRowCount(fonts.count());
+//static
+QList<Backend::PDFFontInfo> PDFFontsInfoWidget::loadFonts(QWeakPointer<Backend::Document> doc)
+{
+  QSharedPointer<Backend::Document> theDoc(doc.toStrongRef());
+  if (!theDoc)
+    return QList<Backend::PDFFontInfo>();
+  return theDoc->cachedFonts();
+}
 
-  int i = 0;
-  foreach (Backend::PDFFontInfo font, fonts) {
+void PDFFontsInfoWidget::fontsReady()
+{
+  _pendingFonts = _fontsWatcher.result();
+  if (!_pendingFonts.isEmpty())
+    _addRowsTimer.start();
+}
+
+void PDFFontsInfoWidget::addPendingRows()
+{
+  Q_ASSERT(_table != nullptr);
+
+  // Add a batch of rows at a time, so the GUI stays responsive even for
+  // documents with many fonts
+  const int batchSize = 100;
+  const int n = qMin(batchSize, _pendingFonts.size());
+  int i = _table->rowCount();
+  _table->setRowCount(i + n);
+
+  foreach (Backend::PDFFontInfo font, _pendingFonts.mid(0, n)) {
     _table->setItem(i, 0, new QTableWidgetItem(font.descriptor().pureName()));
     switch (font.fontType()) {
       case Backend::PDFFontInfo::FontType_Type0:
@@ -3239,6 +4561,11 @@ void PDFFontsInfoWidget::reload()
     }
     ++i;
   }
+  _pendingFonts.erase(_pendingFonts.begin(), _pendingFonts.begin() + n);
+  if (!_pendingFonts.isEmpty())
+    return;
+
+  _addRowsTimer.stop();
   _table->resizeColumnsToContents();
   _table->resizeRowsToContents();
   _table->sortItems(0);
@@ -3247,6 +4574,8 @@ void PDFFontsInfoWidget::reload()
 void PDFFontsInfoWidget::clear()
 {
   Q_ASSERT(_table != nullptr);
+  _addRowsTimer.stop();
+  _pendingFonts.clear();
   _table->clearContents();
   _table->setRowCount(0);
 }
@@ -3308,7 +4637,7 @@ void PDFPermissionsInfoWidget::reload()
     return;
   }
   
-  Backend::Document::Permissions & perm = doc->permissions();
+  Backend::Document::Permissions perm = doc->permissions();
   
   if (perm.testFlag(Backend::Document::Permission_Print)) {
     if (perm.testFlag(Backend::Document::Permission_PrintHighRes))
@@ -3406,13 +4735,10 @@ void PDFAnnotationsInfoWidget::initFromDocument(const QWeakPointer<Backend::Docu
   if (!doc || !doc->isValid())
     return;
 
-  QList< QWeakPointer<Backend::Page> > pages;
-  int i;
-  for (i = 0; i < doc->numPages(); ++i) {
-    QWeakPointer<Backend::Page> page = doc->page(i);
-    if (page)
-      pages << page;
-  }
+  // NB: The result index equals the page index (see annotationsReady())
+  QList<int> pages;
+  for (int i = 0; i < doc->numPages(); ++i)
+    pages << i;
   
   // If another search is still running, cancel it---after all, the user wants
   // to perform a new search
@@ -3422,15 +4748,15 @@ void PDFAnnotationsInfoWidget::initFromDocument(const QWeakPointer<Backend::Docu
   }
 
   clear();
-  _annotWatcher.setFuture(QtConcurrent::mapped(pages, PDFAnnotationsInfoWidget::loadAnnotations));
+  _annotWatcher.setFuture(QtConcurrent::mapped(pages, AnnotationsLoader(doc.toWeakRef())));
 }
 
-//static
-QList< QSharedPointer<Annotation::AbstractAnnotation> > PDFAnnotationsInfoWidget::loadAnnotations(QWeakPointer<Backend::Page> thePage)
+PDFAnnotationsInfoWidget::AnnotationsLoader::result_type PDFAnnotationsInfoWidget::AnnotationsLoader::operator()(const int pageNum) const
 {
-  QSharedPointer<Backend::Page> page(thePage.toStrongRef());
+  QSharedPointer<Backend::Document> theDoc(doc.toStrongRef());
+  QSharedPointer<Backend::Page> page(theDoc ? theDoc->page(pageNum).toStrongRef() : QSharedPointer<Backend::Page>());
   if (!page)
-    return QList< QSharedPointer<Annotation::AbstractAnnotation> >();
+    return result_type();
   return page->loadAnnotations();
 }
 
@@ -3448,9 +4774,9 @@ void PDFAnnotationsInfoWidget::annotationsReady(int index)
     if (!pdfAnnot || !pdfAnnot->isMarkup())
       continue;
     Annotation::Markup * annot = dynamic_cast<Annotation::Markup*>(pdfAnnot.data());
-    QSharedPointer<Backend::Page> page(annot->page().toStrongRef());
-    if (page)
-      _table->setItem(i, 0, new QTableWidgetItem(QString::number(page->pageNum() + 1)));
+    // NB: Don't rely on annot->page() as the page object may have been evicted
+    // in the meantime (see Backend::Document::setMaxResidentPages())
+    _table->setItem(i, 0, new QTableWidgetItem(QString::number(index + 1)));
     _table->setItem(i, 1, new QTableWidgetItem(annot->subject()));
     _table->setItem(i, 2, new QTableWidgetItem(annot->author()));
     _table->setItem(i, 3, new QTableWidgetItem(annot->contents()));
@@ -3472,6 +4798,409 @@ void PDFAnnotationsInfoWidget::retranslateUi()
 }
 
 
+// PDFSearchResultsInfoWidget
+// ============
+PDFSearchResultsInfoWidget::PDFSearchResultsInfoWidget(QWidget * parent) :
+  PDFDocumentInfoWidget(parent, PDFDocumentView::trUtf8("Search Results"), QString::fromLatin1("QtPDF.SearchResultsInfoWidget")),
+  _currentResult(-1)
+{
+  QVBoxLayout * layout = new QVBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  _table = new QTableWidget(this);
+
+#if defined(Q_WS_MAC) || defined(Q_OS_MAC) /* don't do this on windows, as the font ends up too small */
+  QFont f(_table->font());
+  f.setPointSize(f.pointSize() - 2);
+  _table->setFont(f);
+#endif
+  _table->setColumnCount(2);
+  _table->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+  _table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  _table->setAlternatingRowColors(true);
+  _table->setShowGrid(false);
+  _table->setSelectionBehavior(QAbstractItemView::SelectRows);
+  _table->setSelectionMode(QAbstractItemView::SingleSelection);
+  _table->verticalHeader()->hide();
+  _table->horizontalHeader()->setStretchLastSection(true);
+  _table->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft);
+
+  layout->addWidget(_table);
+  setLayout(layout);
+
+  _addRowsTimer.setInterval(0);
+  connect(&_addRowsTimer, SIGNAL(timeout()), this, SLOT(addPendingRows()));
+  connect(_table, SIGNAL(itemActivated(QTableWidgetItem*)), this, SLOT(itemActivated(QTableWidgetItem*)));
+  connect(_table, SIGNAL(itemClicked(QTableWidgetItem*)), this, SLOT(itemActivated(QTableWidgetItem*)));
+  retranslateUi();
+}
+
+void PDFSearchResultsInfoWidget::addSearchResults(const QList<Backend::SearchResult> & results)
+{
+  if (results.isEmpty())
+    return;
+  _pendingResults << results;
+  _addRowsTimer.start();
+}
+
+void PDFSearchResultsInfoWidget::addPendingRows()
+{
+  Q_ASSERT(_table != nullptr);
+
+  // Add a batch of rows at a time, so the GUI stays responsive even for
+  // searches with many results
+  const int batchSize = 100;
+  const int n = qMin(batchSize, _pendingResults.size());
+  int i = _table->rowCount();
+  _table->setRowCount(i + n);
+
+  // NB: The row equals the index of the result (see
+  // PDFDocumentView::searchResultsAdded())
+  foreach (Backend::SearchResult result, _pendingResults.mid(0, n)) {
+    _table->setItem(i, 0, new QTableWidgetItem(QString::number(result.pageNum + 1)));
+    _table->setItem(i, 1, new QTableWidgetItem(result.context));
+    ++i;
+  }
+  _pendingResults = _pendingResults.mid(n);
+  if (_pendingResults.isEmpty())
+    _addRowsTimer.stop();
+  if (_currentResult >= 0 && _currentResult < _table->rowCount() && _table->currentRow() != _currentResult)
+    _table->setCurrentCell(_currentResult, 0);
+}
+
+void PDFSearchResultsInfoWidget::setCurrentSearchResult(const int index)
+{
+  _currentResult = index;
+  if (index < 0 || index >= _table->rowCount())
+    return;
+  // NB: This doesn't emit itemActivated(), i.e., the change is not reported
+  // back to the view
+  _table->setCurrentCell(index, 0);
+  _table->scrollToItem(_table->item(index, 0));
+}
+
+void PDFSearchResultsInfoWidget::itemActivated(QTableWidgetItem * item)
+{
+  if (item)
+    emit searchResultActivated(item->row());
+}
+
+void PDFSearchResultsInfoWidget::clear()
+{
+  _addRowsTimer.stop();
+  _pendingResults.clear();
+  _currentResult = -1;
+  _table->clearContents();
+  _table->setRowCount(0);
+}
+
+void PDFSearchResultsInfoWidget::retranslateUi()
+{
+  setWindowTitle(PDFDocumentView::trUtf8("Search Results"));
+  _table->setHorizontalHeaderLabels(QStringList() << PDFDocumentView::trUtf8("Page") << PDFDocumentView::trUtf8("Context"));
+}
+
+
+// PDFThumbnailsInfoWidget
+// ============
+QString PDFThumbnailsInfoWidget::_diskCacheDir;
+qint64 PDFThumbnailsInfoWidget::_diskCacheMaxSize = 64 * 1024 * 1024;
+
+// Helpers to access the thumbnails disk cache from a background thread
+static QImage loadThumbnail(const QString & path)
+{
+  return QImage(path);
+}
+
+static void saveThumbnail(const QImage & img, const QString & dir, const QString & path)
+{
+  if (QDir().mkpath(dir))
+    img.save(path);
+}
+
+PDFThumbnailsInfoWidget::PDFThumbnailsInfoWidget(QWidget * parent) :
+  PDFDocumentInfoWidget(parent, PDFDocumentView::trUtf8("Thumbnails"), QString::fromLatin1("QtPDF.ThumbnailsInfoWidget")),
+  _needsPopulate(false)
+{
+  QVBoxLayout * layout = new QVBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  _list = new QListWidget(this);
+  _list->setViewMode(QListView::IconMode);
+  _list->setMovement(QListView::Static);
+  _list->setResizeMode(QListView::Adjust);
+  _list->setUniformItemSizes(true);
+  _list->setSelectionMode(QAbstractItemView::SingleSelection);
+  _list->setIconSize(QSize(ThumbnailSize, ThumbnailSize));
+  _list->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+
+  layout->addWidget(_list);
+  setLayout(layout);
+
+  _requestTimer.setSingleShot(true);
+  _requestTimer.setInterval(100);
+  connect(&_requestTimer, SIGNAL(timeout()), this, SLOT(requestThumbnails()));
+  connect(_list->verticalScrollBar(), SIGNAL(valueChanged(int)), &_requestTimer, SLOT(start()));
+  connect(_list, SIGNAL(itemActivated(QListWidgetItem*)), this, SLOT(itemActivated(QListWidgetItem*)));
+  connect(_list, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(itemActivated(QListWidgetItem*)));
+  connect(&_diskCacheWatcher, SIGNAL(resultReadyAt(int)), this, SLOT(diskCacheImageReady(int)));
+  // Thumbnails that are not on disk are rendered in the next round
+  connect(&_diskCacheWatcher, SIGNAL(finished()), &_requestTimer, SLOT(start()));
+  retranslateUi();
+}
+
+PDFThumbnailsInfoWidget::~PDFThumbnailsInfoWidget()
+{
+  // Make sure no more rendered thumbnails are posted to us
+  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+  if (doc)
+    doc->processingThread().cancelRequestsAndWait(this);
+  // Loading from disk doesn't involve us, so there is no need to wait here
+  _diskCacheWatcher.cancel();
+}
+
+void PDFThumbnailsInfoWidget::initFromDocument(const QWeakPointer<Backend::Document> newDoc)
+{
+  clear();
+  PDFDocumentInfoWidget::initFromDocument(newDoc);
+  // Don't spend any time on thumbnails nobody looks at
+  _needsPopulate = true;
+  if (isVisible())
+    populate();
+}
+
+void PDFThumbnailsInfoWidget::populate()
+{
+  _needsPopulate = false;
+  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+  if (!doc || !doc->isValid())
+    return;
+
+  // The backends don't expose the page contents, so the disk cache is keyed by
+  // the identity of the file (which changes whenever the file is rewritten).
+  // The path is hashed separately so the thumbnails of older versions of the
+  // same file can be found (and removed) easily.
+  QFileInfo fi(doc->fileName());
+  if (!_diskCacheDir.isEmpty() && fi.exists()) {
+    QCryptographicHash pathHash(QCryptographicHash::Sha1);
+    pathHash.addData(fi.canonicalFilePath().toUtf8());
+    QCryptographicHash versionHash(QCryptographicHash::Sha1);
+    versionHash.addData(QByteArray::number(fi.size()));
+    versionHash.addData(fi.lastModified().toString(Qt::ISODate).toLatin1());
+    const QString pathKey = QString::fromLatin1(pathHash.result().toHex());
+    _documentKey = pathKey + QString::fromLatin1("-") + QString::fromLatin1(versionHash.result().toHex());
+    QtConcurrent::run(&PDFThumbnailsInfoWidget::purgeDiskCache, _diskCacheDir, pathKey, _documentKey, _diskCacheMaxSize);
+  }
+
+  for (int i = 0; i < doc->numPages(); ++i) {
+    // Don't create the page objects just to get their sizes
+    QSizeF pageSize(doc->pageSizeF(i));
+    // Resolution at which the larger side of the page is ThumbnailSize pixels
+    // long (page sizes are in bp, i.e., 1/72 inch)
+    double dpi = (pageSize.isEmpty() ? 0 : 72. * ThumbnailSize / qMax(pageSize.width(), pageSize.height()));
+
+    // Use a blank page of the correct aspect ratio until the thumbnail arrives
+    QPixmap blank((pageSize * dpi / 72.).toSize().expandedTo(QSize(1, 1)));
+    blank.fill(Qt::white);
+
+    QListWidgetItem * item = new QListWidgetItem(QIcon(blank), QString::number(i + 1), _list);
+    item->setData(ResolutionRole, dpi);
+    item->setData(HasThumbnailRole, false);
+    item->setData(DiskCacheCheckedRole, _documentKey.isEmpty());
+    item->setTextAlignment(Qt::AlignHCenter);
+  }
+  requestThumbnails();
+}
+
+void PDFThumbnailsInfoWidget::clear()
+{
+  _requestTimer.stop();
+  cancelRequests();
+  _diskCacheWatcher.cancel();
+  _diskCachePages.clear();
+  _documentKey.clear();
+  _needsPopulate = false;
+  _list->clear();
+}
+
+void PDFThumbnailsInfoWidget::retranslateUi()
+{
+  setWindowTitle(PDFDocumentView::trUtf8("Thumbnails"));
+}
+
+void PDFThumbnailsInfoWidget::setCurrentPage(const int pageNum)
+{
+  QListWidgetItem * item = _list->item(pageNum);
+  if (!item)
+    return;
+  _list->setCurrentItem(item);
+  _list->scrollToItem(item);
+}
+
+void PDFThumbnailsInfoWidget::itemActivated(QListWidgetItem * item)
+{
+  if (item)
+    emit pageActivated(_list->row(item));
+}
+
+void PDFThumbnailsInfoWidget::cancelRequests()
+{
+  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+  if (doc)
+    doc->processingThread().cancelRequests(this);
+}
+
+void PDFThumbnailsInfoWidget::requestThumbnails()
+{
+  QSharedPointer<Backend::Document> doc(_doc.toStrongRef());
+  if (!doc || !isVisible())
+    return;
+
+  const QRect visibleRect(_list->viewport()->rect());
+  const int margin = THUMBNAIL_PREFETCH_VIEWPORTS * visibleRect.height();
+  const QRect prefetchRect(visibleRect.adjusted(0, -margin, 0, margin));
+
+  // Requeue the missing thumbnails around the visible ones so that the
+  // visible ones come first. As the work stack is processed last-in-first-out,
+  // they need to be added last (and in reverse order, to proceed from the
+  // top). Requests for thumbnails that are out of range by now are dropped
+  // (without waiting for the one that may be in progress; its result is simply
+  // used when it arrives).
+  doc->processingThread().cancelRequests(this);
+  QList<int> hidden, visible;
+  QStringList diskCacheFiles;
+  QList<int> diskCachePages;
+  for (int i = _list->count() - 1; i >= 0; --i) {
+    QListWidgetItem * item = _list->item(i);
+    if (item->data(HasThumbnailRole).toBool())
+      continue;
+    const QRect itemRect(_list->visualItemRect(item));
+    if (!itemRect.intersects(prefetchRect))
+      continue;
+    // Try the disk cache first; what is not found there is rendered once
+    // loading has finished (see diskCacheImageReady())
+    if (!item->data(DiskCacheCheckedRole).toBool()) {
+      diskCacheFiles.prepend(diskCacheFile(i));
+      diskCachePages.prepend(i);
+      continue;
+    }
+    if (itemRect.intersects(visibleRect))
+      visible << i;
+    else
+      hidden << i;
+  }
+
+  // Don't interrupt loading from disk; if anything else needs to be loaded, it
+  // is picked up in the next round (see the ctor)
+  if (!diskCacheFiles.isEmpty() && _diskCacheWatcher.isFinished()) {
+    _diskCachePages = diskCachePages;
+    _diskCacheWatcher.setFuture(QtConcurrent::mapped(diskCacheFiles, loadThumbnail));
+  }
+
+  foreach (int i, hidden + visible) {
+    QSharedPointer<Backend::Page> page(doc->page(i).toStrongRef());
+    double dpi = _list->item(i)->data(ResolutionRole).toDouble();
+    if (page && dpi > 0)
+      page->asyncRenderThumbnail(this, dpi, dpi);
+  }
+}
+
+void PDFThumbnailsInfoWidget::diskCacheImageReady(int index)
+{
+  // Ignore results that are no longer needed (e.g., because they were posted
+  // before the document changed)
+  if (index < 0 || index >= _diskCachePages.size())
+    return;
+  QListWidgetItem * item = _list->item(_diskCachePages[index]);
+  if (!item)
+    return;
+  item->setData(DiskCacheCheckedRole, true);
+  const QImage img(_diskCacheWatcher.resultAt(index));
+  if (!img.isNull() && !item->data(HasThumbnailRole).toBool())
+    setThumbnail(item, img);
+}
+
+void PDFThumbnailsInfoWidget::setThumbnail(QListWidgetItem * item, const QImage & img)
+{
+  item->setIcon(QIcon(QPixmap::fromImage(img)));
+  item->setData(HasThumbnailRole, true);
+}
+
+QString PDFThumbnailsInfoWidget::diskCacheFile(const int pageNum) const
+{
+  return QDir(_diskCacheDir).absoluteFilePath(QString::fromLatin1("%1-%2-%3.png").arg(_documentKey).arg(pageNum).arg(static_cast<int>(ThumbnailSize)));
+}
+
+void PDFThumbnailsInfoWidget::purgeDiskCache(const QString & dir, const QString & pathKey, const QString & documentKey, const qint64 maxSize)
+{
+  const QString pathPrefix(pathKey + QString::fromLatin1("-"));
+  const QString documentPrefix(documentKey + QString::fromLatin1("-"));
+  // Oldest first
+  const QFileInfoList files = QDir(dir).entryInfoList(QStringList(QString::fromLatin1("*.png")), QDir::Files, QDir::Time | QDir::Reversed);
+
+  QFileInfoList candidates;
+  qint64 totalSize = 0;
+  foreach (const QFileInfo & fi, files) {
+    if (fi.fileName().startsWith(pathPrefix) && !fi.fileName().startsWith(documentPrefix)) {
+      QFile::remove(fi.absoluteFilePath());
+      continue;
+    }
+    totalSize += fi.size();
+    // Keep the thumbnails of the document that is being opened
+    if (!fi.fileName().startsWith(documentPrefix))
+      candidates << fi;
+  }
+  if (maxSize <= 0)
+    return;
+  foreach (const QFileInfo & fi, candidates) {
+    if (totalSize <= maxSize)
+      break;
+    if (QFile::remove(fi.absoluteFilePath()))
+      totalSize -= fi.size();
+  }
+}
+
+bool PDFThumbnailsInfoWidget::event(QEvent * event)
+{
+  if (event && event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+    event->accept();
+    const Backend::PDFPageRenderedEvent * renderedEvent = dynamic_cast<const Backend::PDFPageRenderedEvent*>(event);
+    QListWidgetItem * item = _list->item(renderedEvent->page_num);
+    // Discard results that are no longer needed (e.g., because they were
+    // posted before the document changed)
+    if (!item || item->data(HasThumbnailRole).toBool() || renderedEvent->rendered_page.isNull() || \
+        !qFuzzyCompare(item->data(ResolutionRole).toDouble(), renderedEvent->xres))
+      return true;
+    setThumbnail(item, renderedEvent->rendered_page);
+    if (!_documentKey.isEmpty())
+      QtConcurrent::run(saveThumbnail, renderedEvent->rendered_page, _diskCacheDir, diskCacheFile(renderedEvent->page_num));
+    return true;
+  }
+  return PDFDocumentInfoWidget::event(event);
+}
+
+void PDFThumbnailsInfoWidget::showEvent(QShowEvent * event)
+{
+  PDFDocumentInfoWidget::showEvent(event);
+  if (_needsPopulate)
+    populate();
+  else
+    _requestTimer.start();
+}
+
+void PDFThumbnailsInfoWidget::hideEvent(QHideEvent * event)
+{
+  PDFDocumentInfoWidget::hideEvent(event);
+  _requestTimer.stop();
+  cancelRequests();
+}
+
+void PDFThumbnailsInfoWidget::resizeEvent(QResizeEvent * event)
+{
+  PDFDocumentInfoWidget::resizeEvent(event);
+  // More (or other) thumbnails may have become visible
+  _requestTimer.start();
+}
+
+
 // PDFActionEvent
 // ============
 
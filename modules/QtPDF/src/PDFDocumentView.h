@@ -32,6 +32,51 @@ class PDFDocumentView;
 
 const int TILE_SIZE=1024;
 
+// Requests the tiles that are about to be scrolled into a PDFDocumentView in
+// the background. The scroll velocity is tracked (see scrolled()) and
+// everything the view will reach within a short time at that velocity is
+// prefetched, so the look-ahead grows with the scrolling speed. The
+// prefetcher is also the listener of its requests, so they can be cancelled
+// (e.g., if the user reverses the direction) without affecting the requests
+// of the page items.
+class PDFScrollPrefetcher : public QObject
+{
+  Q_OBJECT
+  typedef QObject Super;
+
+public:
+  PDFScrollPrefetcher(PDFDocumentView * view);
+  virtual ~PDFScrollPrefetcher();
+
+  // To be called whenever the contents of the view have been scrolled
+  void scrolled();
+
+public slots:
+  // Cancels all pending prefetches and forgets the current velocity (e.g., if
+  // the zoom level or the document changes)
+  void cancel();
+
+protected slots:
+  void prefetch();
+
+protected:
+  // Repaints the page items once the prefetched tiles have been rendered (as
+  // they don't request tiles that are pending, they are not notified)
+  bool event(QEvent * event);
+
+  PDFDocumentView * _view;
+  // The document the pending requests were issued to
+  QWeakPointer<Backend::Document> _document;
+  // Measures the time between scroll steps
+  QElapsedTimer _clock;
+  // Center of the view (in scene coordinates) at the last scroll step
+  QPointF _lastCenter;
+  // Smoothed scroll velocity (in scene units per ms)
+  QPointF _velocity;
+  // Throttles prefetching while scrolling
+  QTimer _prefetchTimer;
+};
+
 class PDFDocumentView : public QGraphicsView {
   Q_OBJECT
   typedef QGraphicsView Super;
@@ -42,12 +87,27 @@ class PDFDocumentView : public QGraphicsView {
   int _currentPage, _lastPage;
 
   QString _searchString;
-  QList<QGraphicsItem *> _searchResults;
+  // All results of the current search (in the order they were found)
+  QList<Backend::SearchResult> _searchResults;
+  // Maps page numbers to the indices (into _searchResults) of their results
+  QHash<int, QList<int> > _searchResultsByPage;
+  // Highlights are only created for results on visible pages (and the current
+  // result), so documents with thousands of matches don't clog the scene;
+  // maps indices (into _searchResults) to the highlights
+  QHash<int, QGraphicsPathItem *> _searchResultItems;
+  QTimer _searchHighlightTimer;
   QFutureWatcher< QList<Backend::SearchResult> > _searchResultWatcher;
+  // Shared by all pages of the currently running search (if any)
+  Backend::AbortToken _searchAbortToken;
   int _currentSearchResult;
+  // Flags the current search was run with. The context of the results (see
+  // Backend::Search_WithContext) is only extracted while a search results dock
+  // is visible, as it is not shown anywhere else.
+  Backend::SearchFlags _searchFlags;
+  QList< QPointer<QDockWidget> > _searchResultsDocks;
   QBrush _searchResultHighlightBrush;
   QBrush _currentSearchResultHighlightBrush;
-  bool _useGrayScale;
+  Backend::PDFPageColorFilter _pageColorFilter;
 
   friend class DocumentTool::AbstractTool;
   friend class DocumentTool::Select;
@@ -55,16 +115,26 @@ class PDFDocumentView : public QGraphicsView {
 public:
   enum PageMode { PageMode_SinglePage, PageMode_OneColumnContinuous, PageMode_TwoColumnContinuous, PageMode_Presentation };
   enum MouseMode { MouseMode_MagnifyingGlass, MouseMode_Move, MouseMode_MarqueeZoom, MouseMode_Measure, MouseMode_Select };
-  enum Dock { Dock_TableOfContents, Dock_MetaData, Dock_Fonts, Dock_Permissions, Dock_Annotations };
+  enum Dock { Dock_TableOfContents, Dock_MetaData, Dock_Fonts, Dock_Permissions, Dock_Annotations, Dock_Thumbnails, Dock_SearchResults };
 
   PDFDocumentView(QWidget *parent = nullptr);
   ~PDFDocumentView();
   void setScene(QSharedPointer<PDFDocumentScene> a_scene);
+  // Like setScene(), but for a scene showing a new version of the current
+  // document (e.g., after it was regenerated): the new scene is laid out and
+  // the tiles that will be visible are rendered in the background while the
+  // current scene stays on screen. Only then are the scenes swapped, keeping
+  // the position in the current page and the zoom level. If rendering takes
+  // too long, the scenes are swapped anyway. Highlights and searches that are
+  // added in the meantime swap the scenes right away, as they must go to the
+  // new scene.
+  void replaceScene(QSharedPointer<PDFDocumentScene> a_scene);
   int currentPage();
   int lastPage();
   PageMode pageMode() const { return _pageMode; }
   qreal zoomLevel() const { return _zoomLevel; }
-  bool useGrayScale() const { return _useGrayScale; }
+  bool useGrayScale() const { return _pageColorFilter.type() == Backend::PDFPageColorFilter::Filter_GrayScale; }
+  Backend::PDFPageColorFilter pageColorFilter() const { return _pageColorFilter; }
   void fitInView(const QRectF & rect, Qt::AspectRatioMode aspectRatioMode = Qt::IgnoreAspectRatio);
   const QWeakPointer<QtPDF::Backend::Document> document() const;
   QString selectedText() const;
@@ -88,6 +158,25 @@ public:
     return addHighlightPath(page, path, QBrush(color), pen);
   }
 
+  // Returns the full-page image of page `pageNum` for presentation mode. The
+  // current, the previous and the next slide are kept pre-rendered (in the
+  // background) in a dedicated cache, so changing slides usually is a mere
+  // blit. If the image is not available, it is rendered synchronously (we
+  // don't want "rendering" to show up during presentations).
+  QImage presentationSlide(const int pageNum, const double xres, const double yres);
+  // Requests a repaint for the next frame of a running page transition (at
+  // most one per display refresh)
+  void scheduleTransitionFrame();
+  // Returns true while a continuous zoom gesture (e.g., Ctrl+wheel or pinching)
+  // is in progress. Pages then merely scale the tiles they have at
+  // zoomGestureBaseScale() (the scale factor at which tiles were last
+  // requested) until the zoom level has settled.
+  bool isZoomGestureActive() const { return _zoomGestureActive; }
+  // Whether an overlay with the statistics of the render pipeline (see
+  // Backend::RenderStatistics) is shown in the top left corner of the view
+  bool isRenderStatisticsOverlayVisible() const { return _renderStatisticsOverlayVisible; }
+  qreal zoomGestureBaseScale() const { return _zoomGestureBaseScale; }
+
   QBrush searchResultHighlightBrush() const { return _searchResultHighlightBrush; }
   void setSearchResultHighlightBrush(const QBrush & brush);
 
@@ -125,7 +214,8 @@ public slots:
   void setMouseModeSelect() { setMouseMode(MouseMode_Select); }
   void setMagnifierShape(const DocumentTool::MagnifyingGlass::MagnifierShape shape);
   void setMagnifierSize(const int size);
-  void setUseGrayScale(const bool grayScale = true) { _useGrayScale = grayScale; }
+  void setUseGrayScale(const bool grayScale = true) { setPageColorFilter(grayScale ? Backend::PDFPageColorFilter::Filter_GrayScale : Backend::PDFPageColorFilter::Filter_None); }
+  void setPageColorFilter(const Backend::PDFPageColorFilter & filter);
 
   void zoomBy(const qreal zoomFactor, const QGraphicsView::ViewportAnchor anchor = QGraphicsView::AnchorViewCenter);
   void zoomIn(const QGraphicsView::ViewportAnchor anchor = QGraphicsView::AnchorViewCenter);
@@ -140,10 +230,17 @@ public slots:
   void search(QString searchText, Backend::SearchFlags flags = Backend::Search_CaseInsensitive);
   void nextSearchResult();
   void previousSearchResult();
+  // `index` refers to the order in which results are reported by
+  // searchResultsAdded()
+  void goToSearchResult(const int index);
   void clearSearchResults();
 
   void armTool(const DocumentTool::AbstractTool::Type toolType);
   void disarmTool();
+  // Showing the overlay enables the collection of render statistics for the
+  // document (hiding it does not disable it again, as someone else might rely
+  // on it)
+  void setRenderStatisticsOverlayVisible(const bool visible);
 
 signals:
   void changedPage(int pageNum);
@@ -152,9 +249,18 @@ signals:
   // emitted, e.g., if a new document was loaded, or if the existing document
   // has changed (e.g., if it was unlocked)
   void changedDocument(const QWeakPointer<QtPDF::Backend::Document> newDoc);
+  // Like changedDocument(), but only emitted once the first rendered tile of
+  // the new document is shown (or after a short delay), for things that
+  // should not compete with showing it (e.g., the docks)
+  void changedDocumentDeferred(const QWeakPointer<QtPDF::Backend::Document> newDoc);
 
   void searchProgressChanged(int percent, int occurrences);
   void searchResultHighlighted(const int pageNum, const QList<QPolygonF> region);
+  // Emitted (possibly several times per search) as results become available;
+  // the results are numbered consecutively in the order they are reported
+  void searchResultsAdded(const QList<QtPDF::Backend::SearchResult> & results);
+  void searchResultsCleared();
+  void currentSearchResultChanged(const int index);
   void textSelectionChanged(const bool isTextSelected);
 
   void requestOpenUrl(const QUrl url);
@@ -172,7 +278,10 @@ protected:
   void mouseReleaseEvent(QMouseEvent * event);
   void wheelEvent(QWheelEvent * event);
   void changeEvent(QEvent * event);
-  
+  bool event(QEvent * event);
+  bool viewportEvent(QEvent * event);
+  void scrollContentsBy(int dx, int dy);
+
   // Maybe this will become public later on
   // Ownership of tool is transferred to PDFDocumentView
   void registerTool(DocumentTool::AbstractTool * tool);
@@ -181,6 +290,13 @@ protected:
 
   void armTool(DocumentTool::AbstractTool * tool);
 
+  // Like addHighlightPath(), but always adds the highlight to the current
+  // scene (even while replaceScene() is preparing a new one)
+  QGraphicsPathItem * createHighlightPath(const unsigned int page, const QPainterPath & path, const QBrush & brush, const QPen & pen);
+  // Returns the highlight of search result `index`, creating it if necessary
+  QGraphicsPathItem * searchResultItem(const int index);
+  bool isSearchResultsDockVisible() const;
+
 protected slots:
   void maybeUpdateSceneRect();
   void maybeArmTool(uint modifiers);
@@ -192,9 +308,19 @@ protected slots:
   void goToPage(const PDFPageGraphicsItem * page, const QPointF anchor, const int alignment = Qt::AlignHCenter | Qt::AlignVCenter);
   void searchResultReady(int index);
   void searchProgressValueChanged(int progressValue);
+  // Reruns the current search with context if it was run without (i.e., while
+  // no search results dock was visible)
+  void searchResultsDockVisibilityChanged(bool visible);
+  // Creates the highlights of search results on visible pages and removes
+  // those of pages that are no longer visible
+  void updateSearchResultHighlights();
   void switchInterfaceLocale(const QLocale & newLocale);
   void reinitializeFromScene();
   void notifyTextSelectionChanged();
+  void endZoomGesture();
+  void startDeferredDocumentChange();
+  void finishDeferredDocumentChange();
+  void finishReplaceScene();
 
 private:
   PageMode _pageMode;
@@ -205,12 +331,47 @@ private:
   QMap<uint, DocumentTool::AbstractTool*> _toolAccessors;
 
   QStack<PDFDestination> _oldViewRects;
+
+  // Dedicated cache for presentation mode (see presentationSlide()); the image
+  // is null while the slide is being rendered in the background
+  struct PresentationSlide {
+    double xres, yres;
+    QImage image;
+  };
+  QMap<int, PresentationSlide> _presentationSlides;
+  QTimer _transitionFrameTimer;
+  // Restarted on every step of a zoom gesture; fires once the zoom level has
+  // been stable for a short while (see zoomByGesture())
+  QTimer _zoomGestureTimer;
+  bool _zoomGestureActive;
+  qreal _zoomGestureBaseScale;
+  bool _renderStatisticsOverlayVisible;
+  // Periodically refreshes the render statistics overlay while it is shown
+  QTimer _renderStatisticsTimer;
+  // Emits changedDocumentDeferred() if the first pixel takes too long
+  QTimer _deferredDocumentChangeTimer;
+  bool _deferredDocumentChangePending;
+  PDFScrollPrefetcher _scrollPrefetcher;
+  // The scene replaceScene() is preparing (if any)
+  QSharedPointer<PDFDocumentScene> _pendingScene;
+  QTimer _sceneReplaceTimer;
+  void paintRenderStatisticsOverlay();
+  // Like zoomBy(), but for the (many, small) steps of a continuous zoom
+  // gesture: rendering at the new resolution is deferred until the gesture
+  // settles and pending renders at the old resolution are cancelled
+  void zoomByGesture(const qreal zoomFactor, const QGraphicsView::ViewportAnchor anchor);
+  void prefetchPresentationSlides(const int pageNum, const double xres, const double yres);
+  // Drops all pre-rendered slides and cancels pending background renders
+  void clearPresentationSlides();
   
   static QTranslator * _translator;
   static QString _translatorLanguage;
 
   // Never try to set a vanilla QGraphicsScene, always use a PDFGraphicsScene.
   void setScene(QGraphicsScene *scene);
+  // Connects the view to `a_scene` (without changing the view's position or
+  // zoom; see setScene())
+  void attachScene(QSharedPointer<PDFDocumentScene> a_scene);
   // Parent class has no copy constructor.
   Q_DISABLE_COPY(PDFDocumentView)
 };
@@ -225,8 +386,16 @@ class PDFDocumentMagnifierView : public QGraphicsView {
   DocumentTool::MagnifyingGlass::MagnifierShape _shape;
   int _size;
 
+  // Magnified tiles are kept in a (small) cache of their own so that moving
+  // the magnifier around doesn't evict the tiles of the parent view from the
+  // document's page cache
+  Backend::PDFPageCache _tileCache;
+  // The document the tiles in _tileCache were requested from
+  QWeakPointer<Backend::Document> _tileDocument;
+
 public:
   PDFDocumentMagnifierView(PDFDocumentView *parent = nullptr);
+  ~PDFDocumentMagnifierView();
   // the zoom factor multiplies the parent view's _zoomLevel
   void setZoomFactor(const qreal zoomFactor);
   void setPosition(const QPoint pos);
@@ -242,9 +411,28 @@ public:
 
   QPixmap& dropShadow();
 
+  // Returns the magnified tile `tile` of `page` from the magnifier's own tile
+  // cache. If it is not available, it is rendered in the background and a
+  // placeholder (scaled from whatever the document's page cache holds) is
+  // returned.
+  QSharedPointer<QImage> getTileImage(QSharedPointer<Backend::Page> page, const double xres, const double yres, const QRect & tile, const Backend::PDFPageColorFilter & colorFilter);
+  // Requests the tiles around the magnifier's current position in the
+  // background, looking ahead in the direction of `motion` (in parent view
+  // coordinates), so they are ready by the time the magnifier gets there.
+  void prefetchTiles(const QPoint & motion = QPoint());
+
+public slots:
+  // Cancels all pending background renders and discards all magnified tiles
+  void clearTileCache();
+
 protected:
   void wheelEvent(QWheelEvent * event) { event->ignore(); }
   void paintEvent(QPaintEvent * event);
+  bool event(QEvent * event);
+
+  // Requests the tile described by `key` in the background unless it is
+  // already available or pending
+  void requestTile(QSharedPointer<Backend::Page> page, const Backend::PDFPageTile & key);
   
   QPixmap _dropShadow;
 };
@@ -289,10 +477,18 @@ signals:
   void actionTriggered(const QtPDF::PDFAction*);
 private slots:
   void itemSelectionChanged();
+  void tocReady();
+  void addPendingItems();
 private:
+  static Backend::PDFToC loadToC(QWeakPointer<Backend::Document> doc);
   static void recursiveAddTreeItems(const QList<Backend::PDFToCItem> & tocItems, QTreeWidgetItem * parentTreeItem);
   static void recursiveClearTreeItems(QTreeWidgetItem * parent);
   QTreeWidget * _tree;
+  // The ToC is extracted in the background and added to the tree in batches
+  // of top-level items (see addPendingItems())
+  QFutureWatcher<Backend::PDFToC> _tocWatcher;
+  Backend::PDFToC _pendingItems;
+  QTimer _addItemsTimer;
 };
 
 class PDFMetaDataInfoWidget : public PDFDocumentInfoWidget
@@ -336,13 +532,22 @@ protected slots:
   void clear();
   virtual void retranslateUi();
   void reload();
+private slots:
+  void fontsReady();
+  void addPendingRows();
 protected:
   virtual void showEvent(QShowEvent * event) {
     Q_UNUSED(event)
     initFromDocument(_doc);
   }
 private:
+  static QList<Backend::PDFFontInfo> loadFonts(QWeakPointer<Backend::Document> doc);
   QTableWidget * _table;
+  // The fonts are extracted in the background and added to the table in
+  // batches (see addPendingRows())
+  QFutureWatcher< QList<Backend::PDFFontInfo> > _fontsWatcher;
+  QList<Backend::PDFFontInfo> _pendingFonts;
+  QTimer _addRowsTimer;
 };
 
 class PDFPermissionsInfoWidget : public PDFDocumentInfoWidget
@@ -372,7 +577,16 @@ class PDFAnnotationsInfoWidget : public PDFDocumentInfoWidget
   QFutureWatcher< QList< QSharedPointer<Annotation::AbstractAnnotation> > > _annotWatcher;
   QTableWidget * _table;
 
-  static QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations(QWeakPointer<Backend::Page> thePage);
+  // Loads the annotations of one page (in a background thread); the page
+  // objects are created there, too, so the GUI is not held up by them
+  struct AnnotationsLoader
+  {
+    typedef QList< QSharedPointer<Annotation::AbstractAnnotation> > result_type;
+    QWeakPointer<Backend::Document> doc;
+
+    AnnotationsLoader(const QWeakPointer<Backend::Document> & doc) : doc(doc) { }
+    result_type operator()(const int pageNum) const;
+  };
 
 public:
   PDFAnnotationsInfoWidget(QWidget * parent);
@@ -385,6 +599,111 @@ protected slots:
   void annotationsReady(int index);
 };
 
+// Lists the results of the current search of a PDFDocumentView (with page
+// number and the surrounding text) while they are found. Rows are added in
+// batches so the GUI stays responsive even for thousands of results.
+class PDFSearchResultsInfoWidget : public PDFDocumentInfoWidget
+{
+  Q_OBJECT
+
+public:
+  PDFSearchResultsInfoWidget(QWidget * parent);
+  virtual ~PDFSearchResultsInfoWidget() { }
+
+public slots:
+  void addSearchResults(const QList<QtPDF::Backend::SearchResult> & results);
+  void setCurrentSearchResult(const int index);
+
+signals:
+  void searchResultActivated(int index);
+
+protected slots:
+  void clear();
+  virtual void retranslateUi();
+private slots:
+  void addPendingRows();
+  void itemActivated(QTableWidgetItem * item);
+private:
+  QTableWidget * _table;
+  QList<Backend::SearchResult> _pendingResults;
+  QTimer _addRowsTimer;
+  // The result to select once its row has been added (or -1)
+  int _currentResult;
+};
+
+// Shows a small image of each page. Thumbnails are rendered at low resolution
+// and with low priority (see Backend::Page::asyncRenderThumbnail()), so they
+// don't compete with the rendering of the main view. Nothing is done while the
+// widget is hidden, and only the thumbnails around the visible ones are
+// requested.
+class PDFThumbnailsInfoWidget : public PDFDocumentInfoWidget
+{
+  Q_OBJECT
+
+public:
+  PDFThumbnailsInfoWidget(QWidget * parent);
+  virtual ~PDFThumbnailsInfoWidget();
+
+  // If set, thumbnails are also stored in (and loaded from) `dir`, so they are
+  // available immediately the next time the (unchanged) document is opened.
+  // An empty string (the default) disables the disk cache.
+  static QString diskCacheDirectory() { return _diskCacheDir; }
+  static void setDiskCacheDirectory(const QString & dir) { _diskCacheDir = dir; }
+  // Maximum size (in bytes) of the disk cache; if it is exceeded, the oldest
+  // thumbnails are removed (see purgeDiskCache())
+  static qint64 diskCacheMaxSize() { return _diskCacheMaxSize; }
+  static void setDiskCacheMaxSize(const qint64 bytes) { _diskCacheMaxSize = bytes; }
+
+public slots:
+  void setCurrentPage(const int pageNum);
+
+signals:
+  void pageActivated(int pageNum);
+
+protected slots:
+  void initFromDocument(const QWeakPointer<QtPDF::Backend::Document> newDoc);
+  void clear();
+  virtual void retranslateUi();
+private slots:
+  void requestThumbnails();
+  void itemActivated(QListWidgetItem * item);
+  void diskCacheImageReady(int index);
+protected:
+  bool event(QEvent * event);
+  void showEvent(QShowEvent * event);
+  void hideEvent(QHideEvent * event);
+  void resizeEvent(QResizeEvent * event);
+private:
+  enum { ThumbnailSize = 96 };
+  enum { ResolutionRole = Qt::UserRole, HasThumbnailRole, DiskCacheCheckedRole };
+
+  void populate();
+  void cancelRequests();
+  void setThumbnail(QListWidgetItem * item, const QImage & img);
+  QString diskCacheFile(const int pageNum) const;
+  // Runs in a background thread: removes all thumbnails in `dir` that belong
+  // to an older version of the file identified by `pathKey` (i.e., that don't
+  // start with `documentKey`), and then the oldest ones until the cache is no
+  // larger than `maxSize`
+  static void purgeDiskCache(const QString & dir, const QString & pathKey, const QString & documentKey, const qint64 maxSize);
+
+  QListWidget * _list;
+  // Collects scrolling etc. so visible thumbnails can be requested first
+  QTimer _requestTimer;
+  // Whether the list still needs to be filled for the current document (which
+  // is deferred until the widget is shown)
+  bool _needsPopulate;
+  // Identifies the document in the disk cache; consists of a key for the path
+  // and one for the version of the file (see populate())
+  QString _documentKey;
+  // Loads thumbnails from the disk cache in the background; _diskCachePages
+  // holds the page numbers corresponding to the results
+  QFutureWatcher<QImage> _diskCacheWatcher;
+  QList<int> _diskCachePages;
+  static QString _diskCacheDir;
+  static qint64 _diskCacheMaxSize;
+};
+
 // Cannot use QGraphicsGridLayout and similar classes for pages because it only
 // works for QGraphicsLayoutItem (i.e., QGraphicsWidget)
 class PDFPageLayout : public QObject {
@@ -449,8 +768,29 @@ class PDFDocumentScene : public QGraphicsScene
   int _lastPage;
   PDFPageLayout _pageLayout;
   QFileSystemWatcher _fileWatcher;
+  // Whether the file should be watched; QFileSystemWatcher drops files that
+  // are removed (e.g., before being written anew), so it may not be watched
+  // at the moment (see checkFileStability())
+  bool _watchForDocumentChangesOnDisk;
+  // Drives checkFileStability() after the file changed on disk
   QTimer _reloadTimer;
+  // Started with the first change noticed since the last reload
+  QElapsedTimer _reloadWaitTimer;
+  int _reloadCheckInterval;
+  // Size and modification time of the file at the last check
+  qint64 _reloadFileSize;
+  QDateTime _reloadFileModified;
   double _dpiX, _dpiY;
+  // Sizes (in pt) of all pages; entries of pages that have not been measured,
+  // yet (see measurePages()) are estimates
+  QVector<QSizeF> _pageSizes;
+  int _nextPageToMeasure;
+  QTimer _measureTimer;
+  // See timeToFirstPixel()
+  QElapsedTimer _openTimer;
+  qint64 _timeToFirstPixel;
+  // Number of tiles requested by prerender() that have not arrived, yet
+  int _pendingPrerenderTiles;
 
   void handleActionEvent(const PDFActionEvent * action_event);
 
@@ -472,7 +812,7 @@ public:
   void showOnePage(const PDFPageGraphicsItem * page);
   void showAllPages();
 
-  bool watchForDocumentChangesOnDisk() const { return _fileWatcher.files().size() > 0; }
+  bool watchForDocumentChangesOnDisk() const { return _watchForDocumentChangesOnDisk; }
   void setWatchForDocumentChangesOnDisk(const bool doWatch = true);
 
   int lastPage();
@@ -481,11 +821,37 @@ public:
 
   void setResolution(const double dpiX, const double dpiY);
 
+  // Time (in ms) from opening or reloading the document until the first
+  // rendered tile could be shown, or -1 if that hasn't happened, yet
+  qint64 timeToFirstPixel() const { return _timeToFirstPixel; }
+  // Makes timeToFirstPixel() count from the time `timer` was started (e.g.,
+  // before the document was loaded) instead of from the creation of the scene
+  void setOpenTimer(const QElapsedTimer & timer) { _openTimer = timer; }
+  // Called by the page items whenever a rendered tile (i.e., not a
+  // placeholder) is available for display
+  void tileAvailable();
+
+  // Uses the page sizes of `other` (usually, the scene of the previous version
+  // of the document) as estimates for the pages that have not been measured,
+  // yet (see reinitializeScene())
+  void adoptPageSizes(const PDFDocumentScene & other);
+  // Determines the actual sizes of the pages `first` to `last` right away
+  void measurePageRange(const int first, const int last);
+  // Requests the tiles of the part `rect` (in scene coordinates) of the scene
+  // as seen at `scaleFactor` in the background, e.g., so they are available
+  // before the scene is shown (see PDFDocumentView::replaceScene()).
+  // prerenderingFinished() is emitted once all of them have been rendered.
+  // Returns the number of tiles requested (tiles that are available or
+  // pending already are not requested again).
+  int prerender(const QRectF & rect, const qreal scaleFactor, const Backend::PDFPageColorFilter & colorFilter);
+
 signals:
   void pageChangeRequested(int pageNum);
   void pageLayoutChanged();
   void pdfActionTriggered(const QtPDF::PDFAction * action);
   void documentChanged(const QWeakPointer<QtPDF::Backend::Document> doc);
+  void firstPixelAvailable(qint64 msecs);
+  void prerenderingFinished();
 
 public slots:
   void doUnlockDialog();
@@ -496,6 +862,12 @@ protected slots:
   void pageLayoutChanged(const QRectF& sceneRect);
   void reinitializeScene();
   void finishUnlock();
+  // Determines the actual sizes of a batch of pages (see reinitializeScene())
+  void measurePages();
+  void fileChangedOnDisk();
+  // Reloads the document once the file has stopped changing and looks
+  // complete (see fileChangedOnDisk())
+  void checkFileStability();
 
 protected:
   // Used in non-continuous mode to keep track of currently shown page across
@@ -513,6 +885,13 @@ private:
   // hold some information in an `auto_ptr` which does interesting things on
   // copy that C++ newbies may not expect.
   Q_DISABLE_COPY(PDFDocumentScene)
+
+  // Reinitializes all scenes showing _doc (which may be shared, see
+  // BackendInterface::sharedDocument()) after it changed
+  void reinitializeSharingScenes();
+
+  // All existing scenes (only accessed from the GUI thread)
+  static QList<PDFDocumentScene*> _allScenes;
 };
 
 
@@ -525,7 +904,9 @@ class PDFPageGraphicsItem : public QGraphicsObject
   Q_OBJECT
   typedef QGraphicsObject Super;
 
-  QWeakPointer<Backend::Page> _page;
+  // NB: The document may evict the page object at any time (see
+  // Backend::Document::setMaxResidentPages()); use page() to access it
+  mutable QWeakPointer<Backend::Page> _page;
 
   double _dpiX;
   double _dpiY;
@@ -539,14 +920,23 @@ class PDFPageGraphicsItem : public QGraphicsObject
   QTransform _pageScale, _pointScale;
   qreal _zoomLevel;
 
+  // Placeholders for the tiles that are missing at the base resolution of the
+  // current zoom gesture (see paint()), keyed by the tiles' top left corners
+  QMap<QPair<int, int>, QImage> _gesturePlaceholders;
+  // Base scale and color filter _gesturePlaceholders were built for
+  qreal _gesturePlaceholderScale;
+  Backend::PDFPageColorFilter _gesturePlaceholderFilter;
+
   friend class PageProcessingRenderPageRequest;
   friend class PageProcessingLoadLinksRequest;
 //  friend class PDFPageLayout;
 
-  static void imageToGrayScale(QImage & img);
-
 public:
   PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, const double dpiX, const double dpiY, QGraphicsItem *parent = nullptr);
+  // Creates the item for page `pageNum` of the scene's document without
+  // creating the page object (which happens once it is needed); `pageSize` (in
+  // pt) may be an estimate that is corrected later with setPageSize()
+  PDFPageGraphicsItem(const int pageNum, const QSizeF & pageSize, const double dpiX, const double dpiY, QGraphicsItem *parent = nullptr);
 
   // This seems fragile as it assumes no other code declaring a custom graphics
   // item will choose the same ID for it's object types. Unfortunately, there
@@ -559,7 +949,7 @@ public:
 
   virtual QRectF boundingRect() const;
 
-  QWeakPointer<Backend::Page> page() const { return _page; }
+  QWeakPointer<Backend::Page> page() const;
 
   // Maps the point _point_ from the page's coordinate system (in pt) to this
   // item's coordinate system - chain with mapToScene and related methods to get
@@ -575,7 +965,15 @@ public:
 
   // get the nominal (i.e., unmagnified) page size in pixel
   QSizeF pageSizeF() const { return _pageSize; }
+  // set the page size (in pt); returns true if it changed
+  bool setPageSize(const QSizeF & pageSize);
   int pageNum() const { return _pageNum; }
+  double dpiX() const { return _dpiX; }
+  double dpiY() const { return _dpiY; }
+
+  // Returns the tiles (in pixel coordinates relative to the page at zoom level
+  // `scaleFactor`) that are needed to cover `rect` (in item coordinates)
+  QList<QRect> tilesForRect(const QRectF & rect, const qreal scaleFactor) const;
 
 protected:
   bool event(QEvent *event);
@@ -587,6 +985,7 @@ private:
 private slots:
   void addLinks(QList< QSharedPointer<Annotation::Link> > links);
   void addAnnotations(QList< QSharedPointer<Annotation::AbstractAnnotation> > annotations);
+  void loadAnnotations();
 };
 
 // TODO: Should be turned into a QGraphicsPolygonItem
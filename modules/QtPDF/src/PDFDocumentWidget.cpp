@@ -45,34 +45,60 @@ PDFDocumentWidget::~PDFDocumentWidget()
 // is returned
 bool PDFDocumentWidget::load(const QString &filename)
 {
+  QSharedPointer<Backend::Document> oldDoc;
   if (_scene) {
-    // If we already have the document, reload it instead of replacing it with
-    // a new instance to preserve the current state (e.g., viewing area, etc.)
-    QSharedPointer<Backend::Document> doc = _scene.data()->document().toStrongRef();
-    if (doc && doc.data()->fileName() == filename) {
-      _scene.data()->reloadDocument();
-      return true;
-    }
+    // If we already have the document, replace it by the new version (if any)
+    // in the background to preserve the current state (e.g., viewing area,
+    // etc.) without showing an empty or half-rendered view in the meantime
+    // (see PDFDocumentView::replaceScene())
+    oldDoc = _scene.data()->document().toStrongRef();
+    if (oldDoc && oldDoc.data()->fileName() != filename)
+      oldDoc.clear();
   }
 
+  // Measure the time to the first pixel from here (see
+  // PDFDocumentScene::timeToFirstPixel())
+  QElapsedTimer openTimer;
+  openTimer.start();
+
+  // NB: If another view shows the same file, share its document (see
+  // BackendInterface::sharedDocument())
   QSharedPointer<QtPDF::Backend::Document> a_pdf_doc;
   foreach(BackendInterface * bi, _backends) {
     if (bi && bi->canHandleFile(filename))
-      a_pdf_doc = bi->newDocument(filename);
+      a_pdf_doc = bi->sharedDocument(filename);
     if (a_pdf_doc)
       break;
   }
 
+  // NB: If the new version is broken (e.g., because it is still being
+  // written), keep showing the old one
   if (!a_pdf_doc || !a_pdf_doc->isValid())
     return false;
 
+  // The file has not changed (and if the document was reloaded by another
+  // view sharing it, this view's scene was updated as well)
+  if (oldDoc && a_pdf_doc == oldDoc)
+    return true;
+
   // Note: Don't pass `this` (or any other QObject*) as parent to the new
   // PDFDocumentScene as that would cause docScene to be destroyed with its
   // parent, thereby bypassing the QSharedPointer mechanism. docScene will be
   // freed automagically when the last QSharedPointer pointing to it will be
   // destroyed.
+  // NB: New scenes watch their file by default, but a reloaded document must
+  // not be watched if the old one wasn't (e.g., while typesetting)
+  const bool watch = (!oldDoc || _scene->watchForDocumentChangesOnDisk());
   _scene = QSharedPointer<QtPDF::PDFDocumentScene>(new QtPDF::PDFDocumentScene(a_pdf_doc, nullptr, _dpi, _dpi));
-  setScene(_scene);
+  _scene->setOpenTimer(openTimer);
+  if (!watch)
+    _scene->setWatchForDocumentChangesOnDisk(false);
+  // NB: document() returns the new document right away, even if the old one
+  // is still shown for a moment
+  if (oldDoc)
+    replaceScene(_scene);
+  else
+    setScene(_scene);
   return true;
 }
 
@@ -83,6 +109,18 @@ QWeakPointer<Backend::Document> PDFDocumentWidget::document() const
   return _scene->document();
 }
 
+QSharedPointer<Backend::Document> PDFDocumentWidget::newDocument(const QString & filename) const
+{
+  foreach(BackendInterface * bi, _backends) {
+    if (!bi || !bi->canHandleFile(filename))
+      continue;
+    QSharedPointer<Backend::Document> doc(bi->newDocument(filename));
+    if (doc)
+      return doc;
+  }
+  return QSharedPointer<Backend::Document>();
+}
+
 QStringList PDFDocumentWidget::backends() const
 {
   QStringList retVal;
@@ -28,6 +28,9 @@ public:
   bool load(const QString & filename);
 
   QWeakPointer<Backend::Document> document() const;
+  // Opens a new document instance for `filename` that is not shared with any
+  // view (e.g., for rendering in parallel, see PDFBandRenderer)
+  QSharedPointer<Backend::Document> newDocument(const QString & filename) const;
 
   bool watchForDocumentChangesOnDisk() const {
     if (_scene) return _scene->watchForDocumentChangesOnDisk();
@@ -18,13 +18,55 @@
 #include <QPixmap>
 // DEBUG
 
+#include <QPainter>
+#include <QThread>
+#include <QVector>
+#include <QPair>
+#include <QtConcurrent>
+
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 
 namespace QtPDF {
 
 namespace Transition {
 
+// Splits the rows [0, height) of an image of size `size` into bands and calls
+// `func(first, last)` for each band [first, last) on the global thread pool
+// (blocking until all bands are done). Small images are processed in the
+// calling thread as the overhead of distributing the work would outweigh the
+// gain.
+// NB: `func` must not call non-const QImage methods such as scanLine() (which
+// may detach and are not thread-safe); obtain the pointers beforehand.
+template<typename Func>
+static void processRows(const QSize & size, Func func)
+{
+  const int numThreads = QThread::idealThreadCount();
+  if (numThreads < 2 || size.width() * size.height() < 256 * 1024) {
+    func(0, size.height());
+    return;
+  }
+  // Use a few more bands than threads to balance the load
+  const int numBands = qMin(4 * numThreads, size.height());
+  QVector< QPair<int, int> > bands;
+  bands.reserve(numBands);
+  for (int i = 0; i < numBands; ++i)
+    bands << qMakePair(i * size.height() / numBands, (i + 1) * size.height() / numBands);
+  QtConcurrent::blockingMap(bands, [&func](QPair<int, int> & band) { func(band.first, band.second); });
+}
+
+// Returns (p1 * (256 - w) + p2 * w) / 256 for each color component of the
+// 32bit pixels p1 and p2 (0 <= w <= 256). Two components are processed at once
+// (in the 0x00ff00ff and 0xff00ff00 parts of the pixels), using only integer
+// operations, so loops calling this can be auto-vectorized by the compiler.
+static inline quint32 blendPixel(const quint32 p1, const quint32 p2, const quint32 w)
+{
+  const quint32 rb = (((p1 & 0x00ff00ff) * (256 - w) + (p2 & 0x00ff00ff) * w) >> 8) & 0x00ff00ff;
+  const quint32 ag = (((p1 >> 8) & 0x00ff00ff) * (256 - w) + ((p2 >> 8) & 0x00ff00ff) * w) & 0xff00ff00;
+  return rb | ag;
+}
+
 AbstractTransition::AbstractTransition() :
   _duration(1),
   _direction(0),
@@ -64,6 +106,39 @@ void AbstractTransition::setImages(const QImage & imgStart, const QImage & imgEn
     QRect r(QPoint((imgEnd.width() - size.width()) / 2, (imgEnd.height() - size.height()) / 2), size);
     _imgEnd = imgEnd.copy(r);
   }
+
+  // All transitions work on QImage::Format_ARGB32 (the backends may return
+  // other formats, e.g., premultiplied ARGB)
+  if (_imgStart.format() != QImage::Format_ARGB32)
+    _imgStart = _imgStart.convertToFormat(QImage::Format_ARGB32);
+  if (_imgEnd.format() != QImage::Format_ARGB32)
+    _imgEnd = _imgEnd.convertToFormat(QImage::Format_ARGB32);
+}
+
+QImage & AbstractTransition::frameBuffer()
+{
+  // NB: If the previous frame is still in use elsewhere, writing to it would
+  // detach (i.e., copy) it anyway, so we can just as well allocate a new one
+  if (_frame.size() != _imgEnd.size() || _frame.format() != QImage::Format_ARGB32 || !_frame.isDetached())
+    _frame = QImage(_imgEnd.size(), QImage::Format_ARGB32);
+  return _frame;
+}
+
+QPoint AbstractTransition::directionOffset(const double t) const
+{
+  // Directions are given in degrees, counterclockwise starting from a
+  // left-to-right direction (see the pdf specs)
+  switch (_direction) {
+  case 90:
+    return QPoint(0, -qRound(t * _imgEnd.height()));
+  case 180:
+    return QPoint(-qRound(t * _imgEnd.width()), 0);
+  case 270:
+    return QPoint(0, qRound(t * _imgEnd.height()));
+  case 0:
+  default:
+    return QPoint(qRound(t * _imgEnd.width()), 0);
+  }
 }
 
 double AbstractTransition::getFracTime()
@@ -90,19 +165,27 @@ AbstractTransition * AbstractTransition::newTransition(const Type type)
   case Type_Split:
     return new Split();
   case Type_Blinds:
+    return new Blinds();
   case Type_Box:
+    return new Box();
   case Type_Wipe:
+    return new Wipe();
   case Type_Dissolve:
+    return new Dissolve();
   case Type_Glitter:
-    break;
+    return new Glitter();
   case Type_Replace:
     return new Replace();
   case Type_Fly:
+    return new Fly();
   case Type_Push:
+    return new Push();
   case Type_Cover:
+    return new Cover();
   case Type_Uncover:
+    return new Uncover();
   case Type_Fade:
-    break;
+    return new Fade();
   }
   return nullptr;
 }
@@ -127,46 +210,54 @@ QImage AbstractInPlaceTransition::getImage()
   Q_ASSERT(_imgEnd.format() == QImage::Format_ARGB32);
   Q_ASSERT(_mask.format() == QImage::Format_Indexed8);
 
-  QImage retVal(_imgStart.size(), QImage::Format_ARGB32);
-  
   // map: 0 -> -_spread, 1 -> 1+_spread
   // this ensures that even with a contrast spread, 0 corresponds to img1, and
   // 1 corresponds to img2
   double t = (1 + 2 * _spread) * getFracTime() - _spread;
-  int i, j;
   
   // Contrast mapping. Every pixel <= c1 corresponds entirely to img1, every
   // pixel >= c2 corresponds entirely to img2, and everything in-between is
   // interpolated linearly
   int c1 = static_cast<int>(255 * (t - _spread));
   int c2 = static_cast<int>(255 * (t + _spread));
-  float f;
 
-  // NOTE: Using bits() instead of scanLine() here led to some unpredictable
-  // crashes on Linux/Ubuntu when using zoom (probably due to some data
-  // alignment issues).
-  for (j = 0; j < _mask.height(); ++j) {
-    const uchar * img1 = _imgStart.constScanLine(j);
-    const uchar * img2 = _imgEnd.constScanLine(j);
-    const uchar * mask = _mask.constScanLine(j);
-    uchar * img = retVal.scanLine(j);
-    for (i = 0; i < _mask.width(); ++i) {
-      if (mask[i] <= c1)
-        f = 1.0f;
-      else if (mask[i] >= c2)
-        f = 0.0f;
-      else
-        // c1 != c2 is guaranteed here; if c1 == c2, then c2 <= mask[i] <= c1
-        // reduces to c1 <= mask[i] <= c1 and always holds.
-        f = static_cast<float>(c2 - mask[i]) / static_cast<float>(c2 - c1);
-      img[4 * i + 0] = static_cast<uchar>(img1[4 * i + 0] * (1.0f - f) + img2[4 * i + 0] * f);
-      img[4 * i + 1] = static_cast<uchar>(img1[4 * i + 1] * (1.0f - f) + img2[4 * i + 1] * f);
-      img[4 * i + 2] = static_cast<uchar>(img1[4 * i + 2] * (1.0f - f) + img2[4 * i + 2] * f);
-      img[4 * i + 3] = static_cast<uchar>(img1[4 * i + 3] * (1.0f - f) + img2[4 * i + 3] * f);
-    }
+  // As there are only 256 possible mask values, we compute the (integer)
+  // blending weight for each of them once per frame
+  quint32 weights[256];
+  for (int m = 0; m < 256; ++m) {
+    double f;
+    if (m <= c1)
+      f = 1.0;
+    else if (m >= c2)
+      f = 0.0;
+    else
+      // c1 != c2 is guaranteed here; if c1 == c2, then c2 <= m <= c1 reduces
+      // to c1 <= m <= c1 and always holds.
+      f = static_cast<double>(c2 - m) / static_cast<double>(c2 - c1);
+    weights[m] = static_cast<quint32>(qRound(256 * f));
   }
+
+  QImage & frame = frameBuffer();
+  // NOTE: Using bits() for the whole image instead of scanLine() for each row
+  // led to some unpredictable crashes on Linux/Ubuntu when using zoom in the
+  // past (probably due to some data alignment issues). Hence, we compute the
+  // row pointers from bytesPerLine() (which is exactly what scanLine() does).
+  uchar * frameBits = frame.bits();
+  const int bpl = frame.bytesPerLine();
+  const int width = frame.width();
+
+  processRows(frame.size(), [&](const int first, const int last) {
+    for (int j = first; j < last; ++j) {
+      const QRgb * img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
+      const QRgb * img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
+      const uchar * mask = _mask.constScanLine(j);
+      QRgb * img = reinterpret_cast<QRgb*>(frameBits + j * bpl);
+      for (int i = 0; i < width; ++i)
+        img[i] = blendPixel(img1[i], img2[i], weights[mask[i]]);
+    }
+  });
   
-  return retVal;
+  return frame;
 }
 
 QImage Replace::getImage()
@@ -403,206 +494,97 @@ void Fly::start(const QImage & imgStart, const QImage & imgEnd)
 
 QImage Fly::getImage()
 {
-  Q_ASSERT(_imgStart.size() == _imgEnd.size());
+  Q_ASSERT(_imgStart.size() == _imgEnd.size() && _imgStart.size() == _mask.size());
   Q_ASSERT(_imgStart.format() == QImage::Format_ARGB32);
   Q_ASSERT(_imgEnd.format() == QImage::Format_ARGB32);
 
-  QImage retVal = QImage(_imgEnd.size(), QImage::Format_ARGB32);
-  int i, j;
-  int offset;
-  const QRgb * img1, * img2;
-  const uchar * mask;
-  QRgb * img;
-  
-  switch (_motion) {
-  case Motion_Inward:
-    if (_direction == 0) {
-      offset = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.width()));
-      for (j = 0; j < _imgEnd.height(); ++j) {
-        img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-        img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-        mask = _mask.constScanLine(j);
-        img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-        for (i = 0; i < offset; ++i)
-          img[i] = (mask[i + _imgEnd.width() - offset] == 0 ? img1[i] : img2[i + _imgEnd.width() - offset]);
-        for (; i < _imgEnd.width(); ++i)
-          img[i] = img1[i];
-      }
-    }
-    else if (_direction == 270) {
-      offset = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.height()));
-      for (j = 0; j < _imgEnd.height(); ++j) {
-        img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-        if (j < offset) {
-          img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-          img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j + _imgEnd.height() - offset));
-          mask = _mask.constScanLine(j + _imgEnd.height() - offset);
-          for (i = 0; i < _imgEnd.width(); ++i)
-            img[i] = (mask[i] == 0 ? img1[i] : img2[i] );
-        }
-        else {
-          img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-          for (i = 0; i < _imgEnd.width(); ++i)
-            img[i] = img1[i];
-        }
-      }
-    }
-    break;
-  case Motion_Outward:
-    if (_direction == 0) {
-      offset = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.width()));
-      for (j = 0; j < _imgEnd.height(); ++j) {
-        img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-        img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-        mask = _mask.constScanLine(j);
-        img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-        for (i = 0; i < offset; ++i)
-          img[i] = img2[i];
-        for (; i < _imgEnd.width(); ++i)
-          img[i] = (mask[i - offset] == 0 ? img2[i] : img1[i - offset]);
-      }
-    }
-    else if (_direction == 270) {
-      offset = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.height()));
-      for (j = 0; j < _imgEnd.height(); ++j) {
-        img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-        if (j < offset) {
-          img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-          for (i = 0; i < _imgEnd.width(); ++i)
-            img[i] = img2[i];
-        }
-        else {
-          img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j - offset));
-          img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-          mask = _mask.constScanLine(j - offset);
-          for (i = 0; i < _imgEnd.width(); ++i)
-            img[i] = (mask[i] == 0 ? img2[i] : img1[i] );
-        }
+  const double t = getFracTime();
+  // Inward: the changed parts of the end image fly in on top of the start
+  // image. Outward: the changed parts of the start image fly out and reveal
+  // the end image.
+  const QPoint shift = (_motion == Motion_Inward ? directionOffset(t) - directionOffset(1) : directionOffset(t));
+  const QImage & moving = (_motion == Motion_Inward ? _imgEnd : _imgStart);
+  const QImage & fixed = (_motion == Motion_Inward ? _imgStart : _imgEnd);
+
+  QImage & frame = frameBuffer();
+  uchar * frameBits = frame.bits();
+  const int bpl = frame.bytesPerLine();
+  const int width = frame.width(), height = frame.height();
+  // The columns [i0, i1) are covered by the (shifted) moving image
+  const int i0 = qBound(0, shift.x(), width);
+  const int i1 = qBound(0, width + shift.x(), width);
+
+  processRows(frame.size(), [&](const int first, const int last) {
+    for (int j = first; j < last; ++j) {
+      QRgb * img = reinterpret_cast<QRgb*>(frameBits + j * bpl);
+      const QRgb * bg = reinterpret_cast<const QRgb*>(fixed.constScanLine(j));
+      const int sj = j - shift.y();
+      if (sj < 0 || sj >= height || i0 >= i1) {
+        memcpy(img, bg, width * sizeof(QRgb));
+        continue;
       }
+      const QRgb * fg = reinterpret_cast<const QRgb*>(moving.constScanLine(sj));
+      const uchar * mask = _mask.constScanLine(sj);
+      const int sx = shift.x();
+      memcpy(img, bg, i0 * sizeof(QRgb));
+      for (int i = i0; i < i1; ++i)
+        img[i] = (mask[i - sx] == 0 ? bg[i] : fg[i - sx]);
+      memcpy(img + i1, bg + i1, (width - i1) * sizeof(QRgb));
     }
-    break;
-  }
-  return retVal;
+  });
+  return frame;
 }
 
-
-QImage Push::getImage()
+QImage AbstractMovingTransition::getImage()
 {
   Q_ASSERT(_imgStart.size() == _imgEnd.size());
-  Q_ASSERT(_imgStart.format() == QImage::Format_ARGB32);
-  Q_ASSERT(_imgEnd.format() == QImage::Format_ARGB32);
 
-  QImage retVal = QImage(_imgEnd.size(), QImage::Format_ARGB32);
-  int i, j;
-  int edge;
-  const QRgb * img1, * img2;
-  QRgb * img;
-  
-  if (_direction == 0) {
-    edge = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.width()));
-    for (j = 0; j < _imgEnd.height(); ++j) {
-      img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-      img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-      img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-      for (i = 0; i < edge; ++i)
-        img[i] = img2[i + _imgEnd.width() - edge];
-      for (; i < _imgEnd.width(); ++i)
-        img[i] = img1[i - edge];
-    }
-  }
-  else if (_direction == 270) {
-    edge = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.height()));
-    for (j = 0; j < _imgEnd.height(); ++j) {
-      if (j < edge)
-        img1 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j + _imgEnd.height() - edge));
-      else
-        img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j - edge));
-      QRgb * img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-
-      for (i = 0; i < retVal.width(); ++i)
-        img[i] = img1[i];
-    }
-  }
-  return retVal;
+  QPoint offsetStart, offsetEnd;
+  bool endOnTop;
+  getOffsets(getFracTime(), offsetStart, offsetEnd, endOnTop);
+
+  const QImage & top = (endOnTop ? _imgEnd : _imgStart);
+  const QImage & bottom = (endOnTop ? _imgStart : _imgEnd);
+  const QPoint & offsetTop = (endOnTop ? offsetEnd : offsetStart);
+  const QPoint & offsetBottom = (endOnTop ? offsetStart : offsetEnd);
+
+  QImage & frame = frameBuffer();
+  QPainter p(&frame);
+  // We only copy pixels around; there is nothing to blend (and using
+  // CompositionMode_Source lets Qt use plain memory copies)
+  p.setCompositionMode(QPainter::CompositionMode_Source);
+  // Don't paint the parts of the bottom image that will be covered anyway
+  QRect topRect(offsetTop, top.size());
+  p.setClipRegion(QRegion(frame.rect()).subtracted(QRegion(topRect)));
+  p.drawImage(offsetBottom, bottom);
+  p.setClipping(false);
+  p.drawImage(offsetTop, top);
+  p.end();
+  return frame;
 }
 
-QImage Cover::getImage()
+void Push::getOffsets(const double t, QPoint & offsetStart, QPoint & offsetEnd, bool & endOnTop) const
 {
-  Q_ASSERT(_imgStart.size() == _imgEnd.size());
-  Q_ASSERT(_imgStart.format() == QImage::Format_ARGB32);
-  Q_ASSERT(_imgEnd.format() == QImage::Format_ARGB32);
-
-  QImage retVal = QImage(_imgEnd.size(), QImage::Format_ARGB32);
-  int i, j;
-  int edge;
-  const QRgb * img1, * img2;
-  QRgb * img;
-  
-  if (_direction == 0) {
-    edge = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.width()));
-    for (j = 0; j < _imgEnd.height(); ++j) {
-      img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-      img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-      img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-      for (i = 0; i < edge; ++i)
-        img[i] = img2[i + _imgEnd.width() - edge];
-      for (; i < _imgEnd.width(); ++i)
-        img[i] = img1[i];
-    }
-  }
-  else if (_direction == 270) {
-    edge = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.height()));
-    for (j = 0; j < _imgEnd.height(); ++j) {
-      if (j < edge)
-        img1 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j + _imgEnd.height() - edge));
-      else
-        img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-      QRgb * img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-
-      for (i = 0; i < retVal.width(); ++i)
-        img[i] = img1[i];
-    }
-  }
-  return retVal;
+  // Both images move; the end image pushes the start image out of the frame
+  offsetStart = directionOffset(t);
+  offsetEnd = directionOffset(t) - directionOffset(1);
+  endOnTop = true;
 }
 
-QImage Uncover::getImage()
+void Cover::getOffsets(const double t, QPoint & offsetStart, QPoint & offsetEnd, bool & endOnTop) const
 {
-  Q_ASSERT(_imgStart.size() == _imgEnd.size());
-  Q_ASSERT(_imgStart.format() == QImage::Format_ARGB32);
-  Q_ASSERT(_imgEnd.format() == QImage::Format_ARGB32);
+  // The end image moves in on top of the (fixed) start image
+  offsetStart = QPoint(0, 0);
+  offsetEnd = directionOffset(t) - directionOffset(1);
+  endOnTop = true;
+}
 
-  QImage retVal = QImage(_imgEnd.size(), QImage::Format_ARGB32);
-  int i, j;
-  int edge;
-  const QRgb * img1, * img2;
-  
-  if (_direction == 0) {
-    edge = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.width()));
-    for (j = 0; j < _imgEnd.height(); ++j) {
-      img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
-      img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-      QRgb * img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-      for (i = 0; i < edge; ++i)
-        img[i] = img2[i];
-      for (; i < _imgEnd.width(); ++i)
-        img[i] = img1[i - edge];
-    }
-  }
-  else if (_direction == 270) {
-    edge = static_cast<int>(getFracTime() * static_cast<float>(_imgEnd.height()));
-    for (j = 0; j < _imgEnd.height(); ++j) {
-      if (j < edge)
-        img1 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
-      else
-        img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j - edge));
-      QRgb * img = reinterpret_cast<QRgb*>(retVal.scanLine(j));
-
-      for (i = 0; i < retVal.width(); ++i)
-        img[i] = img1[i];
-    }
-  }
-  return retVal;
+void Uncover::getOffsets(const double t, QPoint & offsetStart, QPoint & offsetEnd, bool & endOnTop) const
+{
+  // The start image moves out and reveals the (fixed) end image below it
+  offsetStart = directionOffset(t);
+  offsetEnd = QPoint(0, 0);
+  endOnTop = false;
 }
 
 QImage Fade::getImage()
@@ -611,18 +593,23 @@ QImage Fade::getImage()
   Q_ASSERT(_imgStart.format() == QImage::Format_ARGB32);
   Q_ASSERT(_imgEnd.format() == QImage::Format_ARGB32);
 
-  QImage retVal = QImage(_imgEnd.size(), QImage::Format_ARGB32);
-  int i;
-  int f = static_cast<int>(255 * getFracTime());
+  const quint32 w = static_cast<quint32>(qRound(256 * getFracTime()));
 
-  const uchar * img1 = _imgStart.constBits();
-  const uchar * img2 = _imgEnd.constBits();
-  uchar * img = retVal.bits();
+  QImage & frame = frameBuffer();
+  uchar * frameBits = frame.bits();
+  const int bpl = frame.bytesPerLine();
+  const int width = frame.width();
 
-  for (i = 0; i < retVal.byteCount(); ++i) {
-    img[i] = static_cast<uchar>(((255 - f) * img1[i] + f * img2[i]) / 255);
-  }
-  return retVal;
+  processRows(frame.size(), [&](const int first, const int last) {
+    for (int j = first; j < last; ++j) {
+      const QRgb * img1 = reinterpret_cast<const QRgb*>(_imgStart.constScanLine(j));
+      const QRgb * img2 = reinterpret_cast<const QRgb*>(_imgEnd.constScanLine(j));
+      QRgb * img = reinterpret_cast<QRgb*>(frameBits + j * bpl);
+      for (int i = 0; i < width; ++i)
+        img[i] = blendPixel(img1[i], img2[i], w);
+    }
+  });
+  return frame;
 }
 
 } // namespace Transition
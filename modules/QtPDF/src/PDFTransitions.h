@@ -51,6 +51,13 @@ public:
 protected:
   double getFracTime();
   virtual void setImages(const QImage & imgStart, const QImage & imgEnd);
+  // Returns the buffer to render the next frame into. The buffer is reused
+  // across frames (it is only reallocated if the images change size or if the
+  // previous frame returned by getImage() is still in use elsewhere).
+  QImage & frameBuffer();
+  // Returns the offset (in pixel) by which an image moving in the transition's
+  // direction has moved after the fraction `t` of the total way
+  QPoint directionOffset(const double t) const;
   
   double _duration;
   int _direction;
@@ -60,6 +67,7 @@ protected:
   QTime _timer;
   QImage _imgStart;
   QImage _imgEnd;
+  QImage _frame;
   // TODO: /SS and /B properties
 };
 
@@ -144,25 +152,40 @@ protected:
   QImage _mask;
 };
 
-class Push : public AbstractTransition
+// Base class for transitions that only move the two images around (without
+// blending them)
+class AbstractMovingTransition : public AbstractTransition
 {
 public:
-  Push() { }
   virtual QImage getImage();
+protected:
+  // Returns the positions of the two images at the fraction `t` of the
+  // transition and whether the end image should be painted on top
+  virtual void getOffsets(const double t, QPoint & offsetStart, QPoint & offsetEnd, bool & endOnTop) const = 0;
+};
+
+class Push : public AbstractMovingTransition
+{
+public:
+  Push() { }
+protected:
+  virtual void getOffsets(const double t, QPoint & offsetStart, QPoint & offsetEnd, bool & endOnTop) const;
 };
 
-class Cover : public AbstractTransition
+class Cover : public AbstractMovingTransition
 {
 public:
   Cover() { }
-  virtual QImage getImage();
+protected:
+  virtual void getOffsets(const double t, QPoint & offsetStart, QPoint & offsetEnd, bool & endOnTop) const;
 };
 
-class Uncover : public AbstractTransition
+class Uncover : public AbstractMovingTransition
 {
 public:
   Uncover() { }
-  virtual QImage getImage();
+protected:
+  virtual void getOffsets(const double t, QPoint & offsetStart, QPoint & offsetEnd, bool & endOnTop) const;
 };
 
 class Fade : public AbstractTransition
@@ -14,10 +14,14 @@
 
 // NOTE: `MuPDFBackend.h` is included via `PDFBackend.h`
 #include <PDFBackend.h>
+#include <QCryptographicHash>
 
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
 #endif // defined(HAVE_LOCALE_H)
+#ifdef HAVE_XLOCALE_H
+#include <xlocale.h>
+#endif // defined(HAVE_XLOCALE_H)
 
 namespace QtPDF {
 
@@ -248,6 +252,71 @@ PDFDestination toPDFDestination(pdf_xref * xref, fz_obj * dest)
   return PDFDestination();
 }
 
+// Adds a canonical representation of `obj` to `hash`. Indirect objects are
+// resolved as their numbers change whenever a file is regenerated, except for
+// references to pages, which are represented by the page number (as in
+// toPDFDestination()).
+void hashObject(QCryptographicHash & hash, pdf_xref * xref, fz_obj * obj, QSet<int> & visited, const int depth = 0)
+{
+  static char keyType[] = "Type";
+
+  if (!obj || fz_is_null(obj)) {
+    hash.addData("n", 1);
+    return;
+  }
+  if (fz_is_indirect(obj)) {
+    fz_obj * type = (fz_is_dict(obj) ? fz_dict_gets(obj, keyType) : nullptr);
+    if (fz_is_name(type) && qstrcmp(fz_to_name(type), "Page") == 0) {
+      hash.addData("p", 1);
+      hash.addData(QByteArray::number(pdf_find_page_number(xref, obj)));
+      return;
+    }
+    // Don't follow cycles (e.g., between annotations and their popups) or
+    // deeply nested structures
+    if (depth > 16 || visited.contains(fz_to_num(obj))) {
+      hash.addData("R", 1);
+      return;
+    }
+    visited.insert(fz_to_num(obj));
+  }
+
+  if (fz_is_bool(obj))
+    hash.addData(fz_to_bool(obj) ? "t" : "f", 1);
+  else if (fz_is_int(obj)) {
+    hash.addData("i", 1);
+    hash.addData(QByteArray::number(fz_to_int(obj)));
+  }
+  else if (fz_is_real(obj)) {
+    hash.addData("r", 1);
+    hash.addData(QByteArray::number(fz_to_real(obj)));
+  }
+  else if (fz_is_name(obj)) {
+    hash.addData("/", 1);
+    hash.addData(QByteArray(fz_to_name(obj)));
+  }
+  else if (fz_is_string(obj)) {
+    hash.addData("(", 1);
+    hash.addData(QByteArray::number(fz_to_str_len(obj)));
+    hash.addData(fz_to_str_buf(obj), fz_to_str_len(obj));
+  }
+  else if (fz_is_array(obj)) {
+    hash.addData("[", 1);
+    for (int i = 0; i < fz_array_len(obj); ++i)
+      hashObject(hash, xref, fz_array_get(obj, i), visited, depth + 1);
+    hash.addData("]", 1);
+  }
+  else if (fz_is_dict(obj)) {
+    hash.addData("<", 1);
+    for (int i = 0; i < fz_dict_len(obj); ++i) {
+      hashObject(hash, xref, fz_dict_get_key(obj, i), visited, depth + 1);
+      hashObject(hash, xref, fz_dict_get_val(obj, i), visited, depth + 1);
+    }
+    hash.addData(">", 1);
+  }
+  else
+    hash.addData("?", 1);
+}
+
 #ifdef DEBUG
   const char * fz_type(fz_obj *obj) {
     if (!obj)
@@ -343,14 +412,45 @@ void initPDFMarkupAnnotation(Annotation::Markup * annot, QWeakPointer<Backend::P
 
 // Modeled after the idea behind QMutexLocker, i.e., the class sets LC_NUMERIC
 // to "C" in the contructor and resets the original setting in the destructor
-#ifdef HAVE_LOCALE_H
+#if defined(HAVE_USELOCALE)
+// NB: uselocale() only affects the calling thread, so MuPDF operations on
+// different threads (and documents) can run concurrently. Access to the MuPDF
+// data structures themselves is still governed by the doc- and page-locks.
+// Nesting works naturally as each instance restores whatever locale was active
+// when it was constructed.
+class MuPDFLocaleResetter
+{
+  locale_t _locale;
+
+  static locale_t cLocale() {
+    // NB: Initialization of function-local statics is thread-safe in C++11.
+    // The locale object is never freed as it is needed until the very end.
+    // Only LC_NUMERIC is changed; all other categories are taken from the
+    // global locale.
+    static locale_t c = newlocale(LC_NUMERIC_MASK, "C", duplocale(LC_GLOBAL_LOCALE));
+    return c;
+  }
+public:
+  MuPDFLocaleResetter() : _locale(static_cast<locale_t>(0)) {
+    locale_t c = cLocale();
+    if (c != static_cast<locale_t>(0))
+      _locale = uselocale(c);
+  }
+  ~MuPDFLocaleResetter() {
+    if (_locale != static_cast<locale_t>(0))
+      uselocale(_locale);
+  }
+};
+#elif defined(HAVE_LOCALE_H)
+// Fallback if per-thread locales are not available: setlocale() changes the
+// locale of the whole process, so all MuPDF calls need to be serialized
 class MuPDFLocaleResetter
 {
   char * _locale;
   static QMutex * _lock;
 public:
   MuPDFLocaleResetter() { _lock->lock(); _locale = setlocale(LC_NUMERIC, NULL); setlocale(LC_NUMERIC, "C"); }
-  ~MuPDFLocaleResetter() { _lock->unlock(); setlocale(LC_NUMERIC, _locale); }
+  ~MuPDFLocaleResetter() { setlocale(LC_NUMERIC, _locale); _lock->unlock(); }
 };
 QMutex * MuPDFLocaleResetter::_lock = new QMutex(QMutex::Recursive);
 #else
@@ -359,7 +459,17 @@ class MuPDFLocaleResetter
 public:
   MuPDFLocaleResetter() { }
 };
-#endif // defined(HAVE_LOCALE_H)
+#endif // defined(HAVE_USELOCALE)
+
+// Serializes calls into MuPDF for one document (see Document::_mupdfMutex) and
+// sets LC_NUMERIC to "C" while they run
+class MuPDFLocker
+{
+  QMutexLocker _mutexLocker;
+  MuPDFLocaleResetter _localeResetter;
+public:
+  explicit MuPDFLocker(QMutex * mutex) : _mutexLocker(mutex) { }
+};
 
 
 // Document Class
@@ -367,7 +477,8 @@ public:
 Document::Document(QString fileName):
   Super(fileName),
   _mupdf_data(NULL),
-  _glyph_cache(fz_new_glyph_cache())
+  _glyph_cache(fz_new_glyph_cache()),
+  _mupdfMutex(new QMutex(QMutex::Recursive))
 {
 #ifdef DEBUG
 //  qDebug() << "MuPDF::Document::Document(" << fileName << ")";
@@ -385,6 +496,7 @@ Document::~Document()
 
   clearPages();
 
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
   if( _mupdf_data ){
     pdf_free_xref(_mupdf_data);
     _mupdf_data = NULL;
@@ -403,24 +515,35 @@ void Document::reload()
   _processingThread.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
-  MuPDFLocaleResetter lr;
 
   clearPages();
-  _pageCache.markOutdated();
+  _pageCache->markOutdated();
+  _numPages = -1;
+
+  // NB: Only lock after clearPages() as that may destroy page objects (see
+  // _mupdfMutex)
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   if (_mupdf_data) {
     pdf_free_xref(_mupdf_data);
     _mupdf_data = NULL;
   }
 
-  fz_stream *pdf_file = fz_open_file(_fileName.toLocal8Bit().data());
-  if (!pdf_file)
+  // NB: MuPDF reads from the stream lazily, so _fileSource must be kept alive
+  // as long as _mupdf_data
+  _fileSource = FileSource::open(_fileName);
+  fz_stream *pdf_file = (_fileSource ? fz_open_memory(reinterpret_cast<unsigned char*>(const_cast<char*>(_fileSource->data().constData())), static_cast<int>(_fileSource->size())) : NULL);
+  if (!pdf_file) {
+    publishMetaData();
     return;
+  }
   pdf_open_xref_with_stream(&_mupdf_data, pdf_file, NULL);
   fz_close(pdf_file);
 
-  if (!_mupdf_data)
+  if (!_mupdf_data) {
+    publishMetaData();
     return;
+  }
 
   // Permission level determination works as follows:
   // 1) If there is no `crypt` dictionary, there is no security set, and
@@ -490,45 +613,37 @@ void Document::reload()
   pdf_load_page_tree(_mupdf_data);
   _numPages = pdf_count_pages(_mupdf_data);
   loadMetaData();
+  publishMetaData();
 }
 
-QWeakPointer<Backend::Page> Document::page(int at)
+Backend::Page * Document::newPage(int at)
 {
-  {
-    QReadLocker docLocker(_docLock.data());
-
-    if (at < 0 || at >= _numPages)
-      return QWeakPointer<Backend::Page>();
-
-    if (at < _pages.size() && !_pages[at].isNull())
-      return QWeakPointer<Backend::Page>(_pages[at]);;
-
-    // if we get here, the page is not in the array
-  }
-
-  QWriteLocker docLocker(_docLock.data());
-
-  // recheck everything that could have changed before we got the write lock
-  if (at >= _numPages)
-    return QWeakPointer<Backend::Page>();
-  if (at < _pages.size() && !_pages[at].isNull())
-    return _pages[at].toWeakRef();
-
-  if( _pages.isEmpty() )
-    _pages.resize(_numPages);
-
-  _pages[at] = QSharedPointer<Backend::Page>(new Page(this, at, _docLock));
-  return _pages[at].toWeakRef();
+  if (!_mupdf_data)
+    return NULL;
+  return new Page(this, at, _docLock);
 }
 
-QWeakPointer<Backend::Page> Document::page(int at) const
+QSizeF Document::pageSizeF(int at)
 {
-  QReadLocker docLocker(_docLock.data());
-
-  if (at < 0 || at >= _numPages || at >= _pages.size())
-    return QWeakPointer<Backend::Page>();
-
-  return _pages[at];
+  {
+    // Read the MediaBox from the page dictionary if possible; that is much
+    // cheaper than creating the page object, which parses the page's contents
+    // (see Page::Page())
+    QReadLocker docLocker(_docLock.data());
+    MuPDFLocker mupdfLocker(_mupdfMutex.data());
+    if (_mupdf_data && !_isLocked() && at >= 0 && at < _mupdf_data->page_len) {
+      fz_obj * pageobj = _mupdf_data->page_objs[at];
+      if (pageobj) {
+        static char keyMediaBox[] = "MediaBox";
+        QRectF r(toRectF(fz_dict_gets(pageobj, keyMediaBox)));
+        if (!r.isEmpty())
+          return r.size();
+      }
+    }
+  }
+  // The MediaBox may be inherited from the page tree, so let the page object
+  // figure it out
+  return Super::pageSizeF(at);
 }
 
 void Document::loadMetaData()
@@ -536,7 +651,7 @@ void Document::loadMetaData()
   char infoName[] = "Info"; // required because fz_dict_gets is not prototyped to take const char *
 
   QWriteLocker docLocker(_docLock.data());
-  MuPDFLocaleResetter lr;
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   if (_isLocked())
     return;
@@ -602,7 +717,7 @@ void Document::loadMetaData()
 PDFDestination Document::resolveDestination(const PDFDestination & namedDestination) const
 {
   QReadLocker docLocker(_docLock.data());
-  MuPDFLocaleResetter lr;
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   Q_ASSERT(_mupdf_data != NULL);
   
@@ -624,7 +739,7 @@ PDFDestination Document::resolveDestination(const PDFDestination & namedDestinat
 QList<PDFFontInfo> Document::fonts() const
 {
   QReadLocker docLocker(_docLock.data());
-  MuPDFLocaleResetter lr;
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   int i;
   char typeKey[] = "Type";
@@ -791,7 +906,7 @@ void Document::recursiveConvertToC(QList<PDFToCItem> & items, pdf_outline * node
 PDFToC Document::toc() const
 {
   QReadLocker docLocker(_docLock.data());
-  MuPDFLocaleResetter lr;
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   PDFToC retVal;
 
@@ -817,7 +932,11 @@ bool Document::unlock(const QString password)
   // might want to unlock a document with the owner's password when user level
   // access is already granted.
   // TODO: Check if toUtf8 makes sense
-  bool success = pdf_authenticate_password(_mupdf_data, password.toUtf8().data());
+  bool success;
+  {
+    MuPDFLocker mupdfLocker(_mupdfMutex.data());
+    success = pdf_authenticate_password(_mupdf_data, password.toUtf8().data());
+  }
 
   if (success)
     _password = password;
@@ -832,11 +951,12 @@ bool Document::unlock(const QString password)
 // ==========
 Page::Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock):
   Super(parent, at, docLock),
+  _mupdfMutex(parent->_mupdfMutex),
   _annotationsLoaded(false),
   _linksLoaded(false)
 {
-  MuPDFLocaleResetter lr;
   QWriteLocker pageLocker(_pageLock);
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   pdf_page *page_data;
   pdf_load_page(&page_data, parent->_mupdf_data, _n);
@@ -849,9 +969,15 @@ Page::Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock):
     fz_obj * pageobj = parent->_mupdf_data->page_objs[at];
     if (pageobj) {
       static char keyMediaBox[] = "MediaBox";
+      static char keyAnnots[] = "Annots";
       QRectF r(toRectF(fz_dict_gets(pageobj, keyMediaBox)));
       if (!r.isEmpty())
         _size = r.size();
+
+      QCryptographicHash hash(QCryptographicHash::Sha1);
+      QSet<int> visited;
+      hashObject(hash, parent->_mupdf_data, fz_dict_gets(pageobj, keyAnnots), visited);
+      _fingerprint = hash.result();
     }
   }
   _rotate = qreal(page_data->rotate);
@@ -873,6 +999,7 @@ Page::Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock):
 Page::~Page()
 {
   QWriteLocker pageLocker(_pageLock);
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
   if( _mupdf_page )
     fz_free_display_list(_mupdf_page);
   _mupdf_page = NULL;
@@ -880,12 +1007,14 @@ Page::~Page()
 
 QSizeF Page::pageSizeF() const { QReadLocker pageLocker(_pageLock); return _size; }
 
-QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache) const
+QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache, const AbortToken & abort /* = AbortToken() */) const
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
-  if (!_parent)
+  if (!_parent || abort.isAborted())
     return QImage();
+  // NB: The display list and the glyph cache are not thread-safe
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   // Set up the transformation matrix for the page. Really, we just start with
   // an identity matrix and scale it using the xres, yres inputs.
@@ -919,18 +1048,24 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   fz_device *renderer = fz_new_draw_device(static_cast<Document *>(_parent)->_glyph_cache, mu_image);
 
   // Actually render the page.
+  // NOTE: The MuPDF version we use has no fz_cookie, so we cannot interrupt
+  // fz_execute_display_list(); we can only avoid returning (and caching) the
+  // result if the request was aborted in the meantime.
   fz_execute_display_list(_mupdf_page, renderer, render_trans, render_bbox);
 
   // Create a QImage that shares data with the fz_pixmap.
   QImage tmp_image(mu_image->samples, mu_image->w, mu_image->h, QImage::Format_ARGB32);
   // Now create a copy with its own data that can exist outside this function
   // call.
-  QImage renderedPage = tmp_image.copy();
+  QImage renderedPage = (abort.isAborted() ? QImage() : tmp_image.copy());
 
   // Dispose of unneeded items.
   fz_free_device(renderer);
   fz_drop_pixmap(mu_image);
 
+  if (renderedPage.isNull())
+    return renderedPage;
+
   if( cache ) {
     PDFPageTile key(xres, yres, render_box, _n);
     QImage * img = new QImage(renderedPage.copy());
@@ -941,7 +1076,13 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   return renderedPage;
 }
 
-QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
+QByteArray Page::fingerprint() const
+{
+  QReadLocker pageLocker(_pageLock);
+  return _fingerprint;
+}
+
+QList< QSharedPointer<Annotation::Link> > Page::loadLinks(const AbortToken & abort /* = AbortToken() */)
 {
   {
     QReadLocker pageLocker(_pageLock);
@@ -955,8 +1096,15 @@ QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
   // Check if the links were loaded in another thread in the meantime
   if (_linksLoaded || !_parent)
     return _links;
+  // Note: Don't set _linksLoaded when aborting so the links are loaded
+  // properly the next time they are requested
+  if (abort.isAborted())
+    return QList< QSharedPointer<Annotation::Link> >();
 
-  MuPDFLocaleResetter lr;
+  // NB: Get the page before locking MuPDF as that may create a page object
+  // (see Document::_mupdfMutex)
+  QWeakPointer<Backend::Page> self(_parent->page(_n));
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
 
   pdf_xref * xref = static_cast<Document*>(_parent)->_mupdf_data;
   Q_ASSERT(xref != NULL);
@@ -973,7 +1121,7 @@ QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
   while (mupdfLink) {
     QSharedPointer<Annotation::Link> link(new Annotation::Link);
     link->setRect(toRectF(mupdfLink->rect));
-    link->setPage(_parent->page(_n));
+    link->setPage(self);
     // TODO: Initialize all other properties of PDFLinkAnnotation, such as
     // border, color, quadPoints, etc.
 
@@ -1028,7 +1176,10 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
   if (_annotationsLoaded || !_parent)
     return _annotations;
 
-  MuPDFLocaleResetter lr;
+  // NB: Get the page before locking MuPDF as that may create a page object
+  // (see Document::_mupdfMutex)
+  QWeakPointer<Backend::Page> self(_parent->page(_n));
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
   static char keyType[] = "Type";
   static char keySubtype[] = "Subtype";
 
@@ -1053,37 +1204,37 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
     QString subtype = QString::fromAscii(fz_to_name(fz_dict_gets(mupdfAnnot->obj, keySubtype)));
     if (subtype == QString::fromAscii("Text")) {
       Annotation::Text * annot = new Annotation::Text();
-      initPDFMarkupAnnotation(annot, _parent->page(_n), mupdfAnnot->obj);
+      initPDFMarkupAnnotation(annot, self, mupdfAnnot->obj);
       _annotations << QSharedPointer<Annotation::AbstractAnnotation>(annot);
     }
     else if (subtype == QString::fromAscii("FreeText")) {
       Annotation::FreeText * annot = new Annotation::FreeText();
-      initPDFMarkupAnnotation(annot, _parent->page(_n), mupdfAnnot->obj);
+      initPDFMarkupAnnotation(annot, self, mupdfAnnot->obj);
       _annotations << QSharedPointer<Annotation::AbstractAnnotation>(annot);
     }
     else if (subtype == QString::fromAscii("Caret")) {
       Annotation::Caret * annot = new Annotation::Caret();
-      initPDFMarkupAnnotation(annot, _parent->page(_n), mupdfAnnot->obj);
+      initPDFMarkupAnnotation(annot, self, mupdfAnnot->obj);
       _annotations << QSharedPointer<Annotation::AbstractAnnotation>(annot);
     }
     else if (subtype == QString::fromAscii("Highlight")) {
       Annotation::Highlight * annot = new Annotation::Highlight();
-      initPDFMarkupAnnotation(annot, _parent->page(_n), mupdfAnnot->obj);
+      initPDFMarkupAnnotation(annot, self, mupdfAnnot->obj);
       _annotations << QSharedPointer<Annotation::AbstractAnnotation>(annot);
     }
     else if (subtype == QString::fromAscii("Underline")) {
       Annotation::Underline * annot = new Annotation::Underline();
-      initPDFMarkupAnnotation(annot, _parent->page(_n), mupdfAnnot->obj);
+      initPDFMarkupAnnotation(annot, self, mupdfAnnot->obj);
       _annotations << QSharedPointer<Annotation::AbstractAnnotation>(annot);
     }
     else if (subtype == QString::fromAscii("Squiggly")) {
       Annotation::Squiggly * annot = new Annotation::Squiggly();
-      initPDFMarkupAnnotation(annot, _parent->page(_n), mupdfAnnot->obj);
+      initPDFMarkupAnnotation(annot, self, mupdfAnnot->obj);
       _annotations << QSharedPointer<Annotation::AbstractAnnotation>(annot);
     }
     else if (subtype == QString::fromAscii("StrikeOut")) {
       Annotation::StrikeOut * annot = new Annotation::StrikeOut();
-      initPDFMarkupAnnotation(annot, _parent->page(_n), mupdfAnnot->obj);
+      initPDFMarkupAnnotation(annot, self, mupdfAnnot->obj);
       _annotations << QSharedPointer<Annotation::AbstractAnnotation>(annot);
     }
     // TODO: Other annotation types (do we need Link annotations here?)
@@ -1092,7 +1243,7 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
   return _annotations;
 }
 
-QList<SearchResult> Page::search(const QString & searchText, const SearchFlags & flags)
+QList<SearchResult> Page::search(const QString & searchText, const SearchFlags & flags, const AbortToken & abort /* = AbortToken() */)
 {
   QList<SearchResult> results;
   fz_text_span * page_text, * span;
@@ -1110,15 +1261,21 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
   render_trans = fz_concat(render_trans, fz_scale(1, -1));
   render_trans = fz_concat(render_trans, fz_rotate(_rotate));
 
-  if (!_mupdf_page)
+  if (!_mupdf_page || abort.isAborted())
     return results;
 
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
   // Extract text from page
   page_text = fz_new_text_span();
   dev = fz_new_text_device(page_text);
   fz_execute_display_list(_mupdf_page, dev, render_trans, fz_infinite_bbox);
   fz_free_device(dev);
 
+  if (abort.isAborted()) {
+    fz_free_text_span(page_text);
+    return results;
+  }
+
   // Convert fz_text_spans to QString
   // TODO: Decide what to do about the space MuPDF prepends and appends to each
   // line (at least for the base14-fonts.pdf test case).
@@ -1133,7 +1290,7 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
   i = 0;
   spanStart = 0;
   span = page_text;
-  while ((i = text.indexOf(searchText, i, caseSensitivity)) >= 0) {
+  while (!abort.isAborted() && (i = text.indexOf(searchText, i, caseSensitivity)) >= 0) {
     // Search for the text span(s) the string is coming from. Note: Because we
     // are doing a forward search only, we don't need to reset `span` or
     // `spanStart`.
@@ -1263,13 +1420,14 @@ void Page::loadTransitionData()
   }
 }
 
-QList<Backend::Page::Box> Page::boxes()
+QList<Backend::Page::Box> Page::boxes(const AbortToken & abort /* = AbortToken() */)
 {
   QReadLocker pageLocker(_pageLock);
 
   QList<Backend::Page::Box> retVal;
-  if (!_mupdf_page)
+  if (!_mupdf_page || abort.isAborted())
     return retVal;
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
   
   fz_text_span * textSpan = fz_new_text_span();
   if (!textSpan)
@@ -1292,7 +1450,7 @@ QList<Backend::Page::Box> Page::boxes()
 
   fz_text_span * span = textSpan;
   Backend::Page::Box b;
-  while (span) {
+  while (span && !abort.isAborted()) {
     for (int i = 0; i < span->len; ++i) {
       Backend::Page::Box sb;
       sb.boundingBox = toRectF(span->text[i].bbox);
@@ -1328,6 +1486,7 @@ QString Page::selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF>
   QString retVal;
   if (!_mupdf_page)
     return retVal;
+  MuPDFLocker mupdfLocker(_mupdfMutex.data());
   
   fz_text_span * textSpan = fz_new_text_span();
   if (!textSpan)
@@ -47,9 +47,15 @@ class Document: public Backend::Document
 
 protected:
   // The pdf_xref is the main MuPDF object that represents a Document. Calls
-  // that use it may have to be protected by a mutex.
+  // that use it must be protected by _mupdfMutex.
   pdf_xref *_mupdf_data;
   fz_glyph_cache *_glyph_cache;
+  // The bundled MuPDF is not thread-safe, so all calls that touch _mupdf_data,
+  // _glyph_cache or the pages' display lists must hold this (recursive) mutex
+  // (see MuPDFLocker). It is shared with the pages as they may outlive the
+  // document. Acquire it after the doc- and page-locks, and don't create page
+  // objects while holding it.
+  const QSharedPointer<QMutex> _mupdfMutex;
 
   void loadMetaData();
 
@@ -58,6 +64,8 @@ protected:
   bool _isValid() const { return (_mupdf_data != nullptr); }
   bool _isLocked() const { return (_isValid() && _permissionLevel == PermissionLevel_Locked); }
 
+  Backend::Page * newPage(int at);
+
 public:
   Document(QString fileName);
   ~Document();
@@ -67,10 +75,10 @@ public:
 
   bool unlock(const QString password);
   void reload();
+  QString backendName() const { return QString::fromLatin1("mupdf"); }
 
-  QWeakPointer<Backend::Page> page(int at);
-  QWeakPointer<Backend::Page> page(int at) const;
   PDFDestination resolveDestination(const PDFDestination & namedDestination) const;
+  QSizeF pageSizeF(int at);
 
   PDFToC toc() const;
   QList<PDFFontInfo> fonts() const;
@@ -91,8 +99,10 @@ class Page: public Backend::Page
   typedef Backend::Page Super;
 
   // The `fz_display_list` is the main MuPDF object that represents the parsed
-  // contents of a Page.
+  // contents of a Page. Calls that use it must hold _mupdfMutex.
   fz_display_list *_mupdf_page;
+  // The parent's Document::_mupdfMutex
+  const QSharedPointer<QMutex> _mupdfMutex;
 
   // Keep as a Fitz object rather than QRect as it is used in rendering ops.
   fz_rect _bbox;
@@ -103,6 +113,9 @@ class Page: public Backend::Page
   QList< QSharedPointer<Annotation::Link> > _links;
   bool _annotationsLoaded;
   bool _linksLoaded;
+  // Hash of the page's /Annots (see fingerprint()); computed on construction
+  // as that holds the MuPDF mutex anyway
+  QByteArray _fingerprint;
   
   // requires a doc-lock and a page-write-lock
   void loadTransitionData();
@@ -115,13 +128,14 @@ public:
 
   QSizeF pageSizeF() const;
 
-  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false) const;
+  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const AbortToken & abort = AbortToken()) const;
 
-  QList< QSharedPointer<Annotation::Link> > loadLinks();
+  QList< QSharedPointer<Annotation::Link> > loadLinks(const AbortToken & abort = AbortToken());
   QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations();
+  QByteArray fingerprint() const;
 
-  QList<SearchResult> search(const QString & searchText, const SearchFlags & flags);
-  virtual QList<Backend::Page::Box> boxes();
+  QList<SearchResult> search(const QString & searchText, const SearchFlags & flags, const AbortToken & abort = AbortToken());
+  virtual QList<Backend::Page::Box> boxes(const AbortToken & abort = AbortToken());
   virtual QString selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes = nullptr, QMap<int, QRectF> * charBoxes = nullptr);
 };
 
@@ -30,6 +30,15 @@ namespace Backend {
 
 namespace PopplerQt {
 
+#if defined(POPPLER_HAS_RENDER_ABORT) || defined(POPPLER_HAS_TEXTLIST_ABORT)
+// Callback used by Poppler to poll whether a lengthy operation should be
+// aborted; the closure holds the AbortToken of the operation
+static bool shouldAbort(const QVariant & closure)
+{
+  return closure.value<AbortToken>().isAborted();
+}
+#endif
+
 // TODO: Find a better place to put this
 PDFDestination toPDFDestination(const ::Poppler::Document * doc, const ::Poppler::LinkDestination & dest)
 {
@@ -134,13 +143,12 @@ void convertAnnotation(Annotation::AbstractAnnotation * dest, const ::Poppler::A
 // ==============
 Document::Document(const QString & fileName):
   Super(fileName),
-  _poppler_doc(::Poppler::Document::load(fileName)),
-  _poppler_docLock(new QMutex()),
-  _fontsLoaded(false)
+  _poppler_docLock(new QMutex())
 {
 #ifdef DEBUG
 //  qDebug() << "PopplerQt::Document::Document(" << fileName << ")";
 #endif
+  loadDocument();
   parseDocument();
 }
 
@@ -165,11 +173,11 @@ void Document::reload()
   QWriteLocker docLocker(_docLock.data());
 
   clearPages();
-  _pageCache.markOutdated();
+  _pageCache->markOutdated();
 
   {
     QMutexLocker l(_poppler_docLock);
-    _poppler_doc = QSharedPointer< ::Poppler::Document >(::Poppler::Document::load(_fileName));
+    loadDocument();
   }
 
   // TODO: possibly unlock the new document again if it was previously unlocked
@@ -178,6 +186,17 @@ void Document::reload()
   parseDocument();
 }
 
+void Document::loadDocument()
+{
+  // NB: loadFromData() keeps a (shallow) copy of the QByteArray, so the data
+  // is not duplicated
+  _fileSource = FileSource::open(_fileName);
+  if (_fileSource)
+    _poppler_doc = QSharedPointer< ::Poppler::Document >(::Poppler::Document::loadFromData(_fileSource->data()));
+  else
+    _poppler_doc.clear();
+}
+
 void Document::parseDocument()
 {
   QWriteLocker docLocker(_docLock.data());
@@ -185,8 +204,10 @@ void Document::parseDocument()
   clearMetaData();
   _numPages = -1;
 
-  if (!_poppler_doc || _isLocked())
+  if (!_poppler_doc || _isLocked()) {
+    publishMetaData();
     return;
+  }
 
   _numPages = _poppler_doc->numPages();
 
@@ -279,51 +300,36 @@ void Document::parseDocument()
 
   foreach (QString key, metaKeys)
     _meta_other[key] = _poppler_doc->info(key);
+
+  publishMetaData();
 }
 
-QWeakPointer<Backend::Page> Document::page(int at)
+Backend::Page * Document::newPage(int at)
 {
-  {
-    QReadLocker docLocker(_docLock.data());
-
-    if (at < 0 || at >= _numPages)
-      return QWeakPointer<Backend::Page>();
-
-    if (at < _pages.size() && !_pages[at].isNull())
-      return _pages[at];
-  }
-
-  // if we get here, the page is not in the array
-  QWriteLocker docLocker(_docLock.data());
-
-  // recheck everything that could have changed before we got the write lock
-  if (at >= _numPages)
-    return QWeakPointer<Backend::Page>();
-  if (at < _pages.size() && !_pages[at].isNull())
-    return _pages[at].toWeakRef();
-
-  if( _pages.isEmpty() )
-    _pages.resize(_numPages);
-
-  // If we got here, we don't have the page cached. As we need to create a new
-  // page, we need to make sure the Poppler document is valid and does not go
-  // out of scope
+  // As we need to create a new page, we need to make sure the Poppler document
+  // is valid and does not go out of scope
   QMutexLocker popplerLocker(_poppler_docLock);
   if (!_poppler_doc)
-    return QWeakPointer<Backend::Page>();
+    return nullptr;
 
-  _pages[at] = QSharedPointer<Backend::Page>(new Page(this, at, _docLock));
-  return _pages[at].toWeakRef();
+  return new Page(this, at, _docLock);
 }
 
-QWeakPointer<Backend::Page> Document::page(int at) const
+QSizeF Document::pageSizeF(int at)
 {
-  QReadLocker docLocker(_docLock.data());
-
-  if (at < 0 || at >= _numPages || at >= _pages.size())
-    return QWeakPointer<Backend::Page>();
+  // Use the page object if it exists already (but don't create it)
+  QSharedPointer<Backend::Page> page(static_cast<const Document *>(this)->page(at).toStrongRef());
+  if (page)
+    return page->pageSizeF();
 
-  return QWeakPointer<Backend::Page>(_pages[at]);
+  // Otherwise, ask Poppler directly; this avoids setting up our page object
+  // (e.g., its transition data)
+  QReadLocker docLocker(_docLock.data());
+  QMutexLocker popplerLocker(_poppler_docLock);
+  if (!_poppler_doc || _poppler_doc->isLocked() || at < 0 || at >= _poppler_doc->numPages())
+    return QSizeF();
+  QScopedPointer< ::Poppler::Page > popplerPage(_poppler_doc->page(at));
+  return (popplerPage ? popplerPage->pageSizeF() : QSizeF());
 }
 
 PDFDestination Document::resolveDestination(const PDFDestination & namedDestination) const
@@ -399,13 +405,9 @@ QList<PDFFontInfo> Document::fonts() const
 {
   QReadLocker docLocker(_docLock.data());
 
-  if (_fontsLoaded)
-    return _fonts;
-
+  QList<PDFFontInfo> retVal;
   if (!_poppler_doc || _isLocked())
-    return QList<PDFFontInfo>();
-
-  _fontsLoaded = true;
+    return retVal;
 
   foreach(::Poppler::FontInfo popplerFontInfo, _poppler_doc->fonts()) {
     PDFFontInfo fi;
@@ -475,9 +477,9 @@ QList<PDFFontInfo> Document::fonts() const
       default:
         continue;
     }
-    _fonts << fi;
+    retVal << fi;
   }
-  return _fonts;
+  return retVal;
 }
 
 bool Document::unlock(const QString password)
@@ -528,11 +530,11 @@ QSizeF Page::pageSizeF() const
   return _poppler_page->pageSizeF();
 }
 
-QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache) const
+QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cache, const AbortToken & abort /* = AbortToken() */) const
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
-  if (!_parent)
+  if (!_parent || abort.isAborted())
     return QImage();
 
   QImage renderedPage;
@@ -540,6 +542,19 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   {
     // Rendering pages is not thread safe.
     QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
+    // Waiting for the mutex can take a while (if another page is currently
+    // being rendered), so check again whether we are still needed
+    if (abort.isAborted())
+      return QImage();
+#ifdef POPPLER_HAS_RENDER_ABORT
+    if (abort.canAbort()) {
+      // Poppler interprets negative values as "the whole page"
+      QRect r = (render_box.isNull() ? QRect(-1, -1, -1, -1) : render_box);
+      renderedPage = _poppler_page->renderToImage(xres, yres, r.x(), r.y(), r.width(), r.height(),
+          ::Poppler::Page::Rotate0, nullptr, nullptr, shouldAbort, QVariant::fromValue(abort));
+    }
+    else
+#endif
     if( render_box.isNull() ) {
       // A null QRect has a width and height of 0 --- we will tell Poppler to render the whole
       // page.
@@ -550,6 +565,10 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
     }
   }
 
+  // Partially rendered pages must neither be cached nor returned
+  if (abort.isAborted())
+    return QImage();
+
   if( cache ) {
     PDFPageTile key(xres, yres, render_box, _n);
     QImage * img = new QImage(renderedPage.copy());
@@ -560,7 +579,7 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   return renderedPage;
 }
 
-QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
+QList< QSharedPointer<Annotation::Link> > Page::loadLinks(const AbortToken & abort /* = AbortToken() */)
 {
   {
     QReadLocker pageLocker(_pageLock);
@@ -575,18 +594,26 @@ QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
   // Check if the links were loaded in another thread in the meantime
   if (_linksLoaded || !_parent)
     return _links;
+  // Note: Don't set _linksLoaded when aborting so the links are loaded
+  // properly the next time they are requested
+  if (abort.isAborted())
+    return QList< QSharedPointer<Annotation::Link> >();
 
 
   Q_ASSERT(_poppler_page != nullptr);
-  _linksLoaded = true;
   QList< ::Poppler::Link *> popplerLinks;
   QList< ::Poppler::Annotation *> popplerAnnots;
   {
     // Loading links is not thread safe.
     QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
+    // Waiting for the mutex can take a while; Poppler offers no way to abort
+    // the actual loading, though
+    if (abort.isAborted())
+      return QList< QSharedPointer<Annotation::Link> >();
     popplerLinks = _poppler_page->links();
     popplerAnnots = _poppler_page->annotations();
   }
+  _linksLoaded = true;
 
   // Note: Poppler gives the linkArea in normalized coordinates, i.e., in the
   // range of 0..1, with y=0 at the top. We use pdf coordinates internally, so
@@ -773,7 +800,7 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
   return _annotations;
 }
 
-QList<SearchResult> Page::search(const QString & searchText, const SearchFlags & flags)
+QList<SearchResult> Page::search(const QString & searchText, const SearchFlags & flags, const AbortToken & abort /* = AbortToken() */)
 {
   QList<SearchResult> results;
   SearchResult result;
@@ -787,12 +814,14 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
 
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
-  if (!_parent)
+  if (!_parent || abort.isAborted())
     return results;
 
   result.pageNum = _n;
 
   QMutexLocker popplerDocLock(dynamic_cast<Document *>(_parent)->_poppler_docLock);
+  if (abort.isAborted())
+    return results;
 
   if (flags & Search_Backwards) {
     left = right = pageSizeF().width();
@@ -806,7 +835,9 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
   // depreciated---something to do with float <-> double conversion causing
   // infinite loops on some architectures. So, we explicitly use doubles and
   // avoid the depreciated function.
-  while ( _poppler_page->search(searchText, left, top, right, bottom, searchDir, searchFlags) ) {
+  // Poppler has no abort callback for searching, but since each call only
+  // finds the next occurrence we can check for aborts in-between.
+  while ( !abort.isAborted() && _poppler_page->search(searchText, left, top, right, bottom, searchDir, searchFlags) ) {
     result.bbox = QRectF(qreal(left), qreal(top), qAbs(qreal(right) - qreal(left)), qAbs(qreal(bottom) - qreal(top)));
     results << result;
   }
@@ -901,13 +932,27 @@ void Page::loadTransitionData()
   }
 }
 
-QList< Backend::Page::Box > Page::boxes()
+QList< ::Poppler::TextBox* > Page::textList(const AbortToken & abort) const
+{
+#ifdef POPPLER_HAS_TEXTLIST_ABORT
+  if (abort.canAbort())
+    return _poppler_page->textList(::Poppler::Page::Rotate0, shouldAbort, QVariant::fromValue(abort));
+#else
+  if (abort.isAborted())
+    return QList< ::Poppler::TextBox* >();
+#endif
+  return _poppler_page->textList();
+}
+
+QList< Backend::Page::Box > Page::boxes(const AbortToken & abort /* = AbortToken() */)
 {
   QReadLocker pageLocker(_pageLock);
   Q_ASSERT(_poppler_page != nullptr);
   QList< Backend::Page::Box > retVal;
 
-  foreach (::Poppler::TextBox * popplerTextBox, _poppler_page->textList()) {
+  foreach (::Poppler::TextBox * popplerTextBox, textList(abort)) {
+    if (abort.isAborted())
+      break;
     if (!popplerTextBox)
       continue;
     Backend::Page::Box box;
@@ -922,7 +967,7 @@ QList< Backend::Page::Box > Page::boxes()
   return retVal;
 }
 
-QString Page::selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes /* = nullptr */, QMap<int, QRectF> * charBoxes /* = nullptr */, const bool onlyFullyEnclosed /* = false */)
+QString Page::selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes /* = nullptr */, QMap<int, QRectF> * charBoxes /* = nullptr */, const bool onlyFullyEnclosed /* = false */, const AbortToken & abort /* = AbortToken() */)
 {
   QReadLocker pageLocker(_pageLock);
   Q_ASSERT(_poppler_page != nullptr);
@@ -936,11 +981,13 @@ QString Page::selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF>
   bool insertSpace = false;
 
   // Get a list of all boxes
-  QList<Poppler::TextBox*> poppler_boxes = _poppler_page->textList();
+  QList<Poppler::TextBox*> poppler_boxes = textList(abort);
   Poppler::TextBox * lastPopplerBox = nullptr;
 
   // Filter boxes by selection
   foreach (Poppler::TextBox * poppler_box, poppler_boxes) {
+    if (abort.isAborted())
+      break;
     if (!poppler_box)
       continue;
 
@@ -41,21 +41,21 @@ class Document: public Backend::Document
   QSharedPointer< ::Poppler::Document > _poppler_doc;
 
   void recursiveConvertToC(QList<PDFToCItem> & items, QDomNode node) const;
+  // Loads the current generation of the file from its (shared) FileSource
+  void loadDocument();
 
 protected:
   // Poppler is not threadsafe, so some operations need to be serialized with a
   // mutex.
   QMutex * _poppler_docLock;
-  // Since ::Poppler::Document::fonts() is extremely slow, we need to cache the
-  // result.
-  mutable QList<PDFFontInfo> _fonts;
-  mutable bool _fontsLoaded;
 
   // The following two methods are not thread-safe because they don't acquire a
   // read lock. This is to enable methods that have a write lock to use them.
   bool _isValid() const { return (_poppler_doc != nullptr); }
   bool _isLocked() const { return (_poppler_doc ? _poppler_doc->isLocked() : false); }
 
+  Backend::Page * newPage(int at);
+
 public:
   Document(const QString & fileName);
   ~Document();
@@ -64,11 +64,11 @@ public:
   bool isLocked() const { QReadLocker docLocker(_docLock.data()); return _isLocked(); }
 
   void reload();
+  QString backendName() const { return QString::fromLatin1("poppler-qt"); }
   bool unlock(const QString password);
 
-  QWeakPointer<Backend::Page> page(int at);
-  QWeakPointer<Backend::Page> page(int at) const;
   PDFDestination resolveDestination(const PDFDestination & namedDestination) const;
+  QSizeF pageSizeF(int at);
 
   PDFToC toc() const;
   QList<PDFFontInfo> fonts() const;
@@ -90,6 +90,9 @@ class Page: public Backend::Page
   bool _linksLoaded;
 
   void loadTransitionData();
+  // Wrapper around ::Poppler::Page::textList() that uses Poppler's abort
+  // callback if available. Requires a page-read-lock.
+  QList< ::Poppler::TextBox* > textList(const AbortToken & abort) const;
 
 protected:
   Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock);
@@ -99,14 +102,14 @@ public:
 
   QSizeF pageSizeF() const;
 
-  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false) const;
+  QImage renderToImage(double xres, double yres, QRect render_box = QRect(), bool cache = false, const AbortToken & abort = AbortToken()) const;
 
-  QList< QSharedPointer<Annotation::Link> > loadLinks();
+  QList< QSharedPointer<Annotation::Link> > loadLinks(const AbortToken & abort = AbortToken());
   QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations();
-  QList< Backend::Page::Box > boxes();
-  QString selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes = nullptr, QMap<int, QRectF> * charBoxes = nullptr, const bool onlyFullyEnclosed = false);
+  QList< Backend::Page::Box > boxes(const AbortToken & abort = AbortToken());
+  QString selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes = nullptr, QMap<int, QRectF> * charBoxes = nullptr, const bool onlyFullyEnclosed = false, const AbortToken & abort = AbortToken());
 
-  QList<Backend::SearchResult> search(const QString & searchText, const SearchFlags & flags);
+  QList<Backend::SearchResult> search(const QString & searchText, const SearchFlags & flags, const AbortToken & abort = AbortToken());
 };
 
 } // namespace PopplerQt
@@ -0,0 +1,287 @@
+#include "BenchmarkQtPDF.h"
+#include <QPainter>
+#include <QPdfWriter>
+
+#ifdef USE_MUPDF
+  typedef QtPDF::MuPDFBackend Backend;
+#elif USE_POPPLERQT
+  typedef QtPDF::PopplerQtBackend Backend;
+#else
+  #error Must specify one backend
+#endif
+
+// Resolutions (in dpi) full pages are rendered at
+static const int renderResolutions[] = { 72, 150, 300 };
+// Size (in pixel) of the tiles in renderTiles()
+static const int benchmarkTileSize = 256;
+
+bool BenchmarkQtPDF::generateTextDocument(const QString & fileName, const int numPages)
+{
+  QPdfWriter writer(fileName);
+  writer.setPageSize(QPagedPaintDevice::A4);
+  writer.setResolution(300);
+  QPainter painter;
+  if (!painter.begin(&writer))
+    return false;
+
+  const QString line = QString::fromLatin1("The quick brown fox jumps over the lazy dog. Lorem ipsum dolor sit amet, consectetur adipiscing elit.");
+  QFont font(QString::fromLatin1("Times"));
+  font.setPointSize(10);
+  painter.setFont(font);
+  const int lineHeight = painter.fontMetrics().lineSpacing();
+  const QRect pageRect(writer.pageLayout().paintRectPixels(writer.resolution()));
+
+  for (int i = 0; i < numPages; ++i) {
+    if (i > 0)
+      writer.newPage();
+    int n = 0;
+    for (int y = lineHeight; y < pageRect.height(); y += lineHeight, ++n)
+      painter.drawText(0, y, QString::fromLatin1("%1.%2 ").arg(i + 1).arg(n + 1) + line);
+  }
+  return painter.end();
+}
+
+bool BenchmarkQtPDF::generateGraphicsDocument(const QString & fileName, const int numPages)
+{
+  QPdfWriter writer(fileName);
+  writer.setPageSize(QPagedPaintDevice::A4);
+  writer.setResolution(300);
+  QPainter painter;
+  if (!painter.begin(&writer))
+    return false;
+
+  const QRect pageRect(writer.pageLayout().paintRectPixels(writer.resolution()));
+  // Use a fixed seed so the documents are comparable between runs
+  qsrand(42);
+
+  for (int i = 0; i < numPages; ++i) {
+    if (i > 0)
+      writer.newPage();
+    for (int j = 0; j < 2000; ++j) {
+      QColor c(qrand() % 256, qrand() % 256, qrand() % 256, 128);
+      painter.setPen(QPen(c, 1 + qrand() % 10));
+      painter.setBrush(j % 2 ? QBrush(c) : QBrush());
+      QRect r(qrand() % pageRect.width(), qrand() % pageRect.height(), 10 + qrand() % 300, 10 + qrand() % 300);
+      switch (j % 3) {
+        case 0:
+          painter.drawEllipse(r);
+          break;
+        case 1:
+          painter.drawRect(r);
+          break;
+        default:
+          painter.drawLine(r.topLeft(), r.bottomRight());
+          break;
+      }
+    }
+  }
+  return painter.end();
+}
+
+void BenchmarkQtPDF::initTestCase()
+{
+  // The test PDFs (without the locked one, which would only measure failures)
+  _corpus[QString::fromLatin1("transitions")] = QString::fromLatin1("pdf-transitions.pdf");
+  _corpus[QString::fromLatin1("base14-fonts")] = QString::fromLatin1("base14-fonts.pdf");
+  _corpus[QString::fromLatin1("poppler-data")] = QString::fromLatin1("poppler-data.pdf");
+  _corpus[QString::fromLatin1("metadata")] = QString::fromLatin1("metadata.pdf");
+  _corpus[QString::fromLatin1("page-rotation")] = QString::fromLatin1("page-rotation.pdf");
+  _corpus[QString::fromLatin1("annotations")] = QString::fromLatin1("annotations.pdf");
+  // The PGF manual is not shipped, but benchmark it if it is there
+  if (QFileInfo(QString::fromLatin1("pgfmanual.pdf")).exists())
+    _corpus[QString::fromLatin1("pgfmanual")] = QString::fromLatin1("pgfmanual.pdf");
+
+  // Large generated documents
+  QVERIFY(_tmpDir.isValid());
+  QString fileName = _tmpDir.path() + QString::fromLatin1("/generated-text.pdf");
+  QVERIFY(generateTextDocument(fileName, 500));
+  _corpus[QString::fromLatin1("generated-text")] = fileName;
+  fileName = _tmpDir.path() + QString::fromLatin1("/generated-graphics.pdf");
+  QVERIFY(generateGraphicsDocument(fileName, 50));
+  _corpus[QString::fromLatin1("generated-graphics")] = fileName;
+
+  Backend backend;
+  foreach (QString name, _corpus.keys()) {
+    pDoc doc = backend.newDocument(_corpus[name]);
+    QVERIFY2(doc && doc->isValid(), qPrintable(name));
+    _docs[name] = doc;
+  }
+}
+
+void BenchmarkQtPDF::cleanupTestCase()
+{
+  _docs.clear();
+}
+
+void BenchmarkQtPDF::addCorpusColumn()
+{
+  QTest::addColumn<QString>("name");
+  foreach (QString name, _corpus.keys())
+    QTest::newRow(qPrintable(name)) << name;
+}
+
+void BenchmarkQtPDF::openDocument_data()
+{
+  addCorpusColumn();
+}
+
+void BenchmarkQtPDF::openDocument()
+{
+  QFETCH(QString, name);
+  Backend backend;
+  QBENCHMARK {
+    pDoc doc = backend.newDocument(_corpus[name]);
+    QVERIFY(doc);
+  }
+}
+
+void BenchmarkQtPDF::timeToFirstPixel_data()
+{
+  addCorpusColumn();
+}
+
+void BenchmarkQtPDF::timeToFirstPixel()
+{
+  QFETCH(QString, name);
+  const int dpi = 150;
+  Backend backend;
+  // What the viewer does before the first pixel can be shown: open the
+  // document, determine the size of the first page and render its first tile
+  QBENCHMARK {
+    pDoc doc = backend.newDocument(_corpus[name]);
+    QVERIFY(doc);
+    QVERIFY(!doc->pageSizeF(0).isEmpty());
+    pPage page = doc->page(0).toStrongRef();
+    QVERIFY(page);
+    QImage img = page->renderToImage(dpi, dpi, QRect(0, 0, benchmarkTileSize, benchmarkTileSize));
+    QVERIFY(!img.isNull());
+  }
+}
+
+void BenchmarkQtPDF::pageSizeScan_data()
+{
+  addCorpusColumn();
+}
+
+void BenchmarkQtPDF::pageSizeScan()
+{
+  QFETCH(QString, name);
+  Backend backend;
+  // NB: Page objects are cached by the document, so each iteration needs a
+  // fresh one (i.e., the timing includes opening the document)
+  QBENCHMARK {
+    pDoc doc = backend.newDocument(_corpus[name]);
+    QSizeF totalSize;
+    for (int i = 0; i < doc->numPages(); ++i) {
+      pPage page = doc->page(i).toStrongRef();
+      QVERIFY(page);
+      totalSize += page->pageSizeF();
+    }
+    QVERIFY(!totalSize.isEmpty());
+  }
+}
+
+void BenchmarkQtPDF::renderPage_data()
+{
+  QTest::addColumn<QString>("name");
+  QTest::addColumn<int>("dpi");
+  foreach (QString name, _corpus.keys()) {
+    for (size_t i = 0; i < sizeof(renderResolutions) / sizeof(renderResolutions[0]); ++i)
+      QTest::newRow(qPrintable(QString::fromLatin1("%1@%2dpi").arg(name).arg(renderResolutions[i]))) << name << renderResolutions[i];
+  }
+}
+
+void BenchmarkQtPDF::renderPage()
+{
+  QFETCH(QString, name);
+  QFETCH(int, dpi);
+  pPage page = _docs[name]->page(0).toStrongRef();
+  QVERIFY(page);
+  // NB: Don't cache the result, or the page cache would be benchmarked
+  QBENCHMARK {
+    QImage img = page->renderToImage(dpi, dpi);
+    QVERIFY(!img.isNull());
+  }
+}
+
+void BenchmarkQtPDF::renderTiles_data()
+{
+  addCorpusColumn();
+}
+
+void BenchmarkQtPDF::renderTiles()
+{
+  QFETCH(QString, name);
+  const int dpi = 150;
+  pPage page = _docs[name]->page(0).toStrongRef();
+  QVERIFY(page);
+  const QSize pageSize((page->pageSizeF() * dpi / 72.).toSize());
+
+  QBENCHMARK {
+    for (int y = 0; y < pageSize.height(); y += benchmarkTileSize) {
+      for (int x = 0; x < pageSize.width(); x += benchmarkTileSize) {
+        QImage img = page->renderToImage(dpi, dpi, QRect(x, y, benchmarkTileSize, benchmarkTileSize));
+        QVERIFY(!img.isNull());
+      }
+    }
+  }
+}
+
+void BenchmarkQtPDF::boxes_data()
+{
+  addCorpusColumn();
+}
+
+void BenchmarkQtPDF::boxes()
+{
+  QFETCH(QString, name);
+  pPage page = _docs[name]->page(0).toStrongRef();
+  QVERIFY(page);
+  QBENCHMARK {
+    page->boxes();
+  }
+}
+
+void BenchmarkQtPDF::selectedText_data()
+{
+  addCorpusColumn();
+}
+
+void BenchmarkQtPDF::selectedText()
+{
+  QFETCH(QString, name);
+  pPage page = _docs[name]->page(0).toStrongRef();
+  QVERIFY(page);
+  // Select the whole page
+  QList<QPolygonF> selection;
+  selection << QPolygonF(QRectF(QPointF(0, 0), page->pageSizeF()));
+  QBENCHMARK {
+    page->selectedText(selection);
+  }
+}
+
+void BenchmarkQtPDF::search_data()
+{
+  QTest::addColumn<QString>("name");
+  QTest::addColumn<QString>("needle");
+  foreach (QString name, _corpus.keys())
+    QTest::newRow(qPrintable(name)) << name << QString::fromLatin1("the");
+}
+
+void BenchmarkQtPDF::search()
+{
+  QFETCH(QString, name);
+  QFETCH(QString, needle);
+  pDoc doc = _docs[name];
+  // Search the whole document
+  QBENCHMARK {
+    doc->search(needle, QtPDF::Backend::Search_CaseInsensitive);
+  }
+}
+
+
+#if defined(STATIC_QT5) && defined(Q_OS_WIN)
+  Q_IMPORT_PLUGIN (QWindowsIntegrationPlugin);
+#endif
+
+QTEST_MAIN(BenchmarkQtPDF)
@@ -0,0 +1,57 @@
+#include <QtTest/QtTest>
+#include <QObject>
+#include <QTemporaryDir>
+
+#include "PDFBackend.h"
+
+// Throughput benchmarks for the backends (one executable per backend, just like
+// the unit tests). Run from the unit-tests directory so the test PDFs are found;
+// use QtTest's output options to get machine-readable results, e.g.
+//   benchmark_mupdf -o results.xml,xml
+//   benchmark_mupdf -csv
+// or build the `benchmark` target, which does this for all backends.
+class BenchmarkQtPDF : public QObject
+{
+  Q_OBJECT
+
+  typedef QSharedPointer<QtPDF::Backend::Document> pDoc;
+  typedef QSharedPointer<QtPDF::Backend::Page> pPage;
+
+  // Maps corpus names to file names
+  QMap<QString, QString> _corpus;
+  QMap<QString, pDoc> _docs;
+  // Holds the generated (large) documents
+  QTemporaryDir _tmpDir;
+
+  void addCorpusColumn();
+  bool generateTextDocument(const QString & fileName, const int numPages);
+  bool generateGraphicsDocument(const QString & fileName, const int numPages);
+
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+
+  void openDocument_data();
+  void openDocument();
+
+  void timeToFirstPixel_data();
+  void timeToFirstPixel();
+
+  void pageSizeScan_data();
+  void pageSizeScan();
+
+  void renderPage_data();
+  void renderPage();
+
+  void renderTiles_data();
+  void renderTiles();
+
+  void boxes_data();
+  void boxes();
+
+  void selectedText_data();
+  void selectedText();
+
+  void search_data();
+  void search();
+};
@@ -1,5 +1,8 @@
 #include "TestQtPDF.h"
 #include "PaperSizes.h"
+#include "PDFDocumentView.h"
+#include "PDFBandRenderer.h"
+#include <QPainter>
 
 #ifdef USE_MUPDF
   typedef QtPDF::MuPDFBackend Backend;
@@ -62,6 +65,15 @@ void TestQtPDF::backendInterface()
 
   QVERIFY(backend.canHandleFile(QString::fromLatin1("test.pdf")));
   QVERIFY(!backend.canHandleFile(QString::fromLatin1("test.tex")));
+
+  // Views of the same (unchanged) file share one document
+  QSharedPointer<QtPDF::Backend::Document> doc1 = backend.sharedDocument(QString::fromLatin1("base14-fonts.pdf"));
+  QSharedPointer<QtPDF::Backend::Document> doc2 = backend.sharedDocument(QString::fromLatin1("base14-fonts.pdf"));
+  QVERIFY(doc1);
+  QVERIFY(doc1->isUpToDate());
+  QCOMPARE(doc1, doc2);
+  QVERIFY(backend.newDocument(QString::fromLatin1("base14-fonts.pdf")) != doc1);
+  QVERIFY(backend.sharedDocument(QString::fromLatin1("pdf-transitions.pdf")) != doc1);
 }
 
 void TestQtPDF::loadDocs()
@@ -246,6 +258,8 @@ void TestQtPDF::page()
 #endif
     QVERIFY2(qAbs(page->pageSizeF().width() - size.width()) < 1e-4, qPrintable(QString::fromLatin1("Width of page %1 is %2 instead of %3").arg(i + 1).arg(page->pageSizeF().width()).arg(size.width())));
     QVERIFY2(qAbs(page->pageSizeF().height() - size.height()) < 1e-4, qPrintable(QString::fromLatin1("Height of page %1 is %2 instead of %3").arg(i + 1).arg(page->pageSizeF().height()).arg(size.height())));
+    // The size must be the same whether the page object is used or not
+    QCOMPARE(doc->pageSizeF(i), page->pageSizeF());
 
 //		transition
 //		loadLinks()
@@ -603,6 +617,14 @@ void TestQtPDF::fonts()
     actualFontNames.append(fonts[i].descriptor().pureName());
 
   QCOMPARE(actualFontNames, fontNames);
+
+  // The cached variant must yield the same (also when called repeatedly)
+  for (int j = 0; j < 2; ++j) {
+    actualFontNames.clear();
+    foreach (QtPDF::Backend::PDFFontInfo font, doc->cachedFonts())
+      actualFontNames.append(font.descriptor().pureName());
+    QCOMPARE(actualFontNames, fontNames);
+  }
 }
 
 void compareToC(const QtPDF::Backend::PDFToC & actual, const QtPDF::Backend::PDFToC & expected)
@@ -653,6 +675,10 @@ void TestQtPDF::toc()
     qDebug() << "Expected:";
     printToC(toc);
   }
+
+  // The cached variant must yield the same (also when called repeatedly)
+  compareToC(doc->cachedToC(), toc);
+  compareToC(doc->cachedToC(), toc);
 }
 
 
@@ -684,6 +710,101 @@ void TestQtPDF::page_renderToImage()
   QVERIFY(render == ref);
 }
 
+void TestQtPDF::page_abort()
+{
+  QSharedPointer<QtPDF::Backend::Page> page = _docs[QString::fromLatin1("base14-fonts")]->page(0).toStrongRef();
+  QVERIFY(page);
+
+  QtPDF::Backend::AbortToken token = QtPDF::Backend::AbortToken::create();
+  QVERIFY(token.canAbort());
+  QVERIFY(!token.isAborted());
+  // All copies share the same state
+  QtPDF::Backend::AbortToken copy(token);
+  copy.abort();
+  QVERIFY(token.isAborted());
+  // Default-constructed tokens can never be aborted
+  QtPDF::Backend::AbortToken dummy;
+  dummy.abort();
+  QVERIFY(!dummy.isAborted());
+
+  QVERIFY(page->renderToImage(150, 150, QRect(), false, token).isNull());
+  QVERIFY(page->search(QString::fromLatin1("Times-Roman"), QtPDF::Backend::SearchFlags(), token).isEmpty());
+  QVERIFY(page->boxes(token).isEmpty());
+
+  // Aborted operations must not affect subsequent ones
+  QVERIFY(!page->renderToImage(150, 150, QRect(), false, dummy).isNull());
+  QCOMPARE(page->search(QString::fromLatin1("Times-Roman"), QtPDF::Backend::SearchFlags()).size(), 1);
+}
+
+void TestQtPDF::page_contentBoundingBox()
+{
+  QSharedPointer<QtPDF::Backend::Page> page = _docs[QString::fromLatin1("base14-fonts")]->page(0).toStrongRef();
+  QVERIFY(page);
+  QRectF pageRect(QPointF(0, 0), page->pageSizeF());
+
+  QVERIFY(!page->hasContentBoundingBox());
+  QRectF bbox = page->getContentBoundingBox();
+  QVERIFY(page->hasContentBoundingBox());
+  QVERIFY(!bbox.isEmpty());
+  QVERIFY(pageRect.contains(bbox));
+  // The page has white margins
+  QVERIFY(bbox != pageRect);
+  // Subsequent calls return the cached result
+  QCOMPARE(page->getContentBoundingBox(), bbox);
+
+  // The high-precision box must agree with the low-precision one up to the
+  // accuracy of the latter (i.e., 1 px at 100 px per page dimension)
+  QRectF hpBbox = page->getContentBoundingBox(true);
+  QVERIFY(page->hasContentBoundingBox(true));
+  const qreal dx = pageRect.width() / 100., dy = pageRect.height() / 100.;
+  QVERIFY(bbox.adjusted(-dx, -dy, dx, dy).contains(hpBbox));
+  QVERIFY(hpBbox.adjusted(-dx, -dy, dx, dy).contains(bbox));
+}
+
+void TestQtPDF::colorFilter_data()
+{
+  QTest::addColumn<int>("type");
+  QTest::addColumn<QColor>("paperColor");
+  QTest::addColumn<QRgb>("input");
+  QTest::addColumn<QRgb>("expected");
+
+  typedef QtPDF::Backend::PDFPageColorFilter F;
+  QTest::newRow("none") << static_cast<int>(F::Filter_None) << QColor() << qRgba(10, 20, 30, 255) << qRgba(10, 20, 30, 255);
+  QTest::newRow("grayscale") << static_cast<int>(F::Filter_GrayScale) << QColor() << qRgba(10, 20, 30, 255) << qRgba(qGray(10, 20, 30), qGray(10, 20, 30), qGray(10, 20, 30), 255);
+  QTest::newRow("grayscale-alpha") << static_cast<int>(F::Filter_GrayScale) << QColor() << qRgba(200, 100, 50, 128) << qRgba(qGray(200, 100, 50), qGray(200, 100, 50), qGray(200, 100, 50), 128);
+  QTest::newRow("invert") << static_cast<int>(F::Filter_Invert) << QColor() << qRgba(10, 20, 30, 255) << qRgba(245, 235, 225, 255);
+  QTest::newRow("paper-white") << static_cast<int>(F::Filter_PaperColor) << QColor(255, 240, 200) << qRgba(255, 255, 255, 255) << qRgba(255, 240, 200, 255);
+  QTest::newRow("paper-black") << static_cast<int>(F::Filter_PaperColor) << QColor(255, 240, 200) << qRgba(0, 0, 0, 255) << qRgba(0, 0, 0, 255);
+  QTest::newRow("paper-gray") << static_cast<int>(F::Filter_PaperColor) << QColor(255, 240, 200) << qRgba(128, 128, 128, 255) << qRgba(128, 120, 100, 255);
+}
+
+void TestQtPDF::colorFilter()
+{
+  QFETCH(int, type);
+  QFETCH(QColor, paperColor);
+  QFETCH(QRgb, input);
+  QFETCH(QRgb, expected);
+
+  QtPDF::Backend::PDFPageColorFilter filter(static_cast<QtPDF::Backend::PDFPageColorFilter::FilterType>(type), paperColor);
+
+  QImage img(3, 2, QImage::Format_ARGB32);
+  img.fill(input);
+  QImage orig(img);
+  filter.apply(img);
+
+  // The filter must not alter implicitly shared copies (e.g., cached images)
+  QCOMPARE(orig.pixel(0, 0), input);
+  for (int y = 0; y < img.height(); ++y) {
+    for (int x = 0; x < img.width(); ++x)
+      QCOMPARE(img.pixel(x, y), expected);
+  }
+
+  // Filters are part of the tile key
+  QtPDF::Backend::PDFPageTile t1(72, 72, QRect(0, 0, 10, 10), 0);
+  QtPDF::Backend::PDFPageTile t2(72, 72, QRect(0, 0, 10, 10), 0, filter);
+  QCOMPARE(t1 == t2, filter.isNull());
+}
+
 namespace QtPDF {
 bool operator== (const QtPDF::PDFAction & a, const QtPDF::PDFAction & b) {
   if (a.type() != b.type()) return false;
@@ -809,6 +930,86 @@ void TestQtPDF::page_loadLinks()
   }
 }
 
+// Collects the links posted by Page::asyncLoadLinks()
+class LinksListener : public QObject
+{
+public:
+  LinksListener() : eventCount(0) { }
+
+  int eventCount;
+  QList< QSharedPointer<QtPDF::Annotation::Link> > links;
+
+protected:
+  bool event(QEvent * event) {
+    if (event->type() != QtPDF::Backend::PDFLinksLoadedEvent::LinksLoadedEvent)
+      return QObject::event(event);
+    links = static_cast<QtPDF::Backend::PDFLinksLoadedEvent*>(event)->links;
+    ++eventCount;
+    return true;
+  }
+};
+
+void TestQtPDF::page_loadLinksCached()
+{
+  typedef QtPDF::Backend::RenderStatistics RS;
+
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  QString fileName = dir.path() + QString::fromLatin1("/annotations.pdf");
+  QVERIFY(QFile::copy(QString::fromLatin1("annotations.pdf"), fileName));
+
+  Backend backend;
+  {
+    LinksListener listener;
+    QSharedPointer<QtPDF::Backend::Document> doc = backend.newDocument(fileName);
+    QVERIFY(doc);
+    QSharedPointer<QtPDF::Backend::Page> page = doc->page(0).toStrongRef();
+    QVERIFY(page);
+    page->asyncLoadLinks(&listener);
+    QTRY_COMPARE(listener.eventCount, 1);
+    QCOMPARE(listener.links.size(), 2);
+  }
+
+  // Regenerate the file without changing its pages
+  {
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::Append));
+    QVERIFY(file.write("% modified\n") > 0);
+  }
+
+  LinksListener listener;
+  QSharedPointer<QtPDF::Backend::Document> doc = backend.newDocument(fileName);
+  QVERIFY(doc);
+  RS & stats = doc->processingThread().statistics();
+  stats.setEnabled(true);
+  QSharedPointer<QtPDF::Backend::Page> page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+  page->asyncLoadLinks(&listener);
+
+  // The links of the previous version are posted right away, attached to the
+  // new page
+  QCoreApplication::sendPostedEvents(&listener, QtPDF::Backend::PDFLinksLoadedEvent::LinksLoadedEvent);
+  QCOMPARE(listener.eventCount, 1);
+  QCOMPARE(listener.links.size(), 2);
+  foreach (QSharedPointer<QtPDF::Annotation::Link> link, listener.links) {
+    QCOMPARE(link->page().toStrongRef(), page);
+    QVERIFY(link->actionOnActivation());
+  }
+
+#ifdef USE_MUPDF
+  // The page's annotations are unchanged, so the links are not loaded again
+  QCOMPARE(stats.snapshot().counters[RS::LinkCacheHits], static_cast<quint64>(1));
+  QCOMPARE(stats.snapshot().counters[RS::LinksRequested], static_cast<quint64>(0));
+#else
+  // Without a fingerprint, the carried-over links are validated by loading
+  // them again
+  QCOMPARE(stats.snapshot().counters[RS::LinkCacheHits], static_cast<quint64>(0));
+  QCOMPARE(stats.snapshot().counters[RS::LinksRequested], static_cast<quint64>(1));
+  QTRY_COMPARE(listener.eventCount, 2);
+  QCOMPARE(listener.links.size(), 2);
+#endif
+}
+
 void compareAnnotation(const QtPDF::Annotation::AbstractAnnotation & a, const QtPDF::Annotation::AbstractAnnotation & b)
 {
   int pageA = (a.page().toStrongRef() ? a.page().toStrongRef()->pageNum() : -1);
@@ -991,6 +1192,456 @@ void TestQtPDF::page_search()
   }
 }
 
+void TestQtPDF::page_searchContext()
+{
+  QtPDF::Backend::SearchRequest request;
+  request.doc = _docs[QString::fromLatin1("base14-fonts")];
+  request.pageNum = 0;
+  request.searchString = QString::fromLatin1("lazy");
+  request.flags = QtPDF::Backend::Search_WithContext;
+
+  QList<QtPDF::Backend::SearchResult> results = QtPDF::Backend::Page::executeSearch(request);
+  QVERIFY(!results.isEmpty());
+  // Each font shows the same sentence, so all results have the same context
+#ifdef USE_MUPDF
+  QEXPECT_FAIL("", "mupdf doesn't report character boxes for selected text", Abort);
+#endif
+  foreach (QtPDF::Backend::SearchResult result, results)
+    QCOMPARE(result.context, QString::fromLatin1("The quick brown fox jumps over the lazy dog"));
+
+  // Without the flag, no context is extracted
+  request.flags = QtPDF::Backend::SearchFlags();
+  results = QtPDF::Backend::Page::executeSearch(request);
+  QVERIFY(!results.isEmpty());
+  QVERIFY(results.first().context.isEmpty());
+}
+
+void TestQtPDF::transitions_data()
+{
+  typedef QtPDF::Transition::AbstractTransition T;
+  QTest::addColumn<int>("type");
+  QTest::addColumn<int>("direction");
+  QTest::addColumn<int>("motion");
+
+  QTest::newRow("Split") << static_cast<int>(T::Type_Split) << 0 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Blinds") << static_cast<int>(T::Type_Blinds) << 0 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Box") << static_cast<int>(T::Type_Box) << 0 << static_cast<int>(T::Motion_Outward);
+  QTest::newRow("Wipe") << static_cast<int>(T::Type_Wipe) << 180 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Dissolve") << static_cast<int>(T::Type_Dissolve) << 0 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Glitter") << static_cast<int>(T::Type_Glitter) << 315 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Replace") << static_cast<int>(T::Type_Replace) << 0 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Fly-in") << static_cast<int>(T::Type_Fly) << 0 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Fly-out") << static_cast<int>(T::Type_Fly) << 90 << static_cast<int>(T::Motion_Outward);
+  QTest::newRow("Push") << static_cast<int>(T::Type_Push) << 180 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Cover") << static_cast<int>(T::Type_Cover) << 270 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Uncover") << static_cast<int>(T::Type_Uncover) << 90 << static_cast<int>(T::Motion_Inward);
+  QTest::newRow("Fade") << static_cast<int>(T::Type_Fade) << 0 << static_cast<int>(T::Motion_Inward);
+}
+
+void TestQtPDF::transitions()
+{
+  typedef QtPDF::Transition::AbstractTransition T;
+  QFETCH(int, type);
+  QFETCH(int, direction);
+  QFETCH(int, motion);
+
+  QScopedPointer<T> transition(T::newTransition(static_cast<T::Type>(type)));
+  QVERIFY(transition);
+  transition->setDirection(direction);
+  transition->setMotion(static_cast<T::Motion>(motion));
+
+  // Use different formats to check that the transition handles the conversion
+  QImage imgStart(64, 48, QImage::Format_ARGB32_Premultiplied);
+  imgStart.fill(qRgba(255, 0, 0, 255));
+  QImage imgEnd(64, 48, QImage::Format_ARGB32);
+  imgEnd.fill(qRgba(0, 0, 255, 255));
+  {
+    QPainter p(&imgEnd);
+    p.fillRect(8, 8, 16, 16, Qt::green);
+  }
+
+  transition->setDuration(60);
+  transition->start(imgStart, imgEnd);
+  QVERIFY(transition->isRunning() || transition->isFinished());
+  QImage frame(transition->getImage());
+  QCOMPARE(frame.size(), imgEnd.size());
+
+  // Once the transition is finished, the final frame must be the end image
+  transition->reset();
+  transition->setDuration(1e-6);
+  transition->start(imgStart, imgEnd);
+  QTest::qWait(5);
+  frame = transition->getImage();
+  QVERIFY(transition->isFinished());
+  QCOMPARE(frame.convertToFormat(QImage::Format_ARGB32), imgEnd);
+}
+
+void TestQtPDF::renderStatistics()
+{
+  typedef QtPDF::Backend::RenderStatistics RS;
+
+  RS::Histogram h;
+  QCOMPARE(h.count(), static_cast<quint64>(0));
+  QCOMPARE(h.percentile(0.5), 0.);
+  h.add(500); // 0.5 ms
+  h.add(3000); // 3 ms
+  h.add(3500); // 3.5 ms
+  h.add(100000); // 100 ms
+  QCOMPARE(h.count(), static_cast<quint64>(4));
+  QCOMPARE(h.bucket(0), static_cast<quint64>(1));
+  QCOMPARE(h.bucket(2), static_cast<quint64>(2));
+  QCOMPARE(h.bucket(7), static_cast<quint64>(1));
+  QCOMPARE(h.mean(), 26.75);
+  QCOMPARE(h.max(), 100.);
+  QCOMPARE(h.percentile(0.5), 4.);
+  QCOMPARE(h.percentile(1), 100.);
+
+  Backend backend;
+  // Use a separate instance so the statistics and the page cache of the shared
+  // one are not affected (and don't affect this test)
+  QSharedPointer<QtPDF::Backend::Document> doc = backend.newDocument(QString::fromLatin1("base14-fonts.pdf"));
+  QVERIFY(doc);
+  RS & stats = doc->processingThread().statistics();
+  QVERIFY(!stats.isEnabled());
+
+  // Nothing is recorded while disabled
+  stats.increment(RS::CacheHits);
+  stats.addRenderTime(1000);
+  QCOMPARE(stats.snapshot().counters[RS::CacheHits], static_cast<quint64>(0));
+  QCOMPARE(stats.snapshot().renderTime.count(), static_cast<quint64>(0));
+
+  stats.setEnabled(true);
+  QSharedPointer<QtPDF::Backend::Page> page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+  QRect tile(0, 0, 64, 64);
+  // A synchronous request is a miss, the next one a hit
+  QVERIFY(page->getTileImage(nullptr, 12, 12, tile));
+  QVERIFY(page->getTileImage(nullptr, 12, 12, tile));
+
+  RS::Snapshot snapshot = doc->renderStatistics();
+  QVERIFY(snapshot.enabled);
+  QCOMPARE(snapshot.counters[RS::CacheMisses], static_cast<quint64>(1));
+  QCOMPARE(snapshot.counters[RS::CacheHits], static_cast<quint64>(1));
+  QCOMPARE(snapshot.cacheHitRate(), 0.5);
+  QVERIFY(snapshot.bytesCached > 0);
+  QVERIFY(!snapshot.backend.isEmpty());
+  QCOMPARE(snapshot.toVariantMap()[QString::fromLatin1("cacheHits")].toULongLong(), static_cast<quint64>(1));
+
+  stats.reset();
+  QCOMPARE(stats.snapshot().counters[RS::CacheHits], static_cast<quint64>(0));
+  stats.setEnabled(false);
+}
+
+void TestQtPDF::residentPages()
+{
+  Backend backend;
+  // Use a separate instance so the page objects of the shared one are not
+  // affected
+  QSharedPointer<QtPDF::Backend::Document> doc = backend.newDocument(QString::fromLatin1("pdf-transitions.pdf"));
+  QVERIFY(doc);
+  QVERIFY(doc->numPages() > 3);
+  doc->setMaxResidentPages(2);
+  QCOMPARE(doc->residentPages(), 0);
+
+  QSharedPointer<QtPDF::Backend::Page> page0 = doc->page(0).toStrongRef();
+  QVERIFY(page0);
+  QVERIFY(doc->page(1).toStrongRef());
+  // Touch page 0 so page 1 is the least recently used one
+  QCOMPARE(doc->page(0).toStrongRef(), page0);
+  QVERIFY(doc->page(2).toStrongRef());
+  QCOMPARE(doc->residentPages(), 2);
+  QVERIFY(const_cast<const QtPDF::Backend::Document&>(*doc).page(1).isNull());
+  QCOMPARE(doc->page(0).toStrongRef(), page0);
+
+  // Evicted pages are created again on demand, and stay usable while they are
+  // referenced elsewhere
+  QSharedPointer<QtPDF::Backend::Page> page1 = doc->page(1).toStrongRef();
+  QVERIFY(page1);
+  QCOMPARE(page1->pageNum(), 1);
+  QVERIFY(doc->page(3).toStrongRef());
+  QCOMPARE(doc->residentPages(), 2);
+  QVERIFY(!page1->pageSizeF().isEmpty());
+  QCOMPARE(doc->renderStatistics().residentPages, 2);
+
+  doc->setMaxResidentPages(0);
+  for (int i = 0; i < doc->numPages(); ++i)
+    QVERIFY(doc->page(i).toStrongRef());
+  QCOMPARE(doc->residentPages(), doc->numPages());
+}
+
+// Cache of a fixed size that releases whatever it is asked to (up to its size)
+class DummyCache : public QtPDF::ShrinkableCache
+{
+  QString _name;
+  qint64 _size;
+public:
+  DummyCache(const QString & name, const qint64 size) : _name(name), _size(size) { QtPDF::CacheRegistry::registerCache(this); }
+  QString cacheName() const { return _name; }
+  qint64 cacheSize() const { return _size; }
+  qint64 shrinkCache(const qint64 bytes) {
+    const qint64 released = qMin(bytes, _size);
+    _size -= released;
+    return released;
+  }
+};
+
+void TestQtPDF::fileSource()
+{
+  typedef QtPDF::Backend::FileSource FileSource;
+
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  QString fileA = dir.path() + QString::fromLatin1("/a.pdf");
+  QString fileB = dir.path() + QString::fromLatin1("/b.pdf");
+  QVERIFY(QFile::copy(QString::fromLatin1("base14-fonts.pdf"), fileA));
+  QVERIFY(QFile::copy(QString::fromLatin1("base14-fonts.pdf"), fileB));
+
+  QVERIFY(!FileSource::open(dir.path() + QString::fromLatin1("/missing.pdf")));
+
+  QSharedPointer<const FileSource> a = FileSource::open(fileA);
+  QVERIFY(a);
+  QCOMPARE(a->size(), QFileInfo(fileA).size());
+
+  // An unchanged file is not read again (regardless of how it is named)
+  QCOMPARE(FileSource::open(fileA), a);
+  QCOMPARE(FileSource::open(dir.path() + QString::fromLatin1("/./a.pdf")), a);
+
+  // A rewritten file is
+  {
+    QFile file(fileA);
+    QVERIFY(file.open(QIODevice::Append));
+    QVERIFY(file.write("% modified\n") > 0);
+  }
+  QSharedPointer<const FileSource> a2 = FileSource::open(fileA);
+  QVERIFY(a2);
+  QVERIFY(a2 != a);
+  QCOMPARE(a2->size(), QFileInfo(fileA).size());
+  QVERIFY(a2->data().startsWith(a->data()));
+  QCOMPARE(FileSource::open(fileA), a2);
+
+  // Entries of files no longer in use are dropped when another file is opened
+  QVERIFY(FileSource::isRegistered(fileA));
+  a.clear();
+  a2.clear();
+  QSharedPointer<const FileSource> b = FileSource::open(fileB);
+  QVERIFY(b);
+  QVERIFY(!FileSource::isRegistered(fileA));
+  QVERIFY(FileSource::isRegistered(fileB));
+}
+
+void TestQtPDF::cacheRegistry()
+{
+  // NB: The documents opened by the other tests are registered as well, so
+  // make the dummy caches large enough to be asked first
+  const qint64 otherSize = QtPDF::CacheRegistry::totalSize();
+  const qint64 MB = 1024 * 1024;
+  DummyCache small(QString::fromLatin1("small"), otherSize + 10 * MB);
+  QCOMPARE(QtPDF::CacheRegistry::totalSize(), 2 * otherSize + 10 * MB);
+  {
+    DummyCache large(QString::fromLatin1("large"), otherSize + 20 * MB);
+
+    // The largest cache is asked first
+    QList<QtPDF::CacheRegistry::Entry> report = QtPDF::CacheRegistry::shrink(otherSize + 25 * MB);
+    QCOMPARE(report.size(), 2);
+    QCOMPARE(report[0].name, QString::fromLatin1("large"));
+    QCOMPARE(report[0].size, otherSize + 20 * MB);
+    QCOMPARE(report[0].released, otherSize + 20 * MB);
+    QCOMPARE(report[1].name, QString::fromLatin1("small"));
+    QCOMPARE(report[1].released, 5 * MB);
+    QCOMPARE(small.cacheSize(), otherSize + 5 * MB);
+  }
+  // Destroyed caches are unregistered
+  QCOMPARE(QtPDF::CacheRegistry::totalSize(), 2 * otherSize + 5 * MB);
+  QVERIFY(QtPDF::CacheRegistry::shrink(0).isEmpty());
+
+#ifdef Q_OS_LINUX
+  QtPDF::MemoryPressureMonitor::MemoryStatus status = QtPDF::MemoryPressureMonitor::memoryStatus();
+  QVERIFY(status.isValid());
+  QVERIFY(status.available <= status.total);
+#endif
+}
+
+void TestQtPDF::replaceScene()
+{
+  Backend backend;
+  QString fileName(QString::fromLatin1("pdf-transitions.pdf"));
+  QtPDF::PDFDocumentView view;
+  view.resize(400, 400);
+  QSharedPointer<QtPDF::PDFDocumentScene> scene1(new QtPDF::PDFDocumentScene(backend.newDocument(fileName)));
+  view.setScene(scene1);
+  view.goToPage(1);
+  view.zoomIn();
+  const qreal zoomLevel = view.zoomLevel();
+  QSignalSpy spy(&view, SIGNAL(changedDocument(const QWeakPointer<QtPDF::Backend::Document>)));
+
+  // The old scene is shown until the new one has been rendered (or a timeout
+  // has passed); the current page and the zoom level are kept
+  QSharedPointer<QtPDF::PDFDocumentScene> scene2(new QtPDF::PDFDocumentScene(backend.newDocument(fileName)));
+  view.replaceScene(scene2);
+  QTRY_COMPARE(view.scene(), static_cast<QGraphicsScene*>(scene2.data()));
+  QCOMPARE(spy.count(), 1);
+  QCOMPARE(view.currentPage(), 1);
+  QCOMPARE(view.zoomLevel(), zoomLevel);
+
+  // Highlights (e.g., of SyncTeX jumps) added while the new scene is being
+  // prepared must end up in the new scene
+  QSharedPointer<QtPDF::PDFDocumentScene> scene3(new QtPDF::PDFDocumentScene(backend.newDocument(fileName)));
+  view.replaceScene(scene3);
+  QGraphicsPathItem * highlight = view.addHighlightPath(1, QRectF(0, 0, 10, 10), QColor(Qt::yellow));
+  QVERIFY(highlight);
+  QCOMPARE(highlight->scene(), static_cast<QGraphicsScene*>(scene3.data()));
+  QCOMPARE(view.scene(), static_cast<QGraphicsScene*>(scene3.data()));
+  QCOMPARE(spy.count(), 2);
+  QCOMPARE(view.currentPage(), 1);
+}
+
+// Returns the number of highlights (e.g., of search results) in `scene`
+static int highlightCount(const QGraphicsScene * scene)
+{
+  int retVal = 0;
+  foreach (QGraphicsItem * item, scene->items()) {
+    if (item->type() == QGraphicsPathItem::Type)
+      ++retVal;
+  }
+  return retVal;
+}
+
+void TestQtPDF::replaceSceneSearch()
+{
+  Backend backend;
+  QString fileName(QString::fromLatin1("base14-fonts.pdf"));
+  QString needle(QString::fromLatin1("Times-Roman"));
+  QtPDF::PDFDocumentView view;
+  view.resize(400, 400);
+  QSharedPointer<QtPDF::PDFDocumentScene> scene1(new QtPDF::PDFDocumentScene(backend.newDocument(fileName)));
+  view.setScene(scene1);
+  view.zoomIn();
+  QSignalSpy resultsSpy(&view, SIGNAL(searchResultsAdded(const QList<QtPDF::Backend::SearchResult> &)));
+  view.search(needle);
+  QTRY_VERIFY(resultsSpy.count() > 0);
+  QTRY_VERIFY(highlightCount(scene1.data()) > 0);
+
+  // Going to results and scrolling while the new scene is being prepared must
+  // neither create highlights in the new scene nor leave dangling ones behind
+  // (the results of the old scene are discarded when the scenes are swapped)
+  QSharedPointer<QtPDF::PDFDocumentScene> scene2(new QtPDF::PDFDocumentScene(backend.newDocument(fileName)));
+  view.replaceScene(scene2);
+  view.nextSearchResult();
+  view.verticalScrollBar()->setValue(view.verticalScrollBar()->value() + 10);
+  QTRY_COMPARE(view.scene(), static_cast<QGraphicsScene*>(scene2.data()));
+  QTest::qWait(100);
+  QCOMPARE(highlightCount(scene2.data()), 0);
+
+  // Searching the new scene works as usual
+  resultsSpy.clear();
+  view.search(needle);
+  QTRY_VERIFY(resultsSpy.count() > 0);
+  QTRY_VERIFY(highlightCount(scene2.data()) > 0);
+  view.clearSearchResults();
+  QCOMPARE(highlightCount(scene2.data()), 0);
+}
+
+void TestQtPDF::reloadRecreatedFile()
+{
+  QFile source(QString::fromLatin1("base14-fonts.pdf"));
+  QVERIFY(source.open(QIODevice::ReadOnly));
+  const QByteArray content = source.readAll();
+  const int eof = content.lastIndexOf("%%EOF");
+  QVERIFY(eof > 0);
+
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  QString fileName = dir.path() + QString::fromLatin1("/base14-fonts.pdf");
+  QVERIFY(QFile::copy(source.fileName(), fileName));
+
+  Backend backend;
+  QtPDF::PDFDocumentScene scene(backend.newDocument(fileName));
+  QVERIFY(scene.watchForDocumentChangesOnDisk());
+  QSignalSpy spy(&scene, SIGNAL(documentChanged(const QWeakPointer<QtPDF::Backend::Document>)));
+
+  // Delete the file and write it anew in two steps, as e.g. some TeX engines
+  // do; it must only be reloaded once it is complete
+  QVERIFY(QFile::remove(fileName));
+  QFile file(fileName);
+  QVERIFY(file.open(QIODevice::WriteOnly));
+  QCOMPARE(file.write(content.left(eof)), static_cast<qint64>(eof));
+  file.flush();
+  QTest::qWait(1500);
+  QCOMPARE(spy.count(), 0);
+  QVERIFY(file.write(content.mid(eof)) > 0);
+  file.close();
+  QTRY_COMPARE(spy.count(), 1);
+  QTest::qWait(1000);
+  QCOMPARE(spy.count(), 1);
+
+  // The recreated file is watched again
+  QVERIFY(file.open(QIODevice::Append));
+  QVERIFY(file.write("% modified\n") > 0);
+  file.close();
+  QTRY_COMPARE(spy.count(), 2);
+}
+
+void TestQtPDF::bandRenderer()
+{
+  Backend backend;
+  QString fileName(QString::fromLatin1("base14-fonts.pdf"));
+  QList<pDoc> docs;
+  docs << backend.newDocument(fileName) << backend.newDocument(fileName);
+  QVERIFY(docs[0] && docs[1]);
+  const double dpi = 36;
+  QList<int> pages;
+  pages << 0;
+
+  QtPDF::PDFBandRenderer renderer(docs, pages, dpi);
+  renderer.setBandHeight(50);
+  QSignalSpy bandSpy(&renderer, SIGNAL(bandReady(int, QRect, QSize, QImage)));
+  QSignalSpy finishedSpy(&renderer, SIGNAL(finished(bool)));
+  renderer.start();
+  QTRY_COMPARE(finishedSpy.count(), 1);
+  QCOMPARE(finishedSpy[0][0].toBool(), false);
+  QVERIFY(!renderer.isRunning());
+  QVERIFY(bandSpy.count() > 1);
+
+  // The bands arrive in order and make up the whole page
+  QImage assembled;
+  int y = 0;
+  foreach (const QList<QVariant> & args, bandSpy) {
+    QCOMPARE(args[0].toInt(), 0);
+    const QRect rect(args[1].toRect());
+    const QImage band(args[3].value<QImage>());
+    QVERIFY(!band.isNull());
+    QCOMPARE(rect.top(), y);
+    QCOMPARE(band.size(), rect.size());
+    if (assembled.isNull()) {
+      assembled = QImage(args[2].toSize(), band.format());
+      assembled.fill(Qt::white);
+    }
+    QPainter painter(&assembled);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(rect.topLeft(), band);
+    y = rect.bottom() + 1;
+  }
+  QCOMPARE(y, assembled.height());
+  pPage page(docs[0]->page(0).toStrongRef());
+  QVERIFY(page);
+  QVERIFY(ComparableImage(assembled) == ComparableImage(page->renderToImage(dpi, dpi)));
+
+  // Cancelling (here: as soon as the first band arrives) stops the delivery
+  QtPDF::PDFBandRenderer cancelledRenderer(docs, pages, dpi);
+  cancelledRenderer.setBandHeight(10);
+  QSignalSpy cancelledBandSpy(&cancelledRenderer, SIGNAL(bandReady(int, QRect, QSize, QImage)));
+  QSignalSpy cancelledFinishedSpy(&cancelledRenderer, SIGNAL(finished(bool)));
+  connect(&cancelledRenderer, SIGNAL(bandReady(int, QRect, QSize, QImage)), &cancelledRenderer, SLOT(cancel()));
+  cancelledRenderer.start();
+  QTRY_COMPARE(cancelledFinishedSpy.count(), 1);
+  QCOMPARE(cancelledFinishedSpy[0][0].toBool(), true);
+  QVERIFY(cancelledRenderer.wasCancelled());
+  QVERIFY(!cancelledRenderer.isRunning());
+  // Give stray deliveries a chance to show up
+  QTest::qWait(100);
+  QCOMPARE(cancelledBandSpy.count(), 1);
+}
+
 void TestQtPDF::paperSize_data()
 {
   QTest::addColumn<QSizeF>("requestSize");
@@ -89,8 +89,16 @@ private slots:
   void page_renderToImage_data();
   void page_renderToImage();
 
+  void page_abort();
+
+  void page_contentBoundingBox();
+
+  void colorFilter_data();
+  void colorFilter();
+
   void page_loadLinks_data();
   void page_loadLinks();
+  void page_loadLinksCached();
 
   void page_loadAnnotations_data();
   void page_loadAnnotations();
@@ -103,9 +111,27 @@ private slots:
 
   void page_search_data();
   void page_search();
+  void page_searchContext();
 
   void paperSize_data();
   void paperSize();
+
+  void transitions_data();
+  void transitions();
+
+  void renderStatistics();
+
+  void residentPages();
+
+  void fileSource();
+
+  void cacheRegistry();
+
+  void replaceScene();
+  void replaceSceneSearch();
+  void reloadRecreatedFile();
+
+  void bandRenderer();
 };
 
 typedef QMap<QString, QString> QStringMap;
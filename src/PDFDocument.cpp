@@ -48,6 +48,12 @@
 #include <QShortcut>
 #include <QToolTip>
 #include <QSignalMapper>
+#include <QStandardPaths>
+#include <QPrinter>
+#include <QPrintDialog>
+#include <QProgressDialog>
+#include <QEventLoop>
+#include <QThread>
 
 #include <math.h>
 
@@ -172,6 +178,7 @@ void PDFDocument::init()
 	connect(actionNew_from_Template, SIGNAL(triggered()), qApp, SLOT(newFromTemplate()));
 	connect(actionOpen, SIGNAL(triggered()), qApp, SLOT(open()));
 	connect(actionPrintPdf, SIGNAL(triggered()), this, SLOT(print()));
+	connect(actionExport_as_Images, SIGNAL(triggered()), this, SLOT(exportImages()));
 
 	connect(actionQuit_TeXworks, SIGNAL(triggered()), TWApp::instance(), SLOT(maybeQuit()));
 
@@ -265,6 +272,25 @@ void PDFDocument::init()
 	dw->hide();
 	addDockWidget(Qt::LeftDockWidgetArea, dw);
 	menuShow->addAction(dw->toggleViewAction());
+
+	// Keep thumbnails across sessions so large documents don't need to be
+	// rendered again each time they are opened
+	if (QtPDF::PDFThumbnailsInfoWidget::diskCacheDirectory().isEmpty())
+		QtPDF::PDFThumbnailsInfoWidget::setDiskCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QString::fromLatin1("/thumbnails"));
+	dw = pdfWidget->dockWidget(QtPDF::PDFDocumentView::Dock_Thumbnails, this);
+	dw->hide();
+	addDockWidget(Qt::LeftDockWidgetArea, dw);
+	menuShow->addAction(dw->toggleViewAction());
+
+	dw = pdfWidget->dockWidget(QtPDF::PDFDocumentView::Dock_SearchResults, this);
+	dw->hide();
+	addDockWidget(Qt::BottomDockWidgetArea, dw);
+	menuShow->addAction(dw->toggleViewAction());
+
+	menuShow->addSeparator();
+	QAction * actionRenderStatistics = menuShow->addAction(tr("Render Statistics"));
+	actionRenderStatistics->setCheckable(true);
+	connect(actionRenderStatistics, SIGNAL(toggled(bool)), pdfWidget, SLOT(setRenderStatisticsOverlayVisible(bool)));
 	
 	QSETTINGS_OBJECT(settings);
 	switch(settings.value(QString::fromLatin1("pdfPageMode"), kDefault_PDFPageMode).toInt()) {
@@ -650,6 +676,40 @@ void PDFDocument::copySelectedTextToClipboard()
 	QApplication::clipboard()->setText(textToCopy);
 }
 
+QVariantMap PDFDocument::renderStatistics()
+{
+	if (!widget())
+		return QVariantMap();
+	QSharedPointer<QtPDF::Backend::Document> doc = widget()->document().toStrongRef();
+	if (!doc)
+		return QVariantMap();
+	return doc->renderStatistics().toVariantMap();
+}
+
+void PDFDocument::setRenderStatisticsEnabled(const bool enabled)
+{
+	if (!widget())
+		return;
+	QSharedPointer<QtPDF::Backend::Document> doc = widget()->document().toStrongRef();
+	if (doc)
+		doc->processingThread().statistics().setEnabled(enabled);
+}
+
+void PDFDocument::resetRenderStatistics()
+{
+	if (!widget())
+		return;
+	QSharedPointer<QtPDF::Backend::Document> doc = widget()->document().toStrongRef();
+	if (doc)
+		doc->processingThread().statistics().reset();
+}
+
+void PDFDocument::setRenderStatisticsOverlayVisible(const bool visible)
+{
+	if (widget())
+		widget()->setRenderStatisticsOverlayVisible(visible);
+}
+
 void PDFDocument::maybeEnableCopyCommand(const bool isTextSelected)
 {
   Q_ASSERT(actionCopy);
@@ -1010,22 +1070,101 @@ void PDFDocument::maybeOpenPdf(QString filename, QtPDF::PDFDestination destinati
 	pdf->widget()->goToPDFDestination(destination, false);
 }
 
+QList< QSharedPointer<QtPDF::Backend::Document> > PDFDocument::rasterDocuments(const int numPages)
+{
+	QList< QSharedPointer<QtPDF::Backend::Document> > retVal;
+	QSharedPointer<QtPDF::Backend::Document> doc(pdfWidget->document().toStrongRef());
+	if (!doc)
+		return retVal;
+	// NB: The instances share the file data with the document that is shown
+	const int numWorkers = qBound(1, QThread::idealThreadCount(), qMax(1, numPages));
+	for (int i = 0; i < numWorkers; ++i) {
+		QSharedPointer<QtPDF::Backend::Document> instance(pdfWidget->newDocument(doc->fileName()));
+		// FIXME: Locked documents would have to be unlocked with the password
+		// used for the document that is shown
+		if (!instance || !instance->isValid() || instance->isLocked())
+			break;
+		retVal << instance;
+	}
+	return retVal;
+}
 
 void PDFDocument::print()
 {
-	// Currently, printing is not supported in a reliable, cross-platform way
-	// Instead, offer to open the document in the system's default viewer
-	
-	QString msg = tr("Unfortunately, this version of %1 is unable to print Pdf documents due to various technical reasons.\n").arg(QString::fromLatin1(TEXWORKS_NAME));
-	msg += tr("Do you want to open the file in the default viewer for printing instead?");
-	msg += tr(" (remember to close it again to avoid access problems)");
-	
-	if(QMessageBox::information(this,
-		tr("Print Pdf..."), msg,
-		QMessageBox::Yes | QMessageBox::No, QMessageBox::Yes) == QMessageBox::Yes
-	) {
-		QDesktopServices::openUrl(QUrl::fromLocalFile(curFile));
+	QSharedPointer<QtPDF::Backend::Document> doc(pdfWidget->document().toStrongRef());
+	if (!doc || !doc->isValid() || doc->numPages() <= 0)
+		return;
+
+	QPrinter printer(QPrinter::HighResolution);
+	printer.setDocName(TWUtils::strippedName(curFile));
+	printer.setFromTo(1, doc->numPages());
+	QPrintDialog printDialog(&printer, this);
+	printDialog.setMinMax(1, doc->numPages());
+	printDialog.setOption(QAbstractPrintDialog::PrintCurrentPage);
+	if (printDialog.exec() != QDialog::Accepted)
+		return;
+
+	QList<int> pages;
+	switch (printer.printRange()) {
+		case QPrinter::PageRange:
+			for (int i = printer.fromPage(); i <= printer.toPage(); ++i)
+				pages << i - 1;
+			break;
+		case QPrinter::CurrentPage:
+			pages << pdfWidget->currentPage();
+			break;
+		default:
+			for (int i = 0; i < doc->numPages(); ++i)
+				pages << i;
+			break;
 	}
+
+	QList< QSharedPointer<QtPDF::Backend::Document> > docs(rasterDocuments(pages.size()));
+	if (docs.isEmpty()) {
+		QMessageBox::warning(this, tr("Print Pdf..."), tr("The file \"%1\" could not be opened for printing.").arg(TWUtils::strippedName(curFile)));
+		return;
+	}
+	// Render at the printer's resolution so nothing needs to be scaled
+	// NB: The job lives on the stack, so it must not have a QObject parent
+	PDFRasterJob job(docs, pages, printer.resolution(), this);
+	if (!job.print(&printer) && !job.errorString().isEmpty())
+		QMessageBox::warning(this, tr("Print Pdf..."), job.errorString());
+}
+
+void PDFDocument::exportImages()
+{
+	QSharedPointer<QtPDF::Backend::Document> doc(pdfWidget->document().toStrongRef());
+	if (!doc || !doc->isValid() || doc->numPages() <= 0)
+		return;
+
+	QFileInfo fi(curFile);
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Export as Images"),
+		fi.absoluteDir().filePath(fi.completeBaseName() + QString::fromLatin1(".png")),
+		tr("PNG images (*.png);;JPEG images (*.jpg *.jpeg);;TIFF images (*.tif *.tiff)"));
+	if (fileName.isEmpty())
+		return;
+	if (QFileInfo(fileName).suffix().isEmpty())
+		fileName += QString::fromLatin1(".png");
+
+	QSETTINGS_OBJECT(settings);
+	bool ok;
+	const int dpi = QInputDialog::getInt(this, tr("Export as Images"), tr("Resolution (dpi):"),
+		settings.value(QString::fromLatin1("exportResolution"), kDefault_ExportResolution).toInt(), 18, 2400, 1, &ok);
+	if (!ok)
+		return;
+	settings.setValue(QString::fromLatin1("exportResolution"), dpi);
+
+	QList<int> pages;
+	for (int i = 0; i < doc->numPages(); ++i)
+		pages << i;
+	QList< QSharedPointer<QtPDF::Backend::Document> > docs(rasterDocuments(pages.size()));
+	if (docs.isEmpty()) {
+		QMessageBox::warning(this, tr("Export as Images"), tr("The file \"%1\" could not be opened for exporting.").arg(TWUtils::strippedName(curFile)));
+		return;
+	}
+	PDFRasterJob job(docs, pages, dpi, this);
+	if (!job.exportImages(fileName) && !job.errorString().isEmpty())
+		QMessageBox::warning(this, tr("Export as Images"), job.errorString());
 }
 
 void PDFDocument::showScaleContextMenu(const QPoint pos)
@@ -1117,6 +1256,135 @@ void PDFDocument::doScaleDialog()
 		pdfWidget->setZoomLevel(newScale / 100);
 }
 
+PDFRasterJob::PDFRasterJob(const QList< QSharedPointer<QtPDF::Backend::Document> > & docs, const QList<int> & pages, const double dpi, QWidget * dialogParent)
+	: QObject()
+	, _renderer(docs, pages, dpi)
+	, _dialogParent(dialogParent)
+	, _progressDialog(NULL)
+	, _numPages(docs.isEmpty() || !docs.first() ? 0 : docs.first()->numPages())
+	, _pagesDone(0)
+	, _printer(NULL)
+{
+	connect(&_renderer, SIGNAL(bandReady(int, QRect, QSize, QImage)), this, SLOT(bandReady(int, QRect, QSize, QImage)));
+	connect(&_renderer, SIGNAL(progress(int, int)), this, SLOT(updateProgress(int, int)));
+}
+
+bool PDFRasterJob::print(QPrinter * printer)
+{
+	if (!printer)
+		return false;
+	_printer = printer;
+	if (!_painter.begin(printer)) {
+		_errorString = tr("Printing failed.");
+		return false;
+	}
+	_painter.setRenderHint(QPainter::SmoothPixmapTransform);
+	const bool retVal = run(tr("Printing..."));
+	if (!retVal)
+		printer->abort();
+	_painter.end();
+	return retVal;
+}
+
+bool PDFRasterJob::exportImages(const QString & fileName)
+{
+	QFileInfo fi(fileName);
+	_fileNamePrefix = fi.absoluteDir().filePath(fi.completeBaseName() + QChar::fromLatin1('-'));
+	_fileNameSuffix = QChar::fromLatin1('.') + fi.suffix();
+	return run(tr("Exporting..."));
+}
+
+bool PDFRasterJob::run(const QString & label)
+{
+	// NB: The dialog is application modal so no window (in particular, not
+	// _dialogParent) can be closed while the nested event loop below runs. It
+	// is still tracked by a QPointer in case its parent gets destroyed anyway
+	// (which would destroy the dialog as well).
+	_progressDialog = new QProgressDialog(label, tr("Cancel"), 0, 0, _dialogParent);
+	_progressDialog->setWindowModality(Qt::ApplicationModal);
+	_progressDialog->setAutoReset(false);
+	_progressDialog->setAutoClose(false);
+	_progressDialog->setMinimumDuration(500);
+	connect(_progressDialog, SIGNAL(canceled()), &_renderer, SLOT(cancel()));
+	connect(_progressDialog, SIGNAL(destroyed()), &_renderer, SLOT(cancel()));
+
+	// Keep the GUI responsive while the pages are rendered in the background
+	QEventLoop loop;
+	connect(&_renderer, SIGNAL(finished(bool)), &loop, SLOT(quit()));
+	_renderer.start();
+	if (_renderer.isRunning())
+		loop.exec();
+
+	delete _progressDialog;
+	return (!_renderer.wasCancelled() && _errorString.isEmpty());
+}
+
+void PDFRasterJob::fail(const QString & errorString)
+{
+	_errorString = errorString;
+	_renderer.cancel();
+}
+
+void PDFRasterJob::bandReady(int page, QRect rect, QSize pageSize, QImage image)
+{
+	if (image.isNull()) {
+		fail(tr("Page %1 could not be rendered.").arg(page + 1));
+		return;
+	}
+	const bool firstBand = (rect.top() == 0);
+	const bool lastBand = (rect.bottom() >= pageSize.height() - 1);
+
+	if (_printer) {
+		if (firstBand) {
+			if (_pagesDone > 0 && !_printer->newPage()) {
+				fail(tr("Printing failed."));
+				return;
+			}
+			// Pages are rendered at the printer's resolution, i.e., they have
+			// their natural size; only shrink (and center) them if they don't fit
+			const QSizeF available(_printer->pageRect().size());
+			const qreal scale = qMin(qreal(1), qMin(available.width() / pageSize.width(), available.height() / pageSize.height()));
+			QTransform t;
+			t.translate((available.width() - scale * pageSize.width()) / 2, (available.height() - scale * pageSize.height()) / 2);
+			t.scale(scale, scale);
+			_painter.setTransform(t);
+		}
+		_painter.drawImage(rect.topLeft(), image);
+	}
+	else {
+		// NB: Image formats can't be written in bands, so each page is
+		// assembled before it is written
+		if (firstBand) {
+			_pageImage = QImage(pageSize, image.format());
+			_pageImage.fill(Qt::white);
+		}
+		QPainter painter(&_pageImage);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		painter.drawImage(rect.topLeft(), image);
+		painter.end();
+		if (lastBand) {
+			// Pad the page numbers so the files sort correctly
+			const QString fileName = _fileNamePrefix + QString::fromLatin1("%1").arg(page + 1, QString::number(_numPages).length(), 10, QChar::fromLatin1('0')) + _fileNameSuffix;
+			const bool ok = _pageImage.save(fileName);
+			_pageImage = QImage();
+			if (!ok) {
+				fail(tr("The file \"%1\" could not be written.").arg(fileName));
+				return;
+			}
+		}
+	}
+	if (lastBand)
+		++_pagesDone;
+}
+
+void PDFRasterJob::updateProgress(int done, int total)
+{
+	if (!_progressDialog)
+		return;
+	_progressDialog->setMaximum(total);
+	_progressDialog->setValue(done);
+}
+
 FullscreenManager::FullscreenManager(QMainWindow * parent)
 	: _parent(parent)
 {
@@ -29,13 +29,16 @@
 #include <QList>
 #include <QCursor>
 #include <QButtonGroup>
+#include <QPainter>
 #include <QPainterPath>
 #include <QTimer>
 #include <QMouseEvent>
+#include <QPointer>
 
 #include "TWApp.h"
 #include "FindDialog.h"
 #include "../modules/QtPDF/src/PDFDocumentWidget.h"
+#include "../modules/QtPDF/src/PDFBandRenderer.h"
 #include "TWSynchronizer.h"
 
 #include "ui_PDFDocument.h"
@@ -46,6 +49,8 @@ const int kDefault_PreviewScaleOption = 1;
 const int kDefault_PreviewScale = 200;
 const QtPDF::PDFDocumentView::PageMode kDefault_PDFPageMode = QtPDF::PDFDocumentView::PageMode_OneColumnContinuous;
 
+const int kDefault_ExportResolution = 150;
+
 const int kPDFWindowStateVersion = 1;
 
 class QAction;
@@ -54,6 +59,50 @@ class QToolBar;
 class QScrollArea;
 class TeXDocument;
 class QShortcut;
+class QPrinter;
+class QProgressDialog;
+
+// Prints pages of a PDF document or exports them as images by rendering them
+// natively in the background (see QtPDF::PDFBandRenderer) while showing the
+// progress (with the possibility to cancel)
+class PDFRasterJob : public QObject
+{
+	Q_OBJECT
+public:
+	// `docs` holds one document instance per worker; `dialogParent` is the
+	// parent of the progress dialog (the job itself has no parent so it can
+	// live on the stack)
+	PDFRasterJob(const QList< QSharedPointer<QtPDF::Backend::Document> > & docs, const QList<int> & pages, const double dpi, QWidget * dialogParent);
+
+	// `printer` must have been set up already (e.g., by a QPrintDialog)
+	bool print(QPrinter * printer);
+	// Writes one image per page; the files are named after `fileName`, with the
+	// page number appended to the base name
+	bool exportImages(const QString & fileName);
+	// Empty unless the job failed (i.e., not if it was cancelled by the user)
+	QString errorString() const { return _errorString; }
+
+private slots:
+	void bandReady(int page, QRect rect, QSize pageSize, QImage image);
+	void updateProgress(int done, int total);
+
+private:
+	bool run(const QString & label);
+	void fail(const QString & errorString);
+
+	QtPDF::PDFBandRenderer _renderer;
+	QPointer<QWidget> _dialogParent;
+	QPointer<QProgressDialog> _progressDialog;
+	int _numPages;
+	int _pagesDone;
+	QString _errorString;
+	// Set when printing
+	QPrinter * _printer;
+	QPainter _painter;
+	// Set when exporting
+	QString _fileNamePrefix, _fileNameSuffix;
+	QImage _pageImage;
+};
 
 class FullscreenManager : public QObject
 {
@@ -122,6 +171,12 @@ public:
 
 	QtPDF::PDFDocumentWidget * widget() { return pdfWidget; }
 
+	// Statistics of the render pipeline of the displayed document (see
+	// QtPDF::Backend::RenderStatistics), e.g., for scripts
+	Q_INVOKABLE QVariantMap renderStatistics();
+	Q_INVOKABLE void setRenderStatisticsEnabled(const bool enabled);
+	Q_INVOKABLE void resetRenderStatistics();
+
 protected:
 	virtual void changeEvent(QEvent *event);
 	virtual bool event(QEvent *event);
@@ -144,11 +199,13 @@ public slots:
 	void toggleFullScreen();
 	void syncFromSource(const QString& sourceFile, int lineNo, int col, bool activatePreview);
 	void print();
+	void exportImages();
 	void setMouseMode(const int newMode);
 	void setPageMode(const int newMode);
 	void clearSyncHighlight();
 	void clearSearchResultHighlight();
 	void copySelectedTextToClipboard();
+	void setRenderStatisticsOverlayVisible(const bool visible);
 
 private slots:
 	void changedDocument(const QWeakPointer<QtPDF::Backend::Document> newDoc);
@@ -183,6 +240,10 @@ private:
 	void setCurrentFile(const QString &fileName);
 	void loadSyncData();
 	void saveRecentFileInfo();
+	// Opens (up to) `numPages` additional instances of the current document
+	// (but not more than there are CPU cores) for rendering in parallel (see
+	// PDFRasterJob); returns an empty list on failure
+	QList< QSharedPointer<QtPDF::Backend::Document> > rasterDocuments(const int numPages);
 
 	QString curFile;
 
@@ -196,6 +196,10 @@ void TWApp::init()
 
 	scriptManager = new TWScriptManager;
 
+	// Trim caches (rendered PDF tiles, console output, etc.) if memory runs low
+	// so we don't get swapped out
+	new QtPDF::MemoryPressureMonitor(this);
+
 #if defined(Q_OS_DARWIN)
 	setQuitOnLastWindowClosed(false);
 	setAttribute(Qt::AA_DontShowIconsInMenus);
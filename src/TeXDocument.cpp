@@ -88,6 +88,7 @@ TeXDocument::TeXDocument(const QString &fileName, bool asTemplate)
 
 TeXDocument::~TeXDocument()
 {
+	QtPDF::CacheRegistry::unregisterCache(this);
 	docList.removeAll(this);
 	updateWindowMenu();
 }
@@ -386,6 +387,7 @@ void TeXDocument::init()
 	connect(watcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(reloadIfChangedOnDisk()), Qt::QueuedConnection);
 	
 	docList.append(this);
+	QtPDF::CacheRegistry::registerCache(this);
 	
 	TWApp::instance()->updateWindowMenus();
 	
@@ -2771,6 +2773,35 @@ void TeXDocument::processStandardOutput()
 	textEdit_console->setTextCursor(cursor);
 }
 
+QString TeXDocument::cacheName() const
+{
+	return tr("Console: %1").arg(TWUtils::strippedName(curFile));
+}
+
+qint64 TeXDocument::cacheSize() const
+{
+	return textEdit_console->document()->characterCount() * sizeof(QChar);
+}
+
+qint64 TeXDocument::shrinkCache(const qint64 bytes)
+{
+	QTextDocument * doc = textEdit_console->document();
+	const int before = doc->characterCount();
+	// Always keep the end of the output as that is usually the most relevant
+	const qint64 toRemove = qMin(bytes / qint64(sizeof(QChar)), qint64(before - kConsoleMinLength));
+	if (toRemove <= 0)
+		return 0;
+
+	// Only remove whole lines
+	const int end = doc->findBlock(static_cast<int>(toRemove)).position();
+	if (end <= 0)
+		return 0;
+	QTextCursor cursor(doc);
+	cursor.setPosition(end, QTextCursor::KeepAnchor);
+	cursor.removeSelectedText();
+	return (before - doc->characterCount()) * sizeof(QChar);
+}
+
 void TeXDocument::processError(QProcess::ProcessError /*error*/)
 {
 	if (userInterrupt)
@@ -2790,10 +2821,9 @@ void TeXDocument::processError(QProcess::ProcessError /*error*/)
 
 void TeXDocument::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
-	// Start watching for changes in the pdf (again)
-	if (pdfDoc && pdfDoc->widget())
-		pdfDoc->widget()->setWatchForDocumentChangesOnDisk(true);
-
+	// The engine is done writing the pdf, so reload it right away (rather than
+	// waiting for the file watcher to notice the change and for the file to
+	// settle)
 	if (exitStatus != QProcess::CrashExit) {
 		QString pdfName;
 		if (getPreviewFileName(pdfName)) {
@@ -2815,6 +2845,12 @@ void TeXDocument::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
 			actionGo_to_Preview->setEnabled(true);
 	}
 
+	// Start watching for changes in the pdf (again)
+	// NB: Only do this after reloading; otherwise, the (last) changes made by
+	// the engine could trigger a second reload
+	if (pdfDoc && pdfDoc->widget())
+		pdfDoc->widget()->setWatchForDocumentChangesOnDisk(true);
+
 	executeAfterTypesetHooks();
 	
 	QSETTINGS_OBJECT(settings);
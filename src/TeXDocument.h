@@ -35,6 +35,7 @@
 #include "FindDialog.h"
 #include "TWApp.h"
 #include "ClickableLabel.h"
+#include "../modules/QtPDF/src/MemoryPressure.h"
 
 #include <hunspell.h>
 
@@ -52,8 +53,11 @@ class TeXHighlighter;
 class PDFDocument;
 
 const int kTeXWindowStateVersion = 1; // increment this if we add toolbars/docks/etc
+const int kConsoleMinLength = 64 * 1024; // characters of console output that are kept even if memory runs low
 
-class TeXDocument : public TWScriptable, private Ui::TeXDocument
+// The console output is registered as a cache so it can be trimmed if memory
+// runs low (see QtPDF::MemoryPressureMonitor)
+class TeXDocument : public TWScriptable, private Ui::TeXDocument, private QtPDF::ShrinkableCache
 {
 	Q_OBJECT
 
@@ -225,6 +229,10 @@ private slots:
 
 private:
 	void init();
+	// QtPDF::ShrinkableCache interface (for the console output)
+	QString cacheName() const;
+	qint64 cacheSize() const;
+	qint64 shrinkCache(const qint64 bytes);
 	bool maybeSave();
 	void detachPdf();
 	bool saveFilesHavingRoot(const QString& aRootFile);